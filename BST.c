@@ -1,9 +1,13 @@
 #include <assert.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
+#include "mem_account.h"
+
 
 typedef struct block {
     size_t size;
@@ -95,14 +99,23 @@ void remove_free_tree(block_t **root, block_t *target)
     target->l = NULL;
     target->r = NULL;
 }
-/* Utility function to create a new node. */
-block_t *new_block(size_t size) {
-    block_t *node = (block_t *)malloc(sizeof(block_t));
+/* Utility function to create a new node, counted in mem when it is not NULL. */
+block_t *new_block_mem(mem_account_t *mem, size_t size) {
+    block_t *node = (block_t *)mem_account_malloc(mem, sizeof(block_t));
     node->size = size;
     node->l = node->r = NULL;
     return node;
 }
 
+block_t *new_block(size_t size) {
+    return new_block_mem(NULL, size);
+}
+
+/* Free a node that has been removed from the tree. */
+void free_block_mem(mem_account_t *mem, block_t *node) {
+    mem_account_free(mem, node, sizeof(block_t));
+}
+
 /* Inserts a node into the binary search tree. */
 void insert_free_tree(block_t **root, block_t *node) {
     if (*root == NULL) {
@@ -118,10 +131,57 @@ void insert_free_tree(block_t **root, block_t *node) {
 
 
 
+/*
+ * Memory footprint (--mem, build with -DMEM_ACCOUNT): build free trees of
+ * growing size, remove and free half of the blocks, and report what the tree
+ * occupies per block after the removals.
+ */
+static void free_tree_mem(mem_account_t *mem, block_t *node) {
+    if (!node)
+        return;
+    free_tree_mem(mem, node->l);
+    free_tree_mem(mem, node->r);
+    free_block_mem(mem, node);
+}
+
+static int bst_mem_report(void) {
+    for (int blocks = 1000; blocks <= 1000000; blocks *= 10) {
+        mem_account_t mem;
+        block_t *root = NULL;
+        block_t **table = (block_t **)malloc(blocks * sizeof(block_t *));
+        if (!table) {
+            fprintf(stderr, "Memory allocation failed\n");
+            return EXIT_FAILURE;
+        }
+        mem_account_init(&mem, "BST free index");
+        for (int i = 0; i < blocks; i++) {
+            table[i] = new_block_mem(&mem, (size_t)(uint32_t)(i * 2654435761u));
+            insert_free_tree(&root, table[i]);
+        }
+        /* sizes are distinct (odd multiplier mod 2^32), so find_free_tree is exact */
+        for (int i = blocks - 1; i >= blocks - blocks / 2; i--) {
+            block_t *node = *find_free_tree(&root, table[i]);
+            remove_free_tree(&root, node);
+            free_block_mem(&mem, node);
+        }
+        printf("%d blocks inserted, %d left", blocks, blocks - blocks / 2);
+        if (mem_account_enabled())
+            printf(": %.1f bytes/block with malloc overhead",
+                   (double)mem.live_footprint / (blocks - blocks / 2));
+        printf("\n");
+        mem_account_report(&mem, stdout);
+        free_tree_mem(&mem, root);
+        free(table);
+    }
+    return 0;
+}
+
 /* Main function to test the tree implementation. */
-int main() {
+int main(int argc, char *argv[]) {
     block_t *root = NULL;
     srand(time(NULL));
+    if (argc > 1 && strcmp(argv[1], "--mem") == 0)
+        return bst_mem_report();
 
     int array_size = 10000;
 
@@ -0,0 +1,467 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <stdint.h>
+
+#include "intrusive.h"
+#include "measure.h"
+
+// 鏈表元素結構：包含一個字串與鏈表節點
+typedef struct {
+    char *value;
+    struct list_head list;
+} element_t;
+
+#include "list_sort.h"
+
+// 遍歷鏈表並印出前 max_print 個元素的字串
+void print_list(struct list_head *head, int max_print) {
+    struct list_head *pos;
+    int count = 0;
+    for (pos = head->next; pos != head && count < max_print; pos = pos->next) {
+        element_t *elem = container_of(pos, element_t, list);
+        printf("Element %d: %s\n", count, elem->value);
+        count++;
+    }
+}
+
+
+/*---------------------- 指標陣列排序 ----------------------*/
+
+/*
+ * 走訪鏈表時每一步都是一次 cache miss：element_t 與 value 字串是分開
+ * malloc 的。這裡先把 (鍵值, 節點指標) 收集到連續的陣列，排序陣列，
+ * 最後一次走完陣列重新串接鏈表。排序期間只碰觸連續記憶體，
+ * 鍵值也已預先取出，大部分比較只是一次整數比較。
+ */
+typedef struct {
+    uint64_t key;
+    element_t *elem;
+} sort_item_t;
+
+// 數值鍵值：atoi 後翻轉符號位元，讓無號比較與有號順序一致
+static inline uint64_t array_key_numeric(const char *s)
+{
+    return (uint64_t) (uint32_t) atoi(s) ^ 0x80000000u;
+}
+
+// 字串鍵值：前 8 個位元組以 big-endian 組成整數，不足補 0
+static inline uint64_t array_key_string(const char *s)
+{
+    uint64_t key = 0;
+    int i = 0;
+    for (; i < 8 && s[i]; i++) {
+        key = (key << 8) | (unsigned char) s[i];
+    }
+    // 空字串時 i == 0，位移 64 位元是未定義行為
+    return i ? key << (8 * (8 - i)) : 0;
+}
+
+static inline bool array_less_numeric(const sort_item_t *a, const sort_item_t *b)
+{
+    return a->key < b->key;
+}
+
+// 前綴不同時直接比整數；前綴相同且 8 個位元組內沒有結尾時才比剩下的字串
+static inline bool array_less_string(const sort_item_t *a, const sort_item_t *b)
+{
+    if (a->key != b->key) {
+        return a->key < b->key;
+    }
+    if (!(a->key & 0xff)) {
+        return false;
+    }
+    return strcmp(a->elem->value + 8, b->elem->value + 8) < 0;
+}
+
+#define ARRAY_INSERTION_SORT_THRESHOLD 24
+#define ARRAY_PARTIAL_INSERTION_LIMIT 8
+
+/**
+ * DEFINE_ARRAY_SORT(name, key_fn, less) - 產生指標陣列排序 name
+ *
+ * 陣列排序採用 pattern-defeating quicksort 的主要技巧：
+ * - 三數取中選 pivot，左右兩側都有哨兵，分割迴圈不需要邊界檢查。
+ * - 分割時若完全沒有交換，先試著以有限步數的插入排序收尾，
+ *   已排序的輸入因此為 O(n)。
+ * - pivot 與前一個 pivot 相等時，把相等的元素一次分到左邊並略過，
+ *   大量重複鍵值不會退化。
+ * - 遞迴深度超過 2 * log2(n) 時改用 heapsort，最差為 O(n log n)。
+ */
+#define DEFINE_ARRAY_SORT(name, key_fn, less)                                  \
+    static void name##_insertion(sort_item_t *begin, sort_item_t *end)         \
+    {                                                                          \
+        for (sort_item_t *cur = begin + 1; cur < end; cur++) {                 \
+            sort_item_t tmp = *cur;                                            \
+            sort_item_t *sift = cur;                                           \
+            for (; sift > begin && less(&tmp, sift - 1); sift--) {             \
+                *sift = *(sift - 1);                                           \
+            }                                                                  \
+            *sift = tmp;                                                       \
+        }                                                                      \
+    }                                                                          \
+                                                                               \
+    /* 最多搬移 ARRAY_PARTIAL_INSERTION_LIMIT 次，超過就放棄並回傳 false */    \
+    static bool name##_partial_insertion(sort_item_t *begin, sort_item_t *end) \
+    {                                                                          \
+        size_t moves = 0;                                                      \
+        for (sort_item_t *cur = begin + 1; cur < end; cur++) {                 \
+            if (!less(cur, cur - 1)) {                                         \
+                continue;                                                      \
+            }                                                                  \
+            sort_item_t tmp = *cur;                                            \
+            sort_item_t *sift = cur;                                           \
+            for (; sift > begin && less(&tmp, sift - 1); sift--) {             \
+                *sift = *(sift - 1);                                           \
+            }                                                                  \
+            *sift = tmp;                                                       \
+            moves += cur - sift;                                               \
+            if (moves > ARRAY_PARTIAL_INSERTION_LIMIT) {                       \
+                return false;                                                  \
+            }                                                                  \
+        }                                                                      \
+        return true;                                                           \
+    }                                                                          \
+                                                                               \
+    static void name##_sift_down(sort_item_t *a, size_t i, size_t n)           \
+    {                                                                          \
+        sort_item_t tmp = a[i];                                                \
+        for (size_t child; (child = 2 * i + 1) < n; i = child) {               \
+            if (child + 1 < n && less(&a[child], &a[child + 1])) {             \
+                child++;                                                       \
+            }                                                                  \
+            if (!less(&tmp, &a[child])) {                                      \
+                break;                                                         \
+            }                                                                  \
+            a[i] = a[child];                                                   \
+        }                                                                      \
+        a[i] = tmp;                                                            \
+    }                                                                          \
+                                                                               \
+    static void name##_heapsort(sort_item_t *a, size_t n)                      \
+    {                                                                          \
+        for (size_t i = n / 2; i-- > 0;) {                                     \
+            name##_sift_down(a, i, n);                                         \
+        }                                                                      \
+        for (size_t i = n; i-- > 1;) {                                         \
+            sort_item_t tmp = a[0];                                            \
+            a[0] = a[i];                                                       \
+            a[i] = tmp;                                                        \
+            name##_sift_down(a, 0, i);                                         \
+        }                                                                      \
+    }                                                                          \
+                                                                               \
+    /* 讓 *a <= *b <= *c */                                                    \
+    static inline void name##_sort3(sort_item_t *a, sort_item_t *b,            \
+                                    sort_item_t *c)                            \
+    {                                                                          \
+        sort_item_t tmp;                                                       \
+        if (less(b, a)) { tmp = *a; *a = *b; *b = tmp; }                       \
+        if (less(c, b)) { tmp = *b; *b = *c; *c = tmp; }                       \
+        if (less(b, a)) { tmp = *a; *a = *b; *b = tmp; }                       \
+    }                                                                          \
+                                                                               \
+    /* pivot 在 *begin；小於 pivot 的放左邊，其餘放右邊，回傳 pivot 的位置 */  \
+    static sort_item_t *name##_partition_right(sort_item_t *begin,             \
+                                               sort_item_t *end,               \
+                                               bool *already_partitioned)      \
+    {                                                                          \
+        sort_item_t pivot = *begin, tmp;                                       \
+        sort_item_t *first = begin, *last = end;                               \
+        while (less(++first, &pivot))                                          \
+            ;                                                                  \
+        if (first - 1 == begin) {                                              \
+            while (first < last && !less(--last, &pivot))                      \
+                ;                                                              \
+        } else {                                                               \
+            while (!less(--last, &pivot))                                      \
+                ;                                                              \
+        }                                                                      \
+        *already_partitioned = first >= last;                                  \
+        while (first < last) {                                                 \
+            tmp = *first; *first = *last; *last = tmp;                         \
+            while (less(++first, &pivot))                                      \
+                ;                                                              \
+            while (!less(--last, &pivot))                                      \
+                ;                                                              \
+        }                                                                      \
+        sort_item_t *pivot_pos = first - 1;                                    \
+        *begin = *pivot_pos;                                                   \
+        *pivot_pos = pivot;                                                    \
+        return pivot_pos;                                                      \
+    }                                                                          \
+                                                                               \
+    /* 與 partition_right 相反：等於 pivot 的全部放左邊 */                     \
+    static sort_item_t *name##_partition_left(sort_item_t *begin,              \
+                                              sort_item_t *end)                \
+    {                                                                          \
+        sort_item_t pivot = *begin, tmp;                                       \
+        sort_item_t *first = begin, *last = end;                               \
+        while (less(&pivot, --last))                                           \
+            ;                                                                  \
+        if (last + 1 == end) {                                                 \
+            while (first < last && !less(&pivot, ++first))                     \
+                ;                                                              \
+        } else {                                                               \
+            while (!less(&pivot, ++first))                                     \
+                ;                                                              \
+        }                                                                      \
+        while (first < last) {                                                 \
+            tmp = *first; *first = *last; *last = tmp;                         \
+            while (less(&pivot, --last))                                       \
+                ;                                                              \
+            while (!less(&pivot, ++first))                                     \
+                ;                                                              \
+        }                                                                      \
+        *begin = *last;                                                        \
+        *last = pivot;                                                         \
+        return last;                                                           \
+    }                                                                          \
+                                                                               \
+    static void name##_loop(sort_item_t *begin, sort_item_t *end, int depth,   \
+                            bool leftmost)                                     \
+    {                                                                          \
+        while (end - begin > ARRAY_INSERTION_SORT_THRESHOLD) {                 \
+            size_t n = end - begin;                                            \
+            name##_sort3(begin + 1, begin, end - 1);                           \
+            name##_sort3(begin + n / 2, begin, end - 1);                       \
+                                                                               \
+            /* 前一個 pivot 不小於目前的 pivot：相等元素整段略過 */            \
+            if (!leftmost && !less(begin - 1, begin)) {                        \
+                begin = name##_partition_left(begin, end) + 1;                 \
+                continue;                                                      \
+            }                                                                  \
+            if (depth-- == 0) {                                                \
+                name##_heapsort(begin, n);                                     \
+                return;                                                        \
+            }                                                                  \
+                                                                               \
+            bool already_partitioned;                                          \
+            sort_item_t *pivot = name##_partition_right(begin, end,            \
+                                                        &already_partitioned); \
+            if (already_partitioned &&                                         \
+                name##_partial_insertion(begin, pivot) &&                      \
+                name##_partial_insertion(pivot + 1, end)) {                    \
+                return;                                                        \
+            }                                                                  \
+            /* 遞迴處理較小的一邊，較大的一邊以迴圈處理，堆疊深度 O(log n) */  \
+            if (pivot - begin < end - (pivot + 1)) {                           \
+                name##_loop(begin, pivot, depth, leftmost);                    \
+                begin = pivot + 1;                                             \
+                leftmost = false;                                              \
+            } else {                                                           \
+                name##_loop(pivot + 1, end, depth, false);                     \
+                end = pivot;                                                   \
+            }                                                                  \
+        }                                                                      \
+        name##_insertion(begin, end);                                          \
+    }                                                                          \
+                                                                               \
+    /**                                                                        \
+     * name - 收集節點到陣列、排序、再一次重新串接鏈表                         \
+     * 陣列配置失敗時回傳 false，鏈表保持原狀                                  \
+     */                                                                        \
+    bool name(struct list_head *head)                                          \
+    {                                                                          \
+        size_t n = 0;                                                          \
+        struct list_head *pos;                                                 \
+        for (pos = head->next; pos != head; pos = pos->next) {                 \
+            n++;                                                               \
+        }                                                                      \
+        if (n < 2) {                                                           \
+            return true;                                                       \
+        }                                                                      \
+        sort_item_t *items = malloc(n * sizeof(sort_item_t));                  \
+        if (!items) {                                                          \
+            return false;                                                      \
+        }                                                                      \
+        size_t i = 0;                                                          \
+        for (pos = head->next; pos != head; pos = pos->next, i++) {            \
+            items[i].elem = list_entry(pos, element_t, list);                  \
+            items[i].key = key_fn(items[i].elem->value);                       \
+        }                                                                      \
+                                                                               \
+        int depth = 0;                                                         \
+        for (size_t m = n; m > 1; m >>= 1) {                                   \
+            depth += 2;                                                        \
+        }                                                                      \
+        name##_loop(items, items + n, depth, true);                            \
+                                                                               \
+        /* 依陣列順序直接改寫 prev/next，一次完成重新串接 */                   \
+        struct list_head *prev = head;                                         \
+        for (i = 0; i < n; i++) {                                              \
+            struct list_head *node = &items[i].elem->list;                     \
+            node->prev = prev;                                                 \
+            prev->next = node;                                                 \
+            prev = node;                                                       \
+        }                                                                      \
+        prev->next = head;                                                     \
+        head->prev = prev;                                                     \
+        free(items);                                                           \
+        return true;                                                           \
+    }
+
+DEFINE_ARRAY_SORT(array_sort_numeric, array_key_numeric, array_less_numeric)
+DEFINE_ARRAY_SORT(array_sort_string, array_key_string, array_less_string)
+
+/*---------------------- 鏈表上的排序（對照組） ----------------------*/
+
+DEFINE_LIST_MERGE_SORT(list_merge_sort, cmp_numeric)
+
+/*---------------------- Main 測試 ----------------------*/
+
+// 比較排序為 O(n^2)，超過此大小就不跑
+#define QUADRATIC_SORT_LIMIT 10000
+// 小資料量時重複多次取最小值，減少計時雜訊
+#define BREAK_EVEN_REPEAT 15
+
+static void array_sort_numeric_void(struct list_head *head)
+{
+    if (!array_sort_numeric(head)) {
+        list_merge_sort(head);
+    }
+}
+
+static void array_sort_string_void(struct list_head *head)
+{
+    if (!array_sort_string(head)) {
+        insertion_sort(head);
+    }
+}
+
+typedef struct {
+    const char *name;
+    void (*sort)(struct list_head *head);
+    bool numeric;     // true: 以 atoi 比較；false: 以 strcmp 比較
+    int max_elements;
+} sort_case_t;
+
+static bool is_sorted(struct list_head *head, bool numeric, int n)
+{
+    struct list_head *pos;
+    int count = 0;
+    for (pos = head->next; pos != head; pos = pos->next, count++) {
+        if (pos->next->prev != pos) {
+            return false;
+        }
+        if (pos->next == head) {
+            continue;
+        }
+        const char *a = list_entry(pos, element_t, list)->value;
+        const char *b = list_entry(pos->next, element_t, list)->value;
+        if (numeric ? cmp_numeric(a, b) > 0 : cmp_string(a, b) > 0) {
+            return false;
+        }
+    }
+    return count == n;
+}
+
+// 以固定種子建立隊列，值域與其他排序程式相同
+static struct list_head *build_queue(int num_elements, unsigned seed)
+{
+    srand(seed);
+    struct list_head *queue = q_new();
+    if (!queue) {
+        return NULL;
+    }
+    for (int i = 0; i < num_elements; i++) {
+        char random_str[8];
+        sprintf(random_str, "%d", rand() % 1000);
+        if (!q_insert_head(queue, random_str)) {
+            q_free(queue);
+            return NULL;
+        }
+    }
+    return queue;
+}
+
+// 重複 repeat 次取最少的 cycles
+static int64_t time_sort(void (*sort)(struct list_head *), int n, int repeat,
+                         bool numeric, bool *ok)
+{
+    int64_t best = INT64_MAX;
+    *ok = true;
+    for (int r = 0; r < repeat; r++) {
+        struct list_head *queue = build_queue(n, 1);
+        if (!queue) {
+            *ok = false;
+            return 0;
+        }
+        int64_t cycles = measure_cycles_begin();
+        sort(queue);
+        cycles = measure_cycles_end() - cycles;
+        if (!is_sorted(queue, numeric, n)) {
+            *ok = false;
+        }
+        q_free(queue);
+        if (cycles < best) {
+            best = cycles;
+        }
+    }
+    return best;
+}
+
+/*---------------------- 效能測試 ----------------------*/
+
+#include "sort_bench.h"
+
+static const sort_bench_case_t bench_cases[] = {
+    {"array_sort_numeric", array_sort_numeric_void, SORT_BENCH_NO_LIMIT},
+    {"array_sort_string", array_sort_string_void, SORT_BENCH_NO_LIMIT},
+    {"list_merge_sort", list_merge_sort, SORT_BENCH_NO_LIMIT},
+};
+
+int main(int argc, char *argv[])
+{
+    // --bench：以固定種子跑完整的效能測試並輸出 CSV
+    if (argc > 1 && strcmp(argv[1], "--bench") == 0) {
+        return sort_bench_main(argc, argv, bench_cases,
+                               sizeof(bench_cases) / sizeof(bench_cases[0]));
+    }
+    const sort_case_t cases[] = {
+        {"array_sort_numeric", array_sort_numeric_void, true, 10000000},
+        {"list_merge_sort", list_merge_sort, true, 10000000},
+        {"sediment_sort", sediment_sort, true, QUADRATIC_SORT_LIMIT},
+        {"array_sort_string", array_sort_string_void, false, 10000000},
+        {"insertion_sort", insertion_sort, false, QUADRATIC_SORT_LIMIT},
+    };
+    bool ok;
+
+    printf("%-20s %10s %16s %12s\n", "sort", "elements", "cycles", "cycles/elem");
+    for (int n = 1000; n <= 1000000; n *= 10) {
+        for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+            if (n > cases[c].max_elements) {
+                printf("%-20s %10d %16s %12s\n", cases[c].name, n, "skipped", "-");
+                continue;
+            }
+            int64_t cycles = time_sort(cases[c].sort, n, 1, cases[c].numeric, &ok);
+            if (!ok) {
+                fprintf(stderr, "%s: list is not sorted\n", cases[c].name);
+                return 1;
+            }
+            printf("%-20s %10d %16ld %12.1f\n", cases[c].name, n, (long) cycles,
+                   (double) cycles / n);
+        }
+    }
+
+    // 找出陣列排序開始贏過鏈表合併排序的大小（含收集與重新串接的成本）
+    int break_even = 0;
+    printf("\n%10s %16s %16s\n", "elements", "array_sort", "list_merge_sort");
+    for (int n = 2; n <= 4096; n *= 2) {
+        int64_t array_cycles = time_sort(array_sort_numeric_void, n, BREAK_EVEN_REPEAT, true, &ok);
+        int64_t list_cycles = time_sort(list_merge_sort, n, BREAK_EVEN_REPEAT, true, &ok);
+        printf("%10d %16ld %16ld\n", n, (long) array_cycles, (long) list_cycles);
+        if (!break_even && array_cycles < list_cycles) {
+            break_even = n;
+        }
+    }
+    if (break_even) {
+        printf("break-even: array_sort_numeric wins from %d elements\n", break_even);
+    } else {
+        printf("break-even: not reached up to 4096 elements\n");
+    }
+    return 0;
+}
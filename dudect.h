@@ -0,0 +1,225 @@
+#ifndef DUDECT_H
+#define DUDECT_H
+
+/*
+ * dudect 式的執行時間差異分析
+ *
+ * 參考 Reparaz、Balasch、Verbauwhede，"Dude, is my code constant time?"：
+ * - 每次量測隨機指定為第 0 類或第 1 類輸入（通常是「固定輸入」對「隨機輸入」），
+ *   兩類交錯執行，避免環境的慢速漂移只影響其中一類。
+ * - 以 Welch t 檢定比較兩類的平均 cycles，不假設兩類變異數相同。
+ * - 量測分布有長尾（中斷、排程），除了完整資料外，另外對 100 個百分位數
+ *   做裁切各跑一次檢定，只保留低於該門檻的樣本；回報 |t| 最大的檢定。
+ * - 第一批量測只用來決定裁切門檻並暖機，不計入檢定。
+ *
+ * |t| 超過 DUDECT_T_THRESHOLD_MODERATE 時視為執行時間與輸入有關。
+ * 程式不需要連結 libm。
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "measure.h"
+
+#define DUDECT_NUMBER_PERCENTILES 100
+#define DUDECT_TESTS (1 + DUDECT_NUMBER_PERCENTILES)
+// 樣本數少於此值的檢定不列入判斷
+#define DUDECT_ENOUGH_MEASUREMENTS 10000
+#define DUDECT_T_THRESHOLD_MODERATE 10.0
+#define DUDECT_T_THRESHOLD_BANANAS 500.0
+
+/**
+ * dudect_target_t - 要分析的操作
+ * @name:         輸出用的名稱
+ * @measurements: 每批量測次數
+ * @ctx:          傳給 prepare 與 run 的資料
+ * @prepare:      依 classes[0 .. n) 準備 n 次量測的輸入，不計時
+ * @run:          執行第 i 次量測的操作，只有這段會計時
+ */
+typedef struct {
+    const char *name;
+    size_t measurements;
+    void *ctx;
+    void (*prepare)(void *ctx, const uint8_t *classes, size_t n);
+    void (*run)(void *ctx, size_t i);
+} dudect_target_t;
+
+// Welford 線上演算法累積兩類的平均與平方差和
+typedef struct {
+    double mean[2];
+    double m2[2];
+    double n[2];
+} dudect_ttest_t;
+
+static inline void dudect_ttest_push(dudect_ttest_t *t, double x, int cls)
+{
+    t->n[cls]++;
+    double delta = x - t->mean[cls];
+    t->mean[cls] += delta / t->n[cls];
+    t->m2[cls] += delta * (x - t->mean[cls]);
+}
+
+// 以牛頓法求平方根，省去 -lm
+static inline double dudect_sqrt(double x)
+{
+    if (x <= 0) {
+        return 0;
+    }
+    double r = x > 1 ? x : 1;
+    for (int i = 0; i < 64; i++) {
+        double next = 0.5 * (r + x / r);
+        if (next >= r) {
+            break;
+        }
+        r = next;
+    }
+    return r;
+}
+
+static inline double dudect_ttest_t_value(const dudect_ttest_t *t)
+{
+    if (t->n[0] < 2 || t->n[1] < 2) {
+        return 0;
+    }
+    double var0 = t->m2[0] / (t->n[0] - 1);
+    double var1 = t->m2[1] / (t->n[1] - 1);
+    double den = dudect_sqrt(var0 / t->n[0] + var1 / t->n[1]);
+    return den > 0 ? (t->mean[0] - t->mean[1]) / den : 0;
+}
+
+static inline uint64_t dudect_rand(uint64_t *state)
+{
+    uint64_t x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+static inline int dudect_cmp_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * dudect_set_percentiles - 由第一批量測決定各個裁切門檻
+ *
+ * 第 i 個門檻取 1 - 0.5^(10 * (i + 1) / N) 的百分位數，
+ * 越後面的門檻越接近最大值，越前面的只保留最快的樣本。
+ */
+static inline void dudect_set_percentiles(uint64_t *percentiles, const uint64_t *exec_times,
+                                   size_t n)
+{
+    uint64_t *sorted = malloc(n * sizeof(uint64_t));
+    if (!sorted) {
+        abort();
+    }
+    memcpy(sorted, exec_times, n * sizeof(uint64_t));
+    qsort(sorted, n, sizeof(uint64_t), dudect_cmp_u64);
+
+    // 2^(-10 / N)，N = 100
+    const double step = 0.93303299153680741598;
+    double tail = 1;
+    for (int i = 0; i < DUDECT_NUMBER_PERCENTILES; i++) {
+        tail *= step;
+        size_t idx = (size_t) ((1 - tail) * n);
+        percentiles[i] = sorted[idx < n ? idx : n - 1];
+    }
+    free(sorted);
+}
+
+/**
+ * dudect_run - 對 target 跑 batches 批量測並輸出結果
+ * @target:  要分析的操作
+ * @batches: 批數，第一批只用來決定裁切門檻
+ *
+ * 每批結束後印出目前 |t| 最大的檢定、兩類平均 cycles 與判斷。
+ * 回傳 1 表示發現執行時間與輸入類別有關，0 表示目前沒有證據。
+ */
+static inline int dudect_run(const dudect_target_t *target, int batches)
+{
+    size_t n = target->measurements;
+    uint8_t *classes = malloc(n);
+    uint64_t *exec_times = malloc(n * sizeof(uint64_t));
+    uint64_t percentiles[DUDECT_NUMBER_PERCENTILES];
+    dudect_ttest_t *tests = calloc(DUDECT_TESTS, sizeof(dudect_ttest_t));
+    if (!classes || !exec_times || !tests) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    uint64_t seed = measure_cycles_begin() | 1;
+    double max_t = 0;
+
+    printf("%s: %d batches of %zu measurements\n", target->name, batches, n);
+    for (int b = 0; b < batches; b++) {
+        for (size_t i = 0; i < n; i++) {
+            classes[i] = dudect_rand(&seed) & 1;
+        }
+        target->prepare(target->ctx, classes, n);
+        for (size_t i = 0; i < n; i++) {
+            uint64_t start = measure_cycles_begin();
+            target->run(target->ctx, i);
+            exec_times[i] = measure_cycles_end() - start;
+        }
+
+        if (b == 0) {
+            dudect_set_percentiles(percentiles, exec_times, n);
+            continue;
+        }
+        for (size_t i = 0; i < n; i++) {
+            double x = (double) exec_times[i];
+            dudect_ttest_push(&tests[0], x, classes[i]);
+            for (int p = 0; p < DUDECT_NUMBER_PERCENTILES; p++) {
+                if (exec_times[i] < percentiles[p]) {
+                    dudect_ttest_push(&tests[1 + p], x, classes[i]);
+                }
+            }
+        }
+
+        int max_test = -1;
+        max_t = 0;
+        for (int t = 0; t < DUDECT_TESTS; t++) {
+            if (tests[t].n[0] + tests[t].n[1] < DUDECT_ENOUGH_MEASUREMENTS) {
+                continue;
+            }
+            double value = dudect_ttest_t_value(&tests[t]);
+            if (value < 0) {
+                value = -value;
+            }
+            if (max_test < 0 || value > max_t) {
+                max_t = value;
+                max_test = t;
+            }
+        }
+        if (max_test < 0) {
+            printf("  batch %3d: not enough measurements yet\n", b);
+            continue;
+        }
+        const dudect_ttest_t *t = &tests[max_test];
+        const char *verdict = max_t > DUDECT_T_THRESHOLD_BANANAS ? "definitely not constant time"
+                              : max_t > DUDECT_T_THRESHOLD_MODERATE
+                                  ? "probably not constant time"
+                                  : "no evidence of input-dependent timing yet";
+        char label[24] = "uncropped";
+        if (max_test > 0) {
+            snprintf(label, sizeof(label), "crop #%d", max_test - 1);
+        }
+        printf("  batch %3d: samples %9.0f, max |t| %8.2f (%s), "
+               "mean cycles class0 %9.1f class1 %9.1f (diff %+.1f): %s\n",
+               b, tests[0].n[0] + tests[0].n[1], max_t, label, t->mean[0], t->mean[1],
+               t->mean[0] - t->mean[1], verdict);
+        fflush(stdout);
+    }
+
+    free(classes);
+    free(exec_times);
+    free(tests);
+    return max_t > DUDECT_T_THRESHOLD_MODERATE;
+}
+
+#endif /* DUDECT_H */
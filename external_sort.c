@@ -0,0 +1,516 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "intrusive.h"
+
+/*
+ * 外部排序工具：資料量超過記憶體時使用
+ *
+ *   external_sort [-n] [-m MiB] [-k fan-in] [-T tmpdir] input output
+ *   external_sort -g count output
+ *
+ * - -n：以數值排序（與 cmp_numeric 相同），預設為字典順序（strcmp）。
+ * - -m：排序階段可用的記憶體上限，預設 64 MiB。
+ * - -k：每次合併最多同時開啟的 run 數，預設 64。
+ * - -T：暫存檔目錄，預設為 $TMPDIR 或 /tmp。
+ * - -g：產生 count 筆 rand() 整數到 output，用來測試。
+ * 每一行是一筆記錄。統計資訊輸出到 stderr。
+ */
+
+// 鏈表元素結構：包含一個字串與鏈表節點
+typedef struct {
+    char *value;
+    struct list_head list;
+} element_t;
+
+#include "list_sort.h"
+
+/*---------------------- 比較器 ----------------------*/
+
+// 依命令列選項選擇比較器；整個執行期間不變，分支可完全預測
+static inline int record_cmp(bool numeric, const char *a, const char *b)
+{
+    return numeric ? cmp_numeric(a, b) : cmp_string(a, b);
+}
+
+/*---------------------- 記憶體內排序 ----------------------*/
+
+DEFINE_LIST_MERGE_SORT(list_merge_sort_numeric, cmp_numeric)
+DEFINE_LIST_MERGE_SORT(list_merge_sort_string, cmp_string)
+
+// 依命令列選項選擇排序；每個 chunk 只判斷一次
+static void list_merge_sort(struct list_head *head, bool numeric)
+{
+    if (numeric) {
+        list_merge_sort_numeric(head);
+    } else {
+        list_merge_sort_string(head);
+    }
+}
+
+/*---------------------- 設定與統計 ----------------------*/
+
+#define DEFAULT_MEMORY_MB 64
+#define DEFAULT_FAN_IN 64
+#define MAX_FAN_IN 1024
+// 每個元素估計的 malloc 額外開銷
+#define MALLOC_OVERHEAD 16
+// 合併時每個檔案的 stdio 緩衝區大小範圍
+#define MIN_IO_BUFFER (64 * 1024)
+#define MAX_IO_BUFFER (4 * 1024 * 1024)
+
+typedef struct {
+    bool numeric;
+    size_t memory_limit;
+    int fan_in;
+    const char *tmpdir;
+} sort_config_t;
+
+typedef struct {
+    size_t records;
+    size_t initial_runs;
+    int merge_passes;
+    uint64_t bytes_read;
+    uint64_t bytes_written;
+    double run_seconds;
+    double merge_seconds;
+} sort_stats_t;
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*---------------------- run 檔案 ----------------------*/
+
+typedef struct {
+    char path[4096];
+} run_file_t;
+
+typedef struct {
+    run_file_t *files;
+    size_t count;
+    size_t capacity;
+} run_list_t;
+
+// 建立新的暫存檔並以寫入模式開啟
+static FILE *run_create(run_list_t *runs, const sort_config_t *cfg)
+{
+    if (runs->count == runs->capacity) {
+        size_t capacity = runs->capacity ? runs->capacity * 2 : 16;
+        run_file_t *files = realloc(runs->files, capacity * sizeof(run_file_t));
+        if (!files) {
+            return NULL;
+        }
+        runs->files = files;
+        runs->capacity = capacity;
+    }
+    run_file_t *run = &runs->files[runs->count];
+    snprintf(run->path, sizeof(run->path), "%s/external_sort.XXXXXX", cfg->tmpdir);
+    int fd = mkstemp(run->path);
+    if (fd < 0) {
+        return NULL;
+    }
+    FILE *fp = fdopen(fd, "w");
+    if (!fp) {
+        close(fd);
+        unlink(run->path);
+        return NULL;
+    }
+    runs->count++;
+    return fp;
+}
+
+static void run_list_cleanup(run_list_t *runs, size_t from)
+{
+    for (size_t i = from; i < runs->count; i++) {
+        unlink(runs->files[i].path);
+    }
+    free(runs->files);
+}
+
+// 依序寫出已排序的鏈表，並釋放所有元素
+static bool write_and_free_list(struct list_head *head, FILE *fp, uint64_t *bytes)
+{
+    struct list_head *pos, *safe;
+    bool ok = true;
+    list_for_each_safe(pos, safe, head) {
+        element_t *elem = list_entry(pos, element_t, list);
+        if (ok) {
+            size_t len = strlen(elem->value);
+            elem->value[len] = '\n';  // 配置時已多留一個位元組
+            ok = fwrite(elem->value, 1, len + 1, fp) == len + 1;
+            *bytes += len + 1;
+        }
+        free(elem);
+    }
+    INIT_LIST_HEAD(head);
+    return ok;
+}
+
+/**
+ * create_runs - 讀取輸入，每填滿 memory_limit 就排序並寫成一個 run 檔
+ *
+ * 元素與字串一次配置：value 緊接在 element_t 後面，
+ * 並多留一個位元組讓寫出時可以直接把結尾換成換行。
+ */
+static bool create_runs(FILE *in, run_list_t *runs, const sort_config_t *cfg,
+                        sort_stats_t *stats)
+{
+    struct list_head chunk;
+    size_t chunk_bytes = 0;
+    char *line = NULL;
+    size_t line_cap = 0;
+    ssize_t len;
+    bool ok = true;
+
+    INIT_LIST_HEAD(&chunk);
+    while (ok && (len = getline(&line, &line_cap, in)) >= 0) {
+        stats->bytes_read += len;
+        if (len > 0 && line[len - 1] == '\n') {
+            line[--len] = '\0';
+        }
+        element_t *elem = malloc(sizeof(element_t) + len + 2);
+        if (!elem) {
+            ok = false;
+            break;
+        }
+        elem->value = (char *) (elem + 1);
+        memcpy(elem->value, line, len + 1);
+        list_add_tail(&elem->list, &chunk);
+        stats->records++;
+        chunk_bytes += sizeof(element_t) + len + 2 + MALLOC_OVERHEAD;
+
+        if (chunk_bytes >= cfg->memory_limit) {
+            list_merge_sort(&chunk, cfg->numeric);
+            FILE *fp = run_create(runs, cfg);
+            ok = fp && write_and_free_list(&chunk, fp, &stats->bytes_written);
+            ok = fp && fclose(fp) == 0 && ok;
+            chunk_bytes = 0;
+        }
+    }
+    if (ok && !list_empty(&chunk)) {
+        list_merge_sort(&chunk, cfg->numeric);
+        FILE *fp = run_create(runs, cfg);
+        ok = fp && write_and_free_list(&chunk, fp, &stats->bytes_written);
+        ok = fp && fclose(fp) == 0 && ok;
+    }
+    // 發生錯誤時釋放剩下的元素
+    struct list_head *pos, *safe;
+    list_for_each_safe(pos, safe, &chunk) {
+        free(list_entry(pos, element_t, list));
+    }
+    free(line);
+    return ok && !ferror(in);
+}
+
+/*---------------------- k 路合併 ----------------------*/
+
+typedef struct {
+    FILE *fp;
+    char *line;
+    size_t cap;
+    bool done;
+    char *buffer;
+} run_reader_t;
+
+// 讀入下一筆記錄，去掉結尾換行
+static bool reader_next(run_reader_t *r, uint64_t *bytes)
+{
+    ssize_t len = getline(&r->line, &r->cap, r->fp);
+    if (len < 0) {
+        r->done = true;
+        return !ferror(r->fp);
+    }
+    *bytes += len;
+    if (len > 0 && r->line[len - 1] == '\n') {
+        r->line[len - 1] = '\0';
+    }
+    return true;
+}
+
+/*
+ * 敗者樹：tree[1..k-1] 存放每場比賽的敗者，tree[0] 為整體勝者。
+ * 已讀完的 run 視為 +inf，建樹時以虛擬索引 k 代表 -inf，
+ * 鍵值相同時索引小者勝，讓合併保持穩定。
+ */
+typedef struct {
+    int k;
+    int *tree;
+    run_reader_t *readers;
+    bool numeric;
+} loser_tree_t;
+
+static inline bool loser_tree_beats(const loser_tree_t *lt, int a, int b)
+{
+    if (a == lt->k || b == lt->k) {
+        return a == lt->k;
+    }
+    bool a_done = lt->readers[a].done, b_done = lt->readers[b].done;
+    if (a_done || b_done) {
+        return !a_done || (b_done && a < b);
+    }
+    int diff = record_cmp(lt->numeric, lt->readers[a].line, lt->readers[b].line);
+    return diff < 0 || (diff == 0 && a < b);
+}
+
+static void loser_tree_adjust(loser_tree_t *lt, int s)
+{
+    for (int t = (s + lt->k) >> 1; t > 0; t >>= 1) {
+        if (loser_tree_beats(lt, lt->tree[t], s)) {
+            int tmp = s;
+            s = lt->tree[t];
+            lt->tree[t] = tmp;
+        }
+    }
+    lt->tree[0] = s;
+}
+
+/**
+ * merge_files - 把 runs->files[first .. first + k) 合併寫到 out
+ *
+ * 每個輸入檔使用 io_buffer 位元組的 stdio 緩衝區，循序讀取。
+ */
+static bool merge_files(run_list_t *runs, size_t first, int k, FILE *out,
+                        size_t io_buffer, const sort_config_t *cfg, sort_stats_t *stats)
+{
+    run_reader_t *readers = calloc(k, sizeof(run_reader_t));
+    int *tree = malloc(k * sizeof(int));
+    bool ok = readers && tree;
+
+    for (int i = 0; ok && i < k; i++) {
+        readers[i].fp = fopen(runs->files[first + i].path, "r");
+        readers[i].buffer = malloc(io_buffer);
+        ok = readers[i].fp && readers[i].buffer &&
+             setvbuf(readers[i].fp, readers[i].buffer, _IOFBF, io_buffer) == 0 &&
+             reader_next(&readers[i], &stats->bytes_read);
+    }
+
+    if (ok) {
+        loser_tree_t lt = {.k = k, .tree = tree, .readers = readers, .numeric = cfg->numeric};
+        for (int i = 0; i < k; i++) {
+            tree[i] = k;
+        }
+        for (int i = k - 1; i >= 0; i--) {
+            loser_tree_adjust(&lt, i);
+        }
+        while (ok && !readers[tree[0]].done) {
+            int w = tree[0];
+            size_t len = strlen(readers[w].line);
+            readers[w].line[len] = '\n';
+            ok = fwrite(readers[w].line, 1, len + 1, out) == len + 1;
+            stats->bytes_written += len + 1;
+            ok = ok && reader_next(&readers[w], &stats->bytes_read);
+            loser_tree_adjust(&lt, w);
+        }
+    }
+
+    for (int i = 0; readers && i < k; i++) {
+        if (readers[i].fp) {
+            fclose(readers[i].fp);
+        }
+        free(readers[i].buffer);
+        free(readers[i].line);
+        unlink(runs->files[first + i].path);
+    }
+    free(readers);
+    free(tree);
+    return ok;
+}
+
+/**
+ * fit_fan_in - 降低 fan_in，讓合併時的 I/O 緩衝區不超過記憶體上限
+ *
+ * 同時開啟 fan_in 個輸入與一個輸出，每個都需要至少 MIN_IO_BUFFER。
+ * 連 fan-in 2 都放不下時回傳 false。
+ */
+static bool fit_fan_in(sort_config_t *cfg)
+{
+    size_t max_files = cfg->memory_limit / MIN_IO_BUFFER;
+    if (max_files < 3) {
+        return false;
+    }
+    if ((size_t) cfg->fan_in + 1 > max_files) {
+        cfg->fan_in = (int) (max_files - 1);
+    }
+    return true;
+}
+
+// 每個同時開啟的檔案分到的緩衝區；fit_fan_in 之後一定不小於 MIN_IO_BUFFER
+static size_t merge_io_buffer(const sort_config_t *cfg)
+{
+    size_t io_buffer = cfg->memory_limit / (cfg->fan_in + 1);
+    return io_buffer > MAX_IO_BUFFER ? MAX_IO_BUFFER : io_buffer;
+}
+
+/**
+ * merge_runs - 反覆合併 run，直到剩下的 run 數不超過 fan_in，再合併到 out
+ *
+ * 每一輪取最前面的 fan_in 個 run 合併成一個新的 run 放到最後，
+ * 記憶體上限平均分給同時開啟的檔案作為 I/O 緩衝區。
+ */
+static bool merge_runs(run_list_t *runs, FILE *out, const sort_config_t *cfg,
+                       sort_stats_t *stats)
+{
+    size_t first = 0;
+    size_t io_buffer = merge_io_buffer(cfg);
+
+    while (runs->count - first > (size_t) cfg->fan_in) {
+        FILE *fp = run_create(runs, cfg);
+        if (!fp) {
+            return false;
+        }
+        bool ok = merge_files(runs, first, cfg->fan_in, fp, io_buffer, cfg, stats);
+        ok = fclose(fp) == 0 && ok;
+        first += cfg->fan_in;
+        stats->merge_passes++;
+        if (!ok) {
+            run_list_cleanup(runs, first);
+            return false;
+        }
+    }
+    bool ok = true;
+    if (runs->count > first) {
+        ok = merge_files(runs, first, (int) (runs->count - first), out, io_buffer, cfg,
+                         stats);
+        stats->merge_passes++;
+    }
+    free(runs->files);
+    return ok;
+}
+
+/*---------------------- Main ----------------------*/
+
+static int generate(const char *count_str, const char *path)
+{
+    long count = strtol(count_str, NULL, 10);
+    FILE *out = fopen(path, "w");
+    if (!out || count < 0) {
+        fprintf(stderr, "cannot write %s\n", path);
+        return 1;
+    }
+    srand(1);
+    for (long i = 0; i < count; i++) {
+        fprintf(out, "%d\n", rand());
+    }
+    return fclose(out) == 0 ? 0 : 1;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [-n] [-m MiB] [-k fan-in] [-T tmpdir] input output\n"
+            "       %s -g count output\n",
+            prog, prog);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *tmpdir = getenv("TMPDIR");
+    sort_config_t cfg = {
+        .numeric = false,
+        .memory_limit = (size_t) DEFAULT_MEMORY_MB << 20,
+        .fan_in = DEFAULT_FAN_IN,
+        .tmpdir = tmpdir && *tmpdir ? tmpdir : "/tmp",
+    };
+    int opt;
+
+    while ((opt = getopt(argc, argv, "nm:k:T:g:")) != -1) {
+        switch (opt) {
+        case 'n':
+            cfg.numeric = true;
+            break;
+        case 'm':
+            cfg.memory_limit = strtoul(optarg, NULL, 10) << 20;
+            break;
+        case 'k':
+            cfg.fan_in = atoi(optarg);
+            break;
+        case 'T':
+            cfg.tmpdir = optarg;
+            break;
+        case 'g':
+            if (optind >= argc) {
+                usage(argv[0]);
+                return 1;
+            }
+            return generate(optarg, argv[optind]);
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (argc - optind != 2 || cfg.memory_limit == 0 || cfg.fan_in < 2 ||
+        cfg.fan_in > MAX_FAN_IN) {
+        usage(argv[0]);
+        return 1;
+    }
+    int requested_fan_in = cfg.fan_in;
+    if (!fit_fan_in(&cfg)) {
+        fprintf(stderr, "memory limit too small for a 2-way merge\n");
+        return 1;
+    }
+    if (cfg.fan_in != requested_fan_in) {
+        fprintf(stderr, "fan-in lowered from %d to %d to fit the memory limit\n",
+                requested_fan_in, cfg.fan_in);
+    }
+
+    FILE *in = fopen(argv[optind], "r");
+    if (!in) {
+        fprintf(stderr, "cannot open %s\n", argv[optind]);
+        return 1;
+    }
+    run_list_t runs = {NULL, 0, 0};
+    sort_stats_t stats = {0};
+
+    double start = now_seconds();
+    bool ok = create_runs(in, &runs, &cfg, &stats);
+    fclose(in);
+    stats.run_seconds = now_seconds() - start;
+    stats.initial_runs = runs.count;
+    if (!ok) {
+        fprintf(stderr, "run generation failed\n");
+        run_list_cleanup(&runs, 0);
+        return 1;
+    }
+    uint64_t run_bytes_read = stats.bytes_read;
+    uint64_t run_bytes_written = stats.bytes_written;
+
+    FILE *out = fopen(argv[optind + 1], "w");
+    if (!out) {
+        fprintf(stderr, "cannot write %s\n", argv[optind + 1]);
+        run_list_cleanup(&runs, 0);
+        return 1;
+    }
+    setvbuf(out, NULL, _IOFBF, merge_io_buffer(&cfg));
+    start = now_seconds();
+    ok = merge_runs(&runs, out, &cfg, &stats);
+    ok = fclose(out) == 0 && ok;
+    stats.merge_seconds = now_seconds() - start;
+    if (!ok) {
+        fprintf(stderr, "merge failed\n");
+        return 1;
+    }
+
+    uint64_t merge_io = stats.bytes_read - run_bytes_read + stats.bytes_written -
+                        run_bytes_written;
+    fprintf(stderr, "records:        %zu\n", stats.records);
+    fprintf(stderr, "memory limit:   %zu MiB\n", cfg.memory_limit >> 20);
+    fprintf(stderr, "initial runs:   %zu\n", stats.initial_runs);
+    fprintf(stderr, "merge passes:   %d (fan-in %d)\n", stats.merge_passes, cfg.fan_in);
+    fprintf(stderr, "run phase:      %.3f s, %.1f MiB/s read+write\n", stats.run_seconds,
+            (run_bytes_read + run_bytes_written) / 1048576.0 / stats.run_seconds);
+    fprintf(stderr, "merge phase:    %.3f s, %.1f MiB/s read+write\n", stats.merge_seconds,
+            merge_io / 1048576.0 / stats.merge_seconds);
+    return 0;
+}
@@ -3,6 +3,11 @@
 #include <stddef.h>
 #include <stdbool.h>
 #include <string.h>
+#include <time.h>
+
+#include "intrusive.h"
+#include "mem_account.h"
+#include "snapshot.h"
 
 #define GOLDEN_RATIO_32 0x61C88647
 static inline unsigned int hash(unsigned int val, unsigned int bits)
@@ -10,15 +15,15 @@ static inline unsigned int hash(unsigned int val, unsigned int bits)
     return (val * GOLDEN_RATIO_32) >> (32 - bits);
 }
 #define MAP_HASH_SIZE(bits) (1 << (bits))
-#define container_of(ptr, type, member) \
-    ((type *)((char *)(ptr) - offsetof(type, member)))
-
-struct hlist_head { struct hlist_node *first; };
-struct hlist_node { struct hlist_node *next, **pprev; };
 
 typedef struct {
     int bits;
     struct hlist_head *ht;
+    /* map_t itself, the bucket array and every hash_key; data is the caller's */
+    mem_account_t mem;
+    /* size of each key's data when the map allocated it itself and counts it
+     * in mem (map_snapshot_promote); 0 when data came from the caller */
+    size_t data_size;
 } map_t;
 
 struct hash_key {
@@ -30,8 +35,9 @@ struct hash_key {
 static struct hash_key *find_key(map_t *map, int key)
 {
     struct hlist_head *head = &map->ht[hash(key, map->bits)];
-    for (struct hlist_node *p = head->first; p; p = p->next) {
-        struct hash_key *kn = container_of(p, struct hash_key, node);
+    struct hlist_node *p;
+    hlist_for_each (p, head) {
+        struct hash_key *kn = hlist_entry(p, struct hash_key, node);
         if (kn->key == key)
             return kn;
     }
@@ -49,25 +55,26 @@ void map_add(map_t *map, int key, void *data)
     if (find_key(map, key))
         return;
 
-    struct hash_key *kn = malloc(sizeof(*kn));
+    struct hash_key *kn = mem_account_malloc(&map->mem, sizeof(*kn));
     kn->key = key;
     kn->data = data;
-
-    struct hlist_head *h = &map->ht[hash(key, map->bits)];
-    struct hlist_node *n = &kn->node, *first = h->first;
-
-    n->next = first;
-    if (first)
-        first->pprev = &n->next;
-    h->first = n;
-    n->pprev = &h->first;
+    hlist_add_head(&kn->node, &map->ht[hash(key, map->bits)]);
 }
 
 map_t *map_init(int bits)
 {
     map_t *map = malloc(sizeof(*map));
+    if (!map)
+        return NULL;
+    mem_account_init(&map->mem, "map_t");
+    mem_account_add(&map->mem, map, sizeof(*map));
     map->bits = bits;
-    map->ht = calloc(MAP_HASH_SIZE(bits), sizeof(*map->ht));
+    map->data_size = 0;
+    map->ht = mem_account_calloc(&map->mem, MAP_HASH_SIZE(bits), sizeof(*map->ht));
+    if (!map->ht) {
+        mem_account_free(&map->mem, map, sizeof(*map));
+        return NULL;
+    }
     return map;
 }
 
@@ -76,28 +83,16 @@ void map_deinit(map_t *map)
     if (!map) return;
 
     for (int i = 0; i < MAP_HASH_SIZE(map->bits); i++) {
-        struct hlist_head *head = &map->ht[i];
-        for (struct hlist_node *p = head->first; p;) {
-            struct hash_key *kn = container_of(p, struct hash_key, node);
-            struct hlist_node *n = p;
-            p = p->next;
-
-            if (n->pprev) {
-                struct hlist_node *next = n->next;
-                struct hlist_node **pprev = n->pprev;
-                *pprev = next;
-                if (next)
-                    next->pprev = pprev;
-                n->next = NULL;
-                n->pprev = NULL;
-            }
-
-            free(kn->data);
-            free(kn);
+        struct hlist_node *p, *safe;
+        hlist_for_each_safe (p, safe, &map->ht[i]) {
+            struct hash_key *kn = hlist_entry(p, struct hash_key, node);
+            hlist_del_init(p);
+            mem_account_free(map->data_size ? &map->mem : NULL, kn->data, map->data_size);
+            mem_account_free(&map->mem, kn, sizeof(*kn));
         }
     }
-    free(map->ht);
-    free(map);
+    mem_account_free(&map->mem, map->ht, MAP_HASH_SIZE(map->bits) * sizeof(*map->ht));
+    mem_account_free(&map->mem, map, sizeof(*map));
 }
 
 int *twoSum(int *nums, int numsSize, int target, int *returnSize)
@@ -121,8 +116,372 @@ int *twoSum(int *nums, int numsSize, int target, int *returnSize)
     return ret;
 }
 
-int main(void)
+/*
+ * Timing analysis (--dudect): class 0 looks up one fixed key that sits at the
+ * tail of its bucket chain, class 1 looks up random keys, half of which are
+ * absent. Any difference shows how much map_get latency depends on the key.
+ */
+#include "dudect.h"
+
+#define DUDECT_MAP_BITS 10
+#define DUDECT_MAP_KEYS 8192
+#define DUDECT_MEASUREMENTS 20000
+
+typedef struct {
+    map_t *map;
+    int fixed_key;
+    int keys[DUDECT_MEASUREMENTS];
+} map_dudect_ctx_t;
+
+static void *volatile map_dudect_sink;
+
+static void map_dudect_prepare(void *ctx, const uint8_t *classes, size_t n)
+{
+    map_dudect_ctx_t *c = ctx;
+    for (size_t i = 0; i < n; i++)
+        c->keys[i] = classes[i] ? rand() % (2 * DUDECT_MAP_KEYS) : c->fixed_key;
+}
+
+static void map_dudect_run(void *ctx, size_t i)
+{
+    map_dudect_ctx_t *c = ctx;
+    map_dudect_sink = map_get(c->map, c->keys[i]);
+}
+
+static int map_dudect(int batches)
+{
+    static map_dudect_ctx_t ctx;
+    ctx.map = map_init(DUDECT_MAP_BITS);
+    for (int key = 0; key < DUDECT_MAP_KEYS; key++) {
+        int *data = malloc(sizeof(int));
+        *data = key;
+        map_add(ctx.map, key, data);
+    }
+    /* map_add pushes to the chain head, so the first key ends up at the tail */
+    ctx.fixed_key = 0;
+
+    dudect_target_t target = {
+        .name = "map_get",
+        .measurements = DUDECT_MEASUREMENTS,
+        .ctx = &ctx,
+        .prepare = map_dudect_prepare,
+        .run = map_dudect_run,
+    };
+    int leaks = dudect_run(&target, batches);
+    map_deinit(ctx.map);
+    return leaks;
+}
+
+/*
+ * Memory footprint (--mem, build with -DMEM_ACCOUNT): fill maps of growing
+ * size and report what the map itself occupies, per key and in total.
+ */
+static int map_mem_report(void)
+{
+    for (int keys = 1000; keys <= 1000000; keys *= 10) {
+        int bits = 10;
+        while (MAP_HASH_SIZE(bits) < keys)
+            bits++;
+        map_t *map = map_init(bits);
+        for (int key = 0; key < keys; key++) {
+            int *data = malloc(sizeof(int));
+            *data = key;
+            map_add(map, key, data);
+        }
+        printf("%d keys, %d buckets", keys, MAP_HASH_SIZE(bits));
+        if (mem_account_enabled())
+            printf(": %.1f bytes/key with malloc overhead",
+                   (double) map->mem.live_footprint / keys);
+        printf("\n");
+        mem_account_report(&map->mem, stdout);
+        map_deinit(map);
+    }
+    return 0;
+}
+
+/*
+ * Snapshots: map_save writes the map as a position-independent image that
+ * map_snapshot_open maps read-only with no per-key work. Buckets are stored
+ * CSR style, so the image holds no pointers:
+ *
+ *   header | uint32_t start[buckets + 1] | entries[count]
+ *
+ * Bucket b owns entries[start[b] .. start[b + 1]) in chain order. The data
+ * of every key must point to an int, as it does in twoSum; the int is stored
+ * inline in the entry.
+ */
+#define MAP_SNAPSHOT_MAGIC "MAPSNAP"
+
+typedef struct {
+    int32_t key;
+    int32_t value;
+} map_snapshot_entry_t;
+
+typedef struct {
+    snapshot_t snap;
+    int bits;
+    const uint32_t *start;
+    const map_snapshot_entry_t *entries;
+} map_snapshot_t;
+
+static uint64_t map_snapshot_entries_offset(int bits)
+{
+    return snapshot_align(sizeof(snapshot_header_t) +
+                          ((uint64_t) MAP_HASH_SIZE(bits) + 1) * sizeof(uint32_t));
+}
+
+static uint64_t map_snapshot_size(int bits, uint64_t count)
+{
+    return map_snapshot_entries_offset(bits) + count * sizeof(map_snapshot_entry_t);
+}
+
+/* Write map to path; returns 0 on success, -1 on failure */
+int map_save(map_t *map, const char *path)
+{
+    int buckets = MAP_HASH_SIZE(map->bits);
+    uint32_t *start = malloc(((size_t) buckets + 1) * sizeof(*start));
+    if (!start)
+        return -1;
+
+    uint64_t count = 0;
+    for (int i = 0; i < buckets; i++) {
+        start[i] = (uint32_t) count;
+        struct hlist_node *p;
+        hlist_for_each (p, &map->ht[i])
+            count++;
+    }
+    if (count > UINT32_MAX) {
+        free(start);
+        return -1;
+    }
+    start[buckets] = (uint32_t) count;
+
+    uint64_t size = map_snapshot_size(map->bits, count);
+    FILE *f = snapshot_create(path, MAP_SNAPSHOT_MAGIC, count, map->bits, size);
+    if (!f) {
+        free(start);
+        return -1;
+    }
+    int ok = fwrite(start, sizeof(*start), (size_t) buckets + 1, f) == (size_t) buckets + 1 &&
+             snapshot_pad(f, map_snapshot_entries_offset(map->bits)) == 0;
+    free(start);
+    for (int i = 0; ok && i < buckets; i++) {
+        struct hlist_node *p;
+        hlist_for_each (p, &map->ht[i]) {
+            struct hash_key *kn = hlist_entry(p, struct hash_key, node);
+            map_snapshot_entry_t e = {kn->key, *(int *) kn->data};
+            if (fwrite(&e, sizeof(e), 1, f) != 1) {
+                ok = 0;
+                break;
+            }
+        }
+    }
+    if (!ok) {
+        /* a short image makes snapshot_finish discard the temporary file */
+        size = UINT64_MAX;
+    }
+    return snapshot_finish(f, path, size);
+}
+
+/*
+ * start[] must describe count entries split into consecutive buckets, or a
+ * lookup would index past the end of the image.
+ */
+static bool map_snapshot_start_valid(const uint32_t *start, int bits, uint64_t count)
+{
+    if (start[0] != 0)
+        return false;
+    for (int b = 0; b < MAP_HASH_SIZE(bits); b++) {
+        if (start[b + 1] < start[b])
+            return false;
+    }
+    return start[MAP_HASH_SIZE(bits)] == count;
+}
+
+/*
+ * Map a snapshot for read-only use; returns 0 on success, -1 on failure.
+ * Besides the header, the bucket table is checked once (one pass over
+ * start[], no per-key work), so get and promote can trust it.
+ */
+int map_snapshot_open(map_snapshot_t *ms, const char *path)
+{
+    if (snapshot_open(&ms->snap, path, MAP_SNAPSHOT_MAGIC) != 0)
+        return -1;
+    const snapshot_header_t *h = ms->snap.header;
+    if (h->param < 1 || h->param > 30 || h->count > UINT32_MAX ||
+        h->image_size != map_snapshot_size((int) h->param, h->count) ||
+        !map_snapshot_start_valid(snapshot_section(&ms->snap, sizeof(snapshot_header_t)),
+                                  (int) h->param, h->count)) {
+        fprintf(stderr, "%s: corrupt map snapshot\n", path);
+        snapshot_close(&ms->snap);
+        return -1;
+    }
+    ms->bits = (int) h->param;
+    ms->start = snapshot_section(&ms->snap, sizeof(snapshot_header_t));
+    ms->entries = snapshot_section(&ms->snap, map_snapshot_entries_offset(ms->bits));
+    return 0;
+}
+
+/* Same as map_get, but returns a pointer into the read-only image */
+const int *map_snapshot_get(const map_snapshot_t *ms, int key)
+{
+    unsigned int b = hash(key, ms->bits);
+    for (uint32_t i = ms->start[b]; i < ms->start[b + 1]; i++) {
+        if (ms->entries[i].key == key)
+            return &ms->entries[i].value;
+    }
+    return NULL;
+}
+
+/*
+ * Build a mutable map_t from the image. Keys in the image are unique, so
+ * this skips the duplicate check in map_add, and each chain is rebuilt in
+ * its saved order. Walking the image front to back keeps the page faults on
+ * the image and the bucket array sequential. The result does not refer to
+ * the image, which may be closed afterwards. The map owns the int behind
+ * each key and counts it in map->mem. Returns NULL when out of memory.
+ */
+map_t *map_snapshot_promote(const map_snapshot_t *ms)
 {
+    map_t *map = map_init(ms->bits);
+    if (!map)
+        return NULL;
+    map->data_size = sizeof(int);
+    for (int b = 0; b < MAP_HASH_SIZE(ms->bits); b++) {
+        struct hlist_node *tail = NULL;
+        for (uint32_t i = ms->start[b]; i < ms->start[b + 1]; i++) {
+            struct hash_key *kn = mem_account_malloc(&map->mem, sizeof(*kn));
+            int *data = kn ? mem_account_malloc(&map->mem, sizeof(int)) : NULL;
+            if (!data) {
+                mem_account_free(&map->mem, kn, sizeof(*kn));
+                map_deinit(map);
+                return NULL;
+            }
+            *data = ms->entries[i].value;
+            kn->key = ms->entries[i].key;
+            kn->data = data;
+            if (tail)
+                hlist_add_behind(&kn->node, tail);
+            else
+                hlist_add_head(&kn->node, &map->ht[b]);
+            tail = &kn->node;
+        }
+    }
+    return map;
+}
+
+void map_snapshot_close(map_snapshot_t *ms)
+{
+    snapshot_close(&ms->snap);
+}
+
+/*
+ * Startup benchmark (--snapshot [max keys] [path]): for 10^6 keys and up,
+ * compare rebuilding a map with map_add against opening its snapshot, then
+ * time lookups on both and promoting the image back to a map_t. The page
+ * cache is warm after map_save, so "open" is the cost of mmap alone and the
+ * first lookups pay the minor faults. Both maps are live at once, so 10^8
+ * keys need about 13 GB of memory.
+ */
+#define SNAPSHOT_BENCH_LOOKUPS 1000000
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
+
+/* Distinct keys spread over the whole int range */
+static inline int snapshot_bench_key(uint32_t i)
+{
+    return (int) (i * 2654435761u);
+}
+
+static int map_snapshot_bench(long max_keys, const char *path)
+{
+    printf("%10s %10s %10s %10s %10s %10s %12s %12s %10s\n", "keys", "build_s", "save_s",
+           "MiB", "open_ms", "promote_s", "map_get_ns", "image_get_ns", "verify");
+    for (long keys = 1000000; keys <= max_keys; keys *= 10) {
+        int bits = 10;
+        while (MAP_HASH_SIZE(bits) < keys)
+            bits++;
+
+        double t0 = now_seconds();
+        map_t *map = map_init(bits);
+        for (long i = 0; i < keys; i++) {
+            int *data = malloc(sizeof(int));
+            *data = (int) i;
+            map_add(map, snapshot_bench_key((uint32_t) i), data);
+        }
+        double build = now_seconds() - t0;
+
+        t0 = now_seconds();
+        if (map_save(map, path) != 0)
+            return 1;
+        double save = now_seconds() - t0;
+
+        map_snapshot_t ms;
+        t0 = now_seconds();
+        if (map_snapshot_open(&ms, path) != 0)
+            return 1;
+        double open = now_seconds() - t0;
+
+        /* the same pseudo-random key sequence for both lookups */
+        uint32_t seed = 1;
+        long hits = 0;
+        t0 = now_seconds();
+        for (int i = 0; i < SNAPSHOT_BENCH_LOOKUPS; i++) {
+            seed = seed * 1103515245u + 12345u;
+            hits += map_snapshot_get(&ms, snapshot_bench_key(seed % keys)) != NULL;
+        }
+        double image_get = now_seconds() - t0;
+
+        seed = 1;
+        t0 = now_seconds();
+        for (int i = 0; i < SNAPSHOT_BENCH_LOOKUPS; i++) {
+            seed = seed * 1103515245u + 12345u;
+            hits += map_get(map, snapshot_bench_key(seed % keys)) != NULL;
+        }
+        double map_lookup = now_seconds() - t0;
+
+        /* promote before freeing map, so both start from an unfragmented heap */
+        t0 = now_seconds();
+        map_t *promoted = map_snapshot_promote(&ms);
+        double promote = now_seconds() - t0;
+        map_deinit(map);
+
+        bool ok = promoted && hits == 2L * SNAPSHOT_BENCH_LOOKUPS;
+        for (long i = 0; ok && i < keys; i++) {
+            int key = snapshot_bench_key((uint32_t) i);
+            const int *img = map_snapshot_get(&ms, key);
+            int *mut = map_get(promoted, key);
+            ok = img && mut && *img == i && *mut == i;
+        }
+        map_deinit(promoted);
+        map_snapshot_close(&ms);
+
+        printf("%10ld %10.3f %10.3f %10.1f %10.3f %10.3f %12.1f %12.1f %10s\n", keys, build,
+               save, (double) map_snapshot_size(bits, keys) / (1 << 20), open * 1e3, promote,
+               map_lookup * 1e9 / SNAPSHOT_BENCH_LOOKUPS,
+               image_get * 1e9 / SNAPSHOT_BENCH_LOOKUPS, ok ? "ok" : "FAIL");
+        if (!ok)
+            return 1;
+    }
+    unlink(path);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc > 1 && strcmp(argv[1], "--dudect") == 0)
+        return map_dudect(argc > 2 ? atoi(argv[2]) : 10);
+    if (argc > 1 && strcmp(argv[1], "--mem") == 0)
+        return map_mem_report();
+    if (argc > 1 && strcmp(argv[1], "--snapshot") == 0)
+        return map_snapshot_bench(argc > 2 ? atol(argv[2]) : 10000000,
+                                  argc > 3 ? argv[3] : "/tmp/map.snapshot");
+
     int nums[] = {2, 7, 11, 15};
     int size;
     int *ans = twoSum(nums, 4, 9, &size);
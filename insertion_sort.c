@@ -5,63 +5,8 @@
 #include <string.h>
 #include <time.h>
 
-
-
-#ifndef DUDECT_CPUCYCLES_H
-#define DUDECT_CPUCYCLES_H
-
-#include <stdint.h>
-
-// http://www.intel.com/content/www/us/en/embedded/training/ia-32-ia-64-benchmark-code-execution-paper.html
-static inline int64_t cpucycles(void)
-{
-#if defined(__i386__) || defined(__x86_64__)
-    unsigned int hi, lo;
-    __asm__ volatile("rdtsc\n\t" : "=a"(lo), "=d"(hi));
-    return ((int64_t) lo) | (((int64_t) hi) << 32);
-
-#elif defined(__aarch64__)
-    uint64_t val;
-    /* According to ARM DDI 0487F.c, from Armv8.0 to Armv8.5 inclusive, the
-     * system counter is at least 56 bits wide; from Armv8.6, the counter
-     * must be 64 bits wide.  So the system counter could be less than 64
-     * bits wide and it is attributed with the flag 'cap_user_time_short'
-     * is true.
-     */
-    asm volatile("mrs %0, cntvct_el0" : "=r"(val));
-    return val;
-#else
-#error Unsupported Architecture
-#endif
-}
-
-#endif
-
-#ifndef likely
- #define likely(x) __builtin_expect(!!(x), 1)
- #endif
- 
- #ifndef unlikely
- #define unlikely(x) __builtin_expect(!!(x), 0)
- #endif
- 
-// 宏：從成員指標反推結構體指標
-#define container_of(ptr, type, member) \
-    ((type *)((char *)(ptr) - offsetof(type, member)))
-
-#define list_for_each_safe(node, safe, head)                     \
-    for (node = (head)->next, safe = node->next; node != (head); \
-         node = safe, safe = node->next)
-#define list_for_each(node, head) \
-    for (node = (head)->next; node != (head); node = node->next)
-
-
-#define list_entry(node, type, member) container_of(node, type, member)
-// 雙向鏈表節點結構
-struct list_head {
-    struct list_head *prev;
-    struct list_head *next;
-};
+#include "intrusive.h"
+#include "measure.h"
 
 // 這個結構表示一個鏈表元素，內含一個字串和一個 list_head
 typedef struct {
@@ -69,132 +14,356 @@ typedef struct {
     struct list_head list;
 } element_t;
 
-// 初始化雙向鏈表頭
-static inline void INIT_LIST_HEAD(struct list_head *head)
-{
-    head->next = head;
-    head->prev = head;
-}
+#include "list_sort.h"
 
-// 在鏈表頭後插入一個節點
-static inline void list_add(struct list_head *node, struct list_head *head)
-{
-    struct list_head *next = head->next;
-    next->prev = node;
-    node->next = next;
-    node->prev = head;
-    head->next = node;
-}
-
-// 建立一個空的雙向鏈表（隊列）
-struct list_head *q_new()
-{
-    struct list_head *new_qhead = (struct list_head *) malloc(sizeof(struct list_head));
-    if (!new_qhead) {
-        return NULL;
+// 遍歷鏈表並印出前 max_print 個元素的字串（用 container_of 取得 element_t 指標）
+void print_list(struct list_head *head, int max_print) {
+    struct list_head *pos;
+    int count = 0;
+    for (pos = head->next; pos != head && count < max_print; pos = pos->next) {
+        element_t *elem = container_of(pos, element_t, list);
+        printf("Element %d: %s\n", count, elem->value);
+        count++;
     }
-    INIT_LIST_HEAD(new_qhead);
-    return new_qhead;
 }
 
-static inline void list_del(struct list_head *node)
-{
-    struct list_head *next = node->next;
-    struct list_head *prev = node->prev;
+// 插入排序：insertion_sort 與 insertion_sort_numeric 由 list_sort.h 產生，這裡補上其他比較器
+DEFINE_INSERTION_SORT(insertion_sort_length_first, cmp_length_first)
 
-    next->prev = prev;
-    prev->next = next;
+/*---------------------- 跳躍串列索引的插入排序 ----------------------*/
 
-#ifdef LIST_POISONING
-    node->next = NULL;
-    node->prev = NULL;
-#endif
-}
-static inline void list_add_tail(struct list_head *node, struct list_head *head)
-{
-    struct list_head *prev = head->prev;
+/*
+ * ans 鏈表本身就是跳躍串列的最底層，上面再疊 SKIP_MAX_LEVEL 層索引。
+ * 每個被插入的元素以 1/4 的機率往上多長一層索引塔（skip_node_t），
+ * 平均每個元素只需要 1/3 個額外指標。尋找插入位置時先在索引層由上往下
+ * 逼近，最後在 ans 上只需往前走幾步，整體為 O(log n) 次比較。
+ *
+ * 搜尋不從最高層的起點開始，而是從上一次插入的位置（finger）出發：
+ * 先往上爬到足以跨過目標的那一層，再往下逼近。新元素與上一個元素在 ans 中
+ * 相距 d 個位置時只需 O(log d) 次比較，幾乎已排序的輸入因此接近 O(n)。
+ */
+#define SKIP_MAX_LEVEL 16  // 4^16 個元素以內維持 O(log n)
 
-    prev->next = node;
-    node->next = head;
-    node->prev = prev;
-    head->prev = node;
-}
+typedef struct skip_node {
+    element_t *elem;
+    struct skip_node *next[];  // next[i] 為第 i 層索引的下一座塔
+} skip_node_t;
 
-static inline void list_move_tail(struct list_head *node,
-                                  struct list_head *head)
+typedef struct {
+    skip_node_t *head;                   // 所有層的起點，elem 為 NULL
+    skip_node_t *last[SKIP_MAX_LEVEL];   // 每一層最右邊的塔，用於尾端快速插入
+    skip_node_t *path[SKIP_MAX_LEVEL];   // 搜尋時的 update；height 以上各層恆為 head
+    skip_node_t **finger;                // 上一次插入位置在每一層的前一座塔（或新塔本身），
+                                         // 指向 last 或 path，不必逐層複製
+    int height;                          // 最高塔的層數，以上各層只有 head
+    uint32_t seed;
+} skip_index_t;
+
+// 回傳新塔的層數，P(level >= k) = 4^-k
+static inline int skip_random_level(skip_index_t *idx)
 {
-    list_del(node);
-    list_add_tail(node, head);
+    // xorshift32：固定種子，讓同一份輸入每次建出相同的索引
+    uint32_t x = idx->seed;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    idx->seed = x;
+
+    int level = 0;
+    while ((x & 3) == 0 && level < SKIP_MAX_LEVEL) {
+        level++;
+        x >>= 2;
+    }
+    return level;
 }
 
-
-// 在鏈表頭插入一個新元素，並將字串 s 複製到該元素中
-bool q_insert_head(struct list_head *head, char *s)
+static bool skip_index_init(skip_index_t *idx)
 {
-    if (!head) {
+    idx->head = calloc(1, sizeof(skip_node_t) + SKIP_MAX_LEVEL * sizeof(skip_node_t *));
+    if (!idx->head) {
         return false;
     }
-    element_t *new_qelement = (element_t *) malloc(sizeof(element_t));
-    if (!new_qelement) {
-        return false;
+    for (int i = 0; i < SKIP_MAX_LEVEL; i++) {
+        idx->last[i] = idx->head;
+        idx->path[i] = idx->head;
     }
-    new_qelement->value = strdup(s);
-    if (!new_qelement->value) {
-        free(new_qelement);
-        return false;
-    }
-    list_add(&new_qelement->list, head);
+    idx->finger = idx->path;
+    idx->height = 0;
+    idx->seed = 2463534242u;
     return true;
 }
 
+// 沿著第 0 層索引釋放所有塔，ans 鏈表本身不受影響
+static void skip_index_free(skip_index_t *idx)
+{
+    skip_node_t *node = idx->head;
+    while (node) {
+        skip_node_t *next = node->next[0];
+        free(node);
+        node = next;
+    }
+}
 
-// 遍歷鏈表並印出前 max_print 個元素的字串（用 container_of 取得 element_t 指標）
-void print_list(struct list_head *head, int max_print) {
-    struct list_head *pos;
-    int count = 0;
-    for (pos = head->next; pos != head && count < max_print; pos = pos->next) {
-        element_t *elem = container_of(pos, element_t, list);
-        printf("Element %d: %s\n", count, elem->value);
-        count++;
+/**
+ * skip_index_link - 替剛插入 ans 的元素建立索引塔，並把 finger 移到這個位置
+ * @update: update[i] 為第 i 層中新塔的前一座塔，必須是 idx->last 或 idx->path
+ *
+ * 建好後 update[i] 改指向新塔，update 就成為下一次搜尋的 finger。
+ * 配置失敗時只是少一座塔，排序結果仍然正確。
+ */
+static void skip_index_link(skip_index_t *idx, skip_node_t **update, element_t *elem)
+{
+    int level = skip_random_level(idx);
+    skip_node_t *node = level ? malloc(sizeof(skip_node_t) + level * sizeof(skip_node_t *))
+                              : NULL;
+
+    idx->finger = update;
+    if (!node) {
+        return;
+    }
+    node->elem = elem;
+    for (int i = 0; i < level; i++) {
+        node->next[i] = update[i]->next[i];
+        update[i]->next[i] = node;
+        if (!node->next[i]) {
+            idx->last[i] = node;
+        }
+        update[i] = node;
+    }
+    if (level > idx->height) {
+        idx->height = level;
     }
 }
 
-void insertion_sort(struct list_head *head) {
-    element_t *tp_node, *node;
-    struct list_head ans;  // 建立排序用的鏈表頭
-    struct list_head *temp, *pos, *ans_pos;
+/**
+ * DEFINE_SKIPLIST_INSERTION_SORT(name, cmp, fallback) - 以比較器 cmp 產生使用
+ * 跳躍串列索引的插入排序 name；索引配置失敗時改呼叫線性版本 fallback
+ *
+ * 說明：
+ * - 仍以 list_del/list_add 搬移節點，不複製字串。
+ * - 鍵值相同時插在既有元素之後，排序是穩定的。
+ * - 自適應：新元素不小於 ans 的最後一個元素、或小於第一個元素時，
+ *   直接接到尾端或頭端，只需一次比較；已排序或反向排序的輸入為 O(n)。
+ * - 緊接在上一個插入的元素 prev 之後時，先以兩次比較確認，索引的 update
+ *   就是目前的 finger；幾乎已排序的輸入大多走這條路。小於 prev 時也順便
+ *   省下尾端的比較。
+ * - 其他元素從 finger 出發（finger search）：
+ *   - key 不小於 finger[0]：往上爬，直到上一層的下一座塔已經大於 key。
+ *   - key 小於 finger[0]：往上爬，直到該層的 finger 不大於 key。
+ *   停下的那一層以上，finger 本身就是正確的 update；從這一層往下照常逼近。
+ *   與上一個插入位置相距 d 時為 O(log d) 次比較。
+ */
+#define DEFINE_SKIPLIST_INSERTION_SORT(name, cmp, fallback)                    \
+    void name(struct list_head *head)                                          \
+    {                                                                          \
+        struct list_head ans;                                                  \
+        struct list_head *temp, *pos;                                          \
+        element_t *prev = NULL; /* 上一個插入的元素 */                         \
+        skip_index_t idx;                                                      \
+                                                                               \
+        if (!skip_index_init(&idx)) {                                          \
+            fallback(head);                                                    \
+            return;                                                            \
+        }                                                                      \
+        INIT_LIST_HEAD(&ans);                                                  \
+                                                                               \
+        list_for_each_safe(pos, temp, head) {                                  \
+            element_t *tp_node = list_entry(pos, element_t, list);             \
+            const char *key = tp_node->value;                                  \
+            list_del(pos);                                                     \
+                                                                               \
+            /* 緊接在 prev 之後：幾乎已排序時最常見；prev 為尾端時交給尾端處理 */ \
+            bool before_prev = false;                                          \
+            if (prev && prev->list.next != &ans) {                             \
+                before_prev = cmp(prev->value, key) > 0;                       \
+                if (!before_prev &&                                            \
+                    cmp(key, list_entry(prev->list.next, element_t, list)->value) < 0) { \
+                    /* last 只能由尾端插入使用，換成 path */                   \
+                    if (idx.finger != idx.path) {                              \
+                        for (int i = 0; i < idx.height; i++) {                 \
+                            idx.path[i] = idx.finger[i];                       \
+                        }                                                      \
+                    }                                                          \
+                    list_add(pos, &prev->list);                                \
+                    skip_index_link(&idx, idx.path, tp_node);                  \
+                    prev = tp_node;                                            \
+                    continue;                                                  \
+                }                                                              \
+            }                                                                  \
+            /* 尾端：大於等於目前最大值（小於 prev 時不可能） */               \
+            if (!before_prev &&                                                \
+                (list_empty(&ans) ||                                           \
+                 cmp(key, list_entry(ans.prev, element_t, list)->value) >= 0)) { \
+                list_add_tail(pos, &ans);                                      \
+                skip_index_link(&idx, idx.last, tp_node);                      \
+                prev = tp_node;                                                \
+                continue;                                                      \
+            }                                                                  \
+            /* 頭端：小於目前最小值 */                                         \
+            if (cmp(key, list_entry(ans.next, element_t, list)->value) < 0) {  \
+                for (int i = 0; i < idx.height; i++) {                         \
+                    idx.path[i] = idx.head;                                    \
+                }                                                              \
+                list_add(pos, &ans);                                           \
+                skip_index_link(&idx, idx.path, tp_node);                      \
+                prev = tp_node;                                                \
+                continue;                                                      \
+            }                                                                  \
+                                                                               \
+            /* 從 finger 往上爬到足以跨過 key 的那一層 top */                  \
+            skip_node_t **finger = idx.finger;                                 \
+            int top = 0;                                                       \
+            if (finger[0] == idx.head || cmp(finger[0]->elem->value, key) <= 0) { \
+                while (top + 1 < idx.height && finger[top + 1]->next[top + 1] && \
+                       cmp(finger[top + 1]->next[top + 1]->elem->value, key) <= 0) { \
+                    top++;                                                     \
+                }                                                              \
+            } else {                                                           \
+                while (top < idx.height && finger[top] != idx.head &&          \
+                       cmp(finger[top]->elem->value, key) > 0) {               \
+                    top++;                                                     \
+                }                                                              \
+            }                                                                  \
+            /* top 以上的 finger 就是 update；從 top 往下找最後一個不大於 key 的塔 */ \
+            skip_node_t *x = top < idx.height ? finger[top] : idx.head;        \
+            if (finger != idx.path) {                                          \
+                for (int i = top + 1; i < idx.height; i++) {                   \
+                    idx.path[i] = finger[i];                                   \
+                }                                                              \
+            }                                                                  \
+            for (int i = top < idx.height ? top : idx.height - 1; i >= 0; i--) { \
+                while (x->next[i] && cmp(x->next[i]->elem->value, key) <= 0) { \
+                    x = x->next[i];                                            \
+                }                                                              \
+                idx.path[i] = x;                                               \
+            }                                                                  \
+            /* 在 ans 上從該塔往前走到最後一個不大於 key 的元素 */             \
+            struct list_head *ans_pos = x->elem ? &x->elem->list : &ans;       \
+            while (ans_pos->next != &ans &&                                    \
+                   cmp(list_entry(ans_pos->next, element_t, list)->value, key) <= 0) { \
+                ans_pos = ans_pos->next;                                       \
+            }                                                                  \
+            list_add(pos, ans_pos);                                            \
+            skip_index_link(&idx, idx.path, tp_node);                          \
+            prev = tp_node;                                                    \
+        }                                                                      \
+                                                                               \
+        skip_index_free(&idx);                                                 \
+        INIT_LIST_HEAD(head);                                                  \
+        list_for_each_safe(pos, temp, &ans) {                                  \
+            list_add_tail(pos, head);                                          \
+        }                                                                      \
+    }
 
-    INIT_LIST_HEAD(&ans);  // 初始化新的排序鏈表
+DEFINE_SKIPLIST_INSERTION_SORT(insertion_sort_skiplist, cmp_string, insertion_sort)
+DEFINE_SKIPLIST_INSERTION_SORT(insertion_sort_skiplist_numeric, cmp_numeric,
+                               insertion_sort_numeric)
+DEFINE_SKIPLIST_INSERTION_SORT(insertion_sort_skiplist_length_first, cmp_length_first,
+                               insertion_sort_length_first)
 
-    // 遍歷原本的鏈表，將每個節點移除後插入到排序鏈表 ans 中
-    list_for_each_safe(pos, temp, head) {
-        tp_node = list_entry(pos, element_t, list);  // 取得節點內容
-        list_del(pos);  // 從原鏈表移除
+/*---------------------- 與 qsort 對照 ----------------------*/
 
-        // 找出在排序鏈表中的正確位置（ans_pos 會指向第一個比 tp_node 大的節點）
-        ans_pos = ans.next;
-        while (ans_pos != &ans && strcmp(tp_node->value, list_entry(ans_pos, element_t, list)->value) > 0) {
-            ans_pos = ans_pos->next;
-        }
-        // 在 ans_pos 之前插入 tp_node
-        list_add(&tp_node->list, ans_pos->prev);
-    }
+#include "sort_check.h"
+
+/*---------------------- 效能測試 ----------------------*/
+
+#include "sort_bench.h"
+
+static const sort_bench_case_t bench_cases[] = {
+    {"insertion_sort", insertion_sort, SORT_BENCH_QUADRATIC_LIMIT},
+    {"insertion_sort_skiplist", insertion_sort_skiplist, SORT_BENCH_NO_LIMIT},
+};
+
+/*---------------------- 執行時間差異分析 ----------------------*/
 
-    // 將排序好的 ans 鏈表的節點移回原本的鏈表 head
-    INIT_LIST_HEAD(head);
-    list_for_each_safe(pos, temp, &ans) {
-        node = list_entry(pos, element_t, list);
-        list_add_tail(&node->list, head);
+#include "dudect.h"
+
+// 每次量測排序一條 DUDECT_LIST_LEN 個元素的鏈表
+#define DUDECT_LIST_LEN 32
+#define DUDECT_MEASUREMENTS 10000
+
+/*
+ * 第 0 類為固定輸入（已排序；由前往後找插入位置，每次都要走到底），
+ * 第 1 類為隨機輸入。
+ * 所有鏈表在 prepare 時預先建好，量測範圍只包含 insertion_sort 本身。
+ */
+typedef struct {
+    char values[1000][4];
+    struct list_head lists[DUDECT_MEASUREMENTS];
+    element_t nodes[DUDECT_MEASUREMENTS * DUDECT_LIST_LEN];
+} sort_dudect_ctx_t;
+
+static void sort_dudect_prepare(void *ctx, const uint8_t *classes, size_t n)
+{
+    sort_dudect_ctx_t *c = ctx;
+    for (size_t i = 0; i < n; i++) {
+        INIT_LIST_HEAD(&c->lists[i]);
+        for (int j = 0; j < DUDECT_LIST_LEN; j++) {
+            element_t *node = &c->nodes[i * DUDECT_LIST_LEN + j];
+            node->value = c->values[classes[i] ? rand() % 1000 : j];
+            list_add_tail(&node->list, &c->lists[i]);
+        }
     }
 }
 
+static void sort_dudect_run(void *ctx, size_t i)
+{
+    sort_dudect_ctx_t *c = ctx;
+    insertion_sort(&c->lists[i]);
+}
 
+static int sort_dudect(int batches)
+{
+    sort_dudect_ctx_t *ctx = malloc(sizeof(sort_dudect_ctx_t));
+    if (!ctx) {
+        fprintf(stderr, "Failed to allocate dudect context.\n");
+        return 1;
+    }
+    for (int v = 0; v < 1000; v++) {
+        sprintf(ctx->values[v], "%03d", v);
+    }
+    dudect_target_t target = {
+        .name = "insertion_sort",
+        .measurements = DUDECT_MEASUREMENTS,
+        .ctx = ctx,
+        .prepare = sort_dudect_prepare,
+        .run = sort_dudect_run,
+    };
+    int leaks = dudect_run(&target, batches);
+    free(ctx);
+    return leaks;
+}
 
-int main(void)
+int main(int argc, char *argv[])
 {
+    // --bench：以固定種子跑完整的效能測試並輸出 CSV
+    if (argc > 1 && strcmp(argv[1], "--bench") == 0) {
+        return sort_bench_main(argc, argv, bench_cases,
+                               sizeof(bench_cases) / sizeof(bench_cases[0]));
+    }
+    // --dudect [batches]：量測執行時間與輸入是否有關
+    if (argc > 1 && strcmp(argv[1], "--dudect") == 0) {
+        return sort_dudect(argc > 2 ? atoi(argv[2]) : 10);
+    }
     // 用時間作種子初始化隨機數生成器
     srand((unsigned)time(NULL));
 
+    // 檢查每個比較器版本都與 qsort 結果一致
+    if (!check_against_qsort(insertion_sort, qsort_cmp_string, cmp_string, 1000, 6000) ||
+        !check_against_qsort(insertion_sort_numeric, qsort_cmp_numeric, cmp_numeric, 1000, 6000) ||
+        !check_against_qsort(insertion_sort_length_first, qsort_cmp_length_first,
+                             cmp_length_first, 1000, 6000) ||
+        !check_against_qsort(insertion_sort_skiplist, qsort_cmp_string, cmp_string, 1000, 6000) ||
+        !check_against_qsort(insertion_sort_skiplist_numeric, qsort_cmp_numeric,
+                             cmp_numeric, 1000, 6000) ||
+        !check_against_qsort(insertion_sort_skiplist_length_first, qsort_cmp_length_first,
+                             cmp_length_first, 1000, 6000) ||
+        !check_against_qsort(insertion_sort_skiplist_numeric, qsort_cmp_numeric,
+                             cmp_numeric, 100000, SORT_CHECK_ASCENDING)) {
+        fprintf(stderr, "insertion_sort disagrees with qsort.\n");
+        return 1;
+    }
+
     // 建立空的雙向鏈表
     struct list_head *queue = q_new();
     if (!queue) {
@@ -205,22 +374,22 @@ int main(void)
     int num_elements = 6000;  // 插入 10000 個元素
 
     for (int i = 0; i < num_elements; i++) {
-        char *random_str = calloc(8, sizeof(char));
+        // q_insert_head 會複製字串，暫存在堆疊上即可
+        char random_str[8];
 
         int num = rand() % 6000;
         sprintf(random_str, "%d", num);
         if (!q_insert_head(queue, random_str)) {  // 根據需求，這裡也可以呼叫其他函式
             fprintf(stderr, "Failed to insert element.\n");
-            free(random_str);
             return 1;
         }
     }
     //print_list(queue, 20);
-    int ans = cpucycles();
-    insertion_sort(queue);
+    int64_t ans = measure_cycles_begin();
+    insertion_sort(queue);  // 大量資料可改用 insertion_sort_skiplist(queue)
     //print_list(queue, 20);
-    ans = cpucycles() - ans;
-    //printf("%d",ans );
+    ans = measure_cycles_end() - ans;
+    printf("insertion_sort CPU cycles: %ld\n", (long) ans);
 
     return 0;
 }
@@ -0,0 +1,565 @@
+#ifndef INTRUSIVE_H
+#define INTRUSIVE_H
+
+/*
+ * 共用的侵入式容器
+ *
+ * 各程式原本各自複製一份 list_head、container_of，
+ * hashtable.c 另有自己的 hlist，rbtree.c 的 block_t 也有自己的紅黑樹。
+ * 集中在這裡之後，效能修正（例如 list_del 或旋轉）一次就能套用到所有程式，
+ * 不同程式之間的效能比較也建立在相同的基本操作上。
+ *
+ * - 雙向鏈表：struct list_head，介面與 Linux 核心的 list.h 相同。
+ * - 單向雜湊串列：struct hlist_head / hlist_node，只有一個指標的桶頭。
+ * - 紅黑樹：struct rb_node / rb_root，呼叫端自行找插入位置，
+ *   以 rb_link_node 接上後呼叫 rb_insert_color 重新平衡，以 rb_erase 刪除。
+ *
+ * 計時一律使用 measure.h 序列化的 measure_cycles_begin/end，
+ * 不同程式的數字才能直接比較。
+ *
+ * 全部是 static inline，沒有用到的函式不會產生程式碼或警告。
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*---------------------- 共用巨集 ----------------------*/
+
+// 從成員指標反推結構體指標
+#define container_of(ptr, type, member) ((type *) ((char *) (ptr) - offsetof(type, member)))
+
+#ifndef likely
+#define likely(x) __builtin_expect(!!(x), 1)
+#endif
+
+#ifndef unlikely
+#define unlikely(x) __builtin_expect(!!(x), 0)
+#endif
+
+/*---------------------- 雙向鏈表 ----------------------*/
+
+// 雙向鏈表節點結構
+struct list_head {
+    struct list_head *prev;
+    struct list_head *next;
+};
+
+#define list_entry(node, type, member) container_of(node, type, member)
+
+#define list_first_entry(head, type, member) list_entry((head)->next, type, member)
+
+#define list_last_entry(head, type, member) list_entry((head)->prev, type, member)
+
+#define list_for_each(node, head) \
+    for (node = (head)->next; node != (head); node = node->next)
+
+#define list_for_each_safe(node, safe, head)                     \
+    for (node = (head)->next, safe = node->next; node != (head); \
+         node = safe, safe = node->next)
+
+// 初始化鏈表頭
+static inline void INIT_LIST_HEAD(struct list_head *head)
+{
+    head->next = head;
+    head->prev = head;
+}
+
+// 在鏈表頭後插入節點
+static inline void list_add(struct list_head *node, struct list_head *head)
+{
+    struct list_head *next = head->next;
+    next->prev = node;
+    node->next = next;
+    node->prev = head;
+    head->next = node;
+}
+
+// 在鏈表尾插入節點
+static inline void list_add_tail(struct list_head *node, struct list_head *head)
+{
+    struct list_head *prev = head->prev;
+    prev->next = node;
+    node->next = head;
+    node->prev = prev;
+    head->prev = node;
+}
+
+// 刪除鏈表中的節點；定義 LIST_POISONING 時把指標清成 NULL，方便抓出誤用
+static inline void list_del(struct list_head *node)
+{
+    struct list_head *next = node->next;
+    struct list_head *prev = node->prev;
+    next->prev = prev;
+    prev->next = next;
+#ifdef LIST_POISONING
+    node->next = NULL;
+    node->prev = NULL;
+#endif
+}
+
+// 刪除節點並讓它成為空鏈表，之後可以安全地再次刪除或判斷是否為空
+static inline void list_del_init(struct list_head *node)
+{
+    list_del(node);
+    INIT_LIST_HEAD(node);
+}
+
+// 判斷鏈表是否為空
+static inline int list_empty(const struct list_head *head)
+{
+    return (head->next == head);
+}
+
+// 判斷鏈表是否只有一個節點
+static inline int list_is_singular(const struct list_head *head)
+{
+    return (!list_empty(head) && head->prev == head->next);
+}
+
+// 把節點移到 head 之後
+static inline void list_move(struct list_head *node, struct list_head *head)
+{
+    list_del(node);
+    list_add(node, head);
+}
+
+// 把節點移到 head 的尾端
+static inline void list_move_tail(struct list_head *node, struct list_head *head)
+{
+    list_del(node);
+    list_add_tail(node, head);
+}
+
+// 將 list 整串接到 head 的尾端（O(1)），list 本身之後需重新初始化
+static inline void list_splice_tail(struct list_head *list, struct list_head *head)
+{
+    if (list_empty(list)) {
+        return;
+    }
+    struct list_head *first = list->next;
+    struct list_head *last = list->prev;
+    struct list_head *at = head->prev;
+
+    first->prev = at;
+    at->next = first;
+    last->next = head;
+    head->prev = last;
+}
+
+// 同 list_splice_tail，並把 list 重新初始化為空鏈表
+static inline void list_splice_tail_init(struct list_head *list, struct list_head *head)
+{
+    list_splice_tail(list, head);
+    INIT_LIST_HEAD(list);
+}
+
+/**
+ * list_cut_position - 把 head 開頭到 entry（含）為止的節點搬到 list
+ * @list:  接收節點的空鏈表
+ * @head:  原本的鏈表
+ * @entry: head 中的一個節點；為 head 本身時 list 成為空鏈表
+ */
+static inline void list_cut_position(struct list_head *list, struct list_head *head,
+                                     struct list_head *entry)
+{
+    if (entry == head) {
+        INIT_LIST_HEAD(list);
+        return;
+    }
+    struct list_head *new_first = entry->next;
+    list->next = head->next;
+    list->next->prev = list;
+    list->prev = entry;
+    entry->next = list;
+    head->next = new_first;
+    new_first->prev = head;
+}
+
+/*---------------------- 雜湊串列 ----------------------*/
+
+/*
+ * 桶頭只有一個指標，桶陣列的大小是雙向鏈表的一半。
+ * pprev 指向前一個節點的 next（或桶頭的 first），刪除時不需要知道桶頭。
+ */
+struct hlist_node {
+    struct hlist_node *next, **pprev;
+};
+
+struct hlist_head {
+    struct hlist_node *first;
+};
+
+#define hlist_entry(node, type, member) container_of(node, type, member)
+
+#define hlist_for_each(node, head) for (node = (head)->first; node; node = node->next)
+
+#define hlist_for_each_safe(node, safe, head) \
+    for (node = (head)->first; node && ((safe = node->next), 1); node = safe)
+
+static inline void INIT_HLIST_HEAD(struct hlist_head *head)
+{
+    head->first = NULL;
+}
+
+static inline void INIT_HLIST_NODE(struct hlist_node *node)
+{
+    node->next = NULL;
+    node->pprev = NULL;
+}
+
+// 節點不在任何串列中
+static inline bool hlist_unhashed(const struct hlist_node *node)
+{
+    return !node->pprev;
+}
+
+static inline bool hlist_empty(const struct hlist_head *head)
+{
+    return !head->first;
+}
+
+// 插入到桶的最前面
+static inline void hlist_add_head(struct hlist_node *node, struct hlist_head *head)
+{
+    struct hlist_node *first = head->first;
+    node->next = first;
+    if (first) {
+        first->pprev = &node->next;
+    }
+    head->first = node;
+    node->pprev = &head->first;
+}
+
+// 插入到 prev 之後
+static inline void hlist_add_behind(struct hlist_node *node, struct hlist_node *prev)
+{
+    node->next = prev->next;
+    prev->next = node;
+    node->pprev = &prev->next;
+    if (node->next) {
+        node->next->pprev = &node->next;
+    }
+}
+
+static inline void hlist_del(struct hlist_node *node)
+{
+    struct hlist_node *next = node->next;
+    struct hlist_node **pprev = node->pprev;
+    *pprev = next;
+    if (next) {
+        next->pprev = pprev;
+    }
+}
+
+// 刪除節點（若仍在串列中）並標記為不在串列中
+static inline void hlist_del_init(struct hlist_node *node)
+{
+    if (hlist_unhashed(node)) {
+        return;
+    }
+    hlist_del(node);
+    INIT_HLIST_NODE(node);
+}
+
+/*---------------------- 紅黑樹 ----------------------*/
+
+/*
+ * 節點帶有父指標與顏色，空子樹以 NULL 表示。
+ * 用法（以 size 為鍵值）：
+ *
+ *   struct rb_node **link = &root->node, *parent = NULL;
+ *   while (*link) {
+ *       parent = *link;
+ *       link = key < rb_entry(parent, block_t, node)->size ? &parent->left
+ *                                                          : &parent->right;
+ *   }
+ *   rb_link_node(&block->node, parent, link);
+ *   rb_insert_color(&block->node, root);
+ */
+enum rb_color { RB_COLOR_RED, RB_COLOR_BLACK };
+
+struct rb_node {
+    struct rb_node *parent, *left, *right;
+    enum rb_color color;
+};
+
+struct rb_root {
+    struct rb_node *node;
+};
+
+#define RB_ROOT ((struct rb_root){NULL})
+
+#define rb_entry(node, type, member) container_of(node, type, member)
+
+static inline bool __rb_is_red(const struct rb_node *node)
+{
+    return node && node->color == RB_COLOR_RED;
+}
+
+// 把新節點接到 parent 底下 link 所指的位置，顏色為紅色
+static inline void rb_link_node(struct rb_node *node, struct rb_node *parent,
+                                struct rb_node **link)
+{
+    node->parent = parent;
+    node->left = node->right = NULL;
+    node->color = RB_COLOR_RED;
+    *link = node;
+}
+
+// 把 parent 底下的 old 換成 new；parent 為 NULL 表示 old 是根
+static inline void __rb_replace_child(struct rb_root *root, struct rb_node *parent,
+                                      struct rb_node *old, struct rb_node *new)
+{
+    if (!parent) {
+        root->node = new;
+    } else if (parent->left == old) {
+        parent->left = new;
+    } else {
+        parent->right = new;
+    }
+}
+
+static inline void __rb_rotate_left(struct rb_root *root, struct rb_node *x)
+{
+    struct rb_node *y = x->right;
+    x->right = y->left;
+    if (y->left) {
+        y->left->parent = x;
+    }
+    y->parent = x->parent;
+    __rb_replace_child(root, x->parent, x, y);
+    y->left = x;
+    x->parent = y;
+}
+
+static inline void __rb_rotate_right(struct rb_root *root, struct rb_node *x)
+{
+    struct rb_node *y = x->left;
+    x->left = y->right;
+    if (y->right) {
+        y->right->parent = x;
+    }
+    y->parent = x->parent;
+    __rb_replace_child(root, x->parent, x, y);
+    y->right = x;
+    x->parent = y;
+}
+
+// rb_link_node 之後呼叫，恢復紅黑樹性質
+static inline void rb_insert_color(struct rb_node *node, struct rb_root *root)
+{
+    struct rb_node *parent;
+
+    while ((parent = node->parent) && parent->color == RB_COLOR_RED) {
+        // 父節點為紅色代表它不是根，一定有祖父節點
+        struct rb_node *gparent = parent->parent;
+        if (parent == gparent->left) {
+            struct rb_node *uncle = gparent->right;
+            if (__rb_is_red(uncle)) {
+                // Case 1：叔叔為紅色，重新著色後往上兩層繼續
+                parent->color = RB_COLOR_BLACK;
+                uncle->color = RB_COLOR_BLACK;
+                gparent->color = RB_COLOR_RED;
+                node = gparent;
+                continue;
+            }
+            if (node == parent->right) {
+                // Case 2：轉成 Case 3 的形狀
+                __rb_rotate_left(root, parent);
+                node = parent;
+                parent = node->parent;
+            }
+            // Case 3：以祖父為軸右旋
+            parent->color = RB_COLOR_BLACK;
+            gparent->color = RB_COLOR_RED;
+            __rb_rotate_right(root, gparent);
+        } else {
+            struct rb_node *uncle = gparent->left;
+            if (__rb_is_red(uncle)) {
+                parent->color = RB_COLOR_BLACK;
+                uncle->color = RB_COLOR_BLACK;
+                gparent->color = RB_COLOR_RED;
+                node = gparent;
+                continue;
+            }
+            if (node == parent->left) {
+                __rb_rotate_right(root, parent);
+                node = parent;
+                parent = node->parent;
+            }
+            parent->color = RB_COLOR_BLACK;
+            gparent->color = RB_COLOR_RED;
+            __rb_rotate_left(root, gparent);
+        }
+    }
+    root->node->color = RB_COLOR_BLACK;
+}
+
+/**
+ * __rb_erase_fixup - 刪除黑色節點後恢復紅黑樹性質
+ * @root:   樹根
+ * @x:      取代被刪除位置的節點，可能為 NULL
+ * @parent: x 的父節點；x 為 NULL 時無法由 x 得知，因此另外傳入
+ */
+static inline void __rb_erase_fixup(struct rb_root *root, struct rb_node *x,
+                                    struct rb_node *parent)
+{
+    while (x != root->node && !__rb_is_red(x)) {
+        if (x == parent->left) {
+            struct rb_node *w = parent->right;
+            if (__rb_is_red(w)) {
+                // Case 1：兄弟為紅色，轉成兄弟為黑色的情況
+                w->color = RB_COLOR_BLACK;
+                parent->color = RB_COLOR_RED;
+                __rb_rotate_left(root, parent);
+                w = parent->right;
+            }
+            if (!__rb_is_red(w->left) && !__rb_is_red(w->right)) {
+                // Case 2：兄弟的子節點都是黑色，問題往上移
+                w->color = RB_COLOR_RED;
+                x = parent;
+                parent = x->parent;
+                continue;
+            }
+            if (!__rb_is_red(w->right)) {
+                // Case 3：轉成 Case 4 的形狀
+                w->left->color = RB_COLOR_BLACK;
+                w->color = RB_COLOR_RED;
+                __rb_rotate_right(root, w);
+                w = parent->right;
+            }
+            // Case 4：以父節點為軸旋轉後結束
+            w->color = parent->color;
+            parent->color = RB_COLOR_BLACK;
+            w->right->color = RB_COLOR_BLACK;
+            __rb_rotate_left(root, parent);
+            x = root->node;
+            break;
+        } else {
+            struct rb_node *w = parent->left;
+            if (__rb_is_red(w)) {
+                w->color = RB_COLOR_BLACK;
+                parent->color = RB_COLOR_RED;
+                __rb_rotate_right(root, parent);
+                w = parent->left;
+            }
+            if (!__rb_is_red(w->left) && !__rb_is_red(w->right)) {
+                w->color = RB_COLOR_RED;
+                x = parent;
+                parent = x->parent;
+                continue;
+            }
+            if (!__rb_is_red(w->left)) {
+                w->right->color = RB_COLOR_BLACK;
+                w->color = RB_COLOR_RED;
+                __rb_rotate_left(root, w);
+                w = parent->left;
+            }
+            w->color = parent->color;
+            parent->color = RB_COLOR_BLACK;
+            w->left->color = RB_COLOR_BLACK;
+            __rb_rotate_right(root, parent);
+            x = root->node;
+            break;
+        }
+    }
+    if (x) {
+        x->color = RB_COLOR_BLACK;
+    }
+}
+
+static inline struct rb_node *__rb_leftmost(struct rb_node *node)
+{
+    while (node->left) {
+        node = node->left;
+    }
+    return node;
+}
+
+static inline struct rb_node *__rb_rightmost(struct rb_node *node)
+{
+    while (node->right) {
+        node = node->right;
+    }
+    return node;
+}
+
+// 從樹中移除 node，node 的記憶體由呼叫端處理
+static inline void rb_erase(struct rb_node *node, struct rb_root *root)
+{
+    struct rb_node *x, *x_parent;
+    enum rb_color removed_color = node->color;
+
+    if (!node->left || !node->right) {
+        // 最多一個子節點：直接以子節點取代
+        x = node->left ? node->left : node->right;
+        x_parent = node->parent;
+        __rb_replace_child(root, node->parent, node, x);
+        if (x) {
+            x->parent = x_parent;
+        }
+    } else {
+        // 兩個子節點：以後繼節點 y 取代 node，實際被移除的是 y 原本的位置
+        struct rb_node *y = __rb_leftmost(node->right);
+        removed_color = y->color;
+        x = y->right;
+        if (y->parent == node) {
+            x_parent = y;
+        } else {
+            x_parent = y->parent;
+            x_parent->left = x;
+            if (x) {
+                x->parent = x_parent;
+            }
+            y->right = node->right;
+            y->right->parent = y;
+        }
+        __rb_replace_child(root, node->parent, node, y);
+        y->parent = node->parent;
+        y->left = node->left;
+        y->left->parent = y;
+        y->color = node->color;
+    }
+    if (removed_color == RB_COLOR_BLACK) {
+        __rb_erase_fixup(root, x, x_parent);
+    }
+}
+
+// 最小的節點，空樹回傳 NULL
+static inline struct rb_node *rb_first(const struct rb_root *root)
+{
+    return root->node ? __rb_leftmost(root->node) : NULL;
+}
+
+// 最大的節點，空樹回傳 NULL
+static inline struct rb_node *rb_last(const struct rb_root *root)
+{
+    return root->node ? __rb_rightmost(root->node) : NULL;
+}
+
+// 中序的下一個節點
+static inline struct rb_node *rb_next(const struct rb_node *node)
+{
+    if (node->right) {
+        return __rb_leftmost(node->right);
+    }
+    while (node->parent && node == node->parent->right) {
+        node = node->parent;
+    }
+    return node->parent;
+}
+
+// 中序的前一個節點
+static inline struct rb_node *rb_prev(const struct rb_node *node)
+{
+    if (node->left) {
+        return __rb_rightmost(node->left);
+    }
+    while (node->parent && node == node->parent->left) {
+        node = node->parent;
+    }
+    return node->parent;
+}
+
+#endif /* INTRUSIVE_H */
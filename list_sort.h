@@ -0,0 +1,261 @@
+#ifndef LIST_SORT_H
+#define LIST_SORT_H
+
+/*
+ * 鏈表排序系列共用的隊列操作、比較器與合併排序
+ *
+ * 各排序程式原本各自複製 q_new、q_insert_head、q_free、比較器與
+ * list_merge_sort，對照組的排序因此可能在不同程式之間悄悄分歧。
+ * 集中在這裡之後，每個程式比較的都是同一份基準。
+ *
+ * - 隊列：q_new、q_insert_head、q_free，與 lab0 的 queue.c 相同。
+ * - 比較器：cmp_numeric、cmp_string、cmp_length_first。
+ * - DEFINE_LIST_MERGE_SORT(name, cmp)：以比較器產生穩定的合併排序。
+ * - DEFINE_SEDIMENT_SORT、DEFINE_INSERTION_SORT：O(n^2) 的對照組。各程式共用的
+ *   sediment_sort（數值）、insertion_sort（字典）與 insertion_sort_numeric
+ *   在這裡產生，其他比較器的版本由需要的程式自行產生。
+ *
+ * 使用前需先定義 element_t；鏈表操作來自 intrusive.h。
+ */
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "intrusive.h"
+
+/*---------------------- 隊列 ----------------------*/
+
+// 建立一個空的雙向鏈表（隊列）
+static inline struct list_head *q_new(void)
+{
+    struct list_head *new_qhead = malloc(sizeof(struct list_head));
+    if (!new_qhead) {
+        return NULL;
+    }
+    INIT_LIST_HEAD(new_qhead);
+    return new_qhead;
+}
+
+// 在鏈表頭插入新元素，並複製字串 s
+static inline bool q_insert_head(struct list_head *head, char *s)
+{
+    if (!head) {
+        return false;
+    }
+    element_t *new_qelement = malloc(sizeof(element_t));
+    if (!new_qelement) {
+        return false;
+    }
+    new_qelement->value = strdup(s);
+    if (!new_qelement->value) {
+        free(new_qelement);
+        return false;
+    }
+    list_add(&new_qelement->list, head);
+    return true;
+}
+
+// 釋放整個隊列（包含元素與字串）
+static inline void q_free(struct list_head *head)
+{
+    if (!head) {
+        return;
+    }
+    struct list_head *pos, *safe;
+    list_for_each_safe(pos, safe, head) {
+        element_t *elem = list_entry(pos, element_t, list);
+        free(elem->value);
+        free(elem);
+    }
+    free(head);
+}
+
+/*---------------------- 比較器 ----------------------*/
+
+// 所有比較器皆回傳 <0、0、>0，並以 static inline 定義，
+// 排序模板直接展開呼叫，不經過函式指標
+
+// 數值順序：以 (a > b) - (a < b) 取代 atoi 相減，避免溢位
+static inline int cmp_numeric(const char *a, const char *b)
+{
+    int x = atoi(a), y = atoi(b);
+    return (x > y) - (x < y);
+}
+
+// 字典順序：與 strcmp 相同
+static inline int cmp_string(const char *a, const char *b)
+{
+    return strcmp(a, b);
+}
+
+// 自訂順序範例：先比長度再比字典順序，對非負且無前導零的十進位字串
+// 與數值順序相同，但不需要 atoi
+static inline int cmp_length_first(const char *a, const char *b)
+{
+    size_t la = strlen(a), lb = strlen(b);
+    if (la != lb) {
+        return (la > lb) - (la < lb);
+    }
+    return strcmp(a, b);
+}
+
+/*---------------------- 合併排序 ----------------------*/
+
+/**
+ * DEFINE_LIST_MERGE_SORT(name, cmp) - 以比較器 cmp 產生穩定的 bottom-up 合併排序 name
+ *
+ * 說明：
+ * - name##_merge 合併兩條以 next 串起、以 NULL 結尾的單向串列；相等時 a 優先，保持穩定。
+ * - bins[i] 存放長度為 2^i 的已排序串列，每加入一個節點就像二進位加法
+ *   一樣往上進位合併，不需要遞迴。
+ * - 排序期間只使用 next，完成後再走一次補回 prev。
+ */
+#define DEFINE_LIST_MERGE_SORT(name, cmp)                                         \
+    static struct list_head *name##_merge(struct list_head *a, struct list_head *b) \
+    {                                                                             \
+        struct list_head *head = NULL, **tail = &head;                            \
+                                                                                  \
+        for (;;) {                                                                \
+            if (cmp(list_entry(a, element_t, list)->value,                        \
+                    list_entry(b, element_t, list)->value) <= 0) {                \
+                *tail = a;                                                        \
+                tail = &a->next;                                                  \
+                a = a->next;                                                      \
+                if (!a) {                                                         \
+                    *tail = b;                                                    \
+                    break;                                                        \
+                }                                                                 \
+            } else {                                                              \
+                *tail = b;                                                        \
+                tail = &b->next;                                                  \
+                b = b->next;                                                      \
+                if (!b) {                                                         \
+                    *tail = a;                                                    \
+                    break;                                                        \
+                }                                                                 \
+            }                                                                     \
+        }                                                                         \
+        return head;                                                              \
+    }                                                                             \
+                                                                                  \
+    void name(struct list_head *head)                                             \
+    {                                                                             \
+        if (list_empty(head) || list_is_singular(head)) {                         \
+            return;                                                               \
+        }                                                                         \
+        struct list_head *bins[64] = {NULL};                                      \
+        int max_bin = 0;                                                          \
+                                                                                  \
+        head->prev->next = NULL;                                                  \
+        struct list_head *node = head->next;                                      \
+        while (node) {                                                            \
+            struct list_head *next = node->next;                                  \
+            struct list_head *carry = node;                                       \
+            int i = 0;                                                            \
+                                                                                  \
+            carry->next = NULL;                                                   \
+            /* bins[i] 中的節點都比 carry 早出現，放在前面以保持穩定 */           \
+            for (; bins[i]; i++) {                                                \
+                carry = name##_merge(bins[i], carry);                             \
+                bins[i] = NULL;                                                   \
+            }                                                                     \
+            bins[i] = carry;                                                      \
+            if (i > max_bin) {                                                    \
+                max_bin = i;                                                      \
+            }                                                                     \
+            node = next;                                                          \
+        }                                                                         \
+                                                                                  \
+        struct list_head *sorted = NULL;                                          \
+        for (int i = 0; i <= max_bin; i++) {                                      \
+            if (bins[i]) {                                                        \
+                sorted = sorted ? name##_merge(bins[i], sorted) : bins[i];        \
+            }                                                                     \
+        }                                                                         \
+                                                                                  \
+        /* 補回 prev 指標 */                                                      \
+        struct list_head *prev = head;                                            \
+        head->next = sorted;                                                      \
+        for (node = sorted; node; node = node->next) {                            \
+            node->prev = prev;                                                    \
+            prev = node;                                                          \
+        }                                                                         \
+        prev->next = head;                                                        \
+        head->prev = prev;                                                        \
+    }
+
+/*---------------------- 沉積排序 ----------------------*/
+
+// 沉積排序（以交換數值方式實作）
+// 此版本以泡沫排序為基礎，並利用 last 來縮小每輪比較範圍
+// DEFINE_SEDIMENT_SORT(name, cmp) 以比較器 cmp 產生排序函式 name
+#define DEFINE_SEDIMENT_SORT(name, cmp)                                     \
+    void name(struct list_head *head)                                      \
+    {                                                                      \
+        if (list_empty(head) || list_is_singular(head)) {                  \
+            return; /* 若鏈表為空或只有一個元素，則無需排序 */             \
+        }                                                                  \
+        bool swapped;                                                      \
+        struct list_head *last = head; /* last 為本輪最後比較的節點 */     \
+                                                                           \
+        do {                                                               \
+            swapped = false;                                               \
+            struct list_head *cur = head->next;                            \
+            /* 當前輪比較範圍為從 head->next 到 last 之前的節點 */         \
+            while (cur->next != head && cur->next != last) {               \
+                element_t *node1 = container_of(cur, element_t, list);     \
+                element_t *node2 = container_of(cur->next, element_t, list); \
+                if (cmp(node1->value, node2->value) > 0) {                 \
+                    /* 交換兩節點的值 */                                   \
+                    char *temp = node1->value;                             \
+                    node1->value = node2->value;                           \
+                    node2->value = temp;                                   \
+                    swapped = true;                                        \
+                }                                                          \
+                cur = cur->next;                                           \
+            }                                                              \
+            last = cur; /* 更新 last 為最後一個比較過的節點 */             \
+        } while (swapped);                                                 \
+    }
+
+DEFINE_SEDIMENT_SORT(sediment_sort, cmp_numeric)
+
+/*---------------------- 插入排序 ----------------------*/
+
+// DEFINE_INSERTION_SORT(name, cmp) 以比較器 cmp 產生插入排序函式 name
+#define DEFINE_INSERTION_SORT(name, cmp)                                        \
+    void name(struct list_head *head) {                                        \
+        element_t *tp_node, *node;                                             \
+        struct list_head ans;  /* 建立排序用的鏈表頭 */                        \
+        struct list_head *temp, *pos, *ans_pos;                                \
+                                                                               \
+        INIT_LIST_HEAD(&ans);  /* 初始化新的排序鏈表 */                        \
+                                                                               \
+        /* 遍歷原本的鏈表，將每個節點移除後插入到排序鏈表 ans 中 */            \
+        list_for_each_safe(pos, temp, head) {                                  \
+            tp_node = list_entry(pos, element_t, list);  /* 取得節點內容 */    \
+            list_del(pos);  /* 從原鏈表移除 */                                 \
+                                                                               \
+            /* 找出在排序鏈表中的正確位置（ans_pos 會指向第一個比 tp_node 大的節點） */ \
+            ans_pos = ans.next;                                                \
+            while (ans_pos != &ans &&                                          \
+                   cmp(tp_node->value, list_entry(ans_pos, element_t, list)->value) > 0) { \
+                ans_pos = ans_pos->next;                                       \
+            }                                                                  \
+            /* 在 ans_pos 之前插入 tp_node */                                  \
+            list_add(&tp_node->list, ans_pos->prev);                           \
+        }                                                                      \
+                                                                               \
+        /* 將排序好的 ans 鏈表的節點移回原本的鏈表 head */                     \
+        INIT_LIST_HEAD(head);                                                  \
+        list_for_each_safe(pos, temp, &ans) {                                  \
+            node = list_entry(pos, element_t, list);                           \
+            list_add_tail(&node->list, head);                                  \
+        }                                                                      \
+    }
+
+DEFINE_INSERTION_SORT(insertion_sort, cmp_string)
+DEFINE_INSERTION_SORT(insertion_sort_numeric, cmp_numeric)
+
+#endif /* LIST_SORT_H */
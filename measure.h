@@ -0,0 +1,237 @@
+#ifndef MEASURE_H
+#define MEASURE_H
+
+/*
+ * 量測區段的共用工具：序列化的 cycle 計數器與硬體效能計數器
+ *
+ * 單純執行 rdtsc 時，亂序執行可能把區段前後的指令移進或移出量測範圍。
+ * 這裡依 Intel 建議的方式序列化：
+ * - 開始：lfence; rdtsc; lfence，等前面的指令完成，後面的指令也不會提前。
+ * - 結束：rdtscp; lfence，rdtscp 會等區段內的指令完成，lfence 擋住後面的指令。
+ *
+ * 在 Linux 上另外以 perf_event_open 讀取指令數、快取失誤、分支預測失誤
+ * 與 dTLB 失誤，只計使用者空間。核心不支援、權限不足或計數器不存在時，
+ * 該計數器標記為無法使用，量測值為 MEASURE_UNAVAILABLE，cycle 量測仍照常進行。
+ *
+ * 硬體計數器不夠用時核心會輪流排程（multiplexing），計數器只在部分時間內計數。
+ * 因此每次讀取同時取得 enabled 與 running 時間：
+ * - running 為 0：區段內完全沒有排上，量測值為 MEASURE_UNAVAILABLE。
+ * - running < enabled：量測值依 enabled / running 等比例放大為估計值，
+ *   並在 measure_sample_t 的 scaled 標記，呼叫端可自行決定是否採用。
+ *
+ * 用法：
+ *
+ *   measure_t m;
+ *   measure_sample_t s;
+ *   measure_init(&m, true);
+ *   measure_begin(&m, &s);
+ *   ... 要量測的程式碼 ...
+ *   measure_end(&m, &s);
+ *   measure_close(&m);
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/*
+ * unistd.h 只在 _GNU_SOURCE / _DEFAULT_SOURCE 下宣告 syscall()，-std=c11 時兩者
+ * 都沒有定義；本檔又常在 stdio.h 之後才被引入，這裡再定義功能巨集已經來不及。
+ * 因此自行宣告，與 glibc、musl 的原型相同，重複宣告也相容。
+ */
+long syscall(long number, ...);
+#endif
+
+enum measure_counter {
+    MEASURE_INSTRUCTIONS,
+    MEASURE_CACHE_MISSES,
+    MEASURE_BRANCH_MISSES,
+    MEASURE_DTLB_MISSES,
+    MEASURE_NUM_COUNTERS,
+};
+
+static const char *const measure_counter_names[MEASURE_NUM_COUNTERS] = {
+    "instructions", "cache_misses", "branch_misses", "dtlb_misses",
+};
+
+#define MEASURE_UNAVAILABLE UINT64_MAX
+
+typedef struct {
+    int fds[MEASURE_NUM_COUNTERS];  // -1 表示無法使用
+    int leader;                     // 群組領頭的 fd，-1 表示沒有任何計數器
+} measure_t;
+
+typedef struct {
+    uint64_t cycles;
+    uint64_t counters[MEASURE_NUM_COUNTERS];
+    bool scaled[MEASURE_NUM_COUNTERS];  // 計數器被輪流排程，counters 為放大後的估計值
+} measure_sample_t;
+
+// 區段開始的 cycle 計數
+static inline uint64_t measure_cycles_begin(void)
+{
+#if defined(__i386__) || defined(__x86_64__)
+    unsigned int hi, lo;
+    __asm__ volatile("lfence\n\trdtsc\n\tlfence" : "=a"(lo), "=d"(hi)::"memory");
+    return ((uint64_t) hi << 32) | lo;
+#elif defined(__aarch64__)
+    uint64_t val;
+    asm volatile("isb\n\tmrs %0, cntvct_el0\n\tisb" : "=r"(val)::"memory");
+    return val;
+#else
+#error Unsupported Architecture
+#endif
+}
+
+// 區段結束的 cycle 計數
+static inline uint64_t measure_cycles_end(void)
+{
+#if defined(__i386__) || defined(__x86_64__)
+    unsigned int hi, lo, aux;
+    __asm__ volatile("rdtscp\n\tlfence" : "=a"(lo), "=d"(hi), "=c"(aux)::"memory");
+    (void) aux;
+    return ((uint64_t) hi << 32) | lo;
+#elif defined(__aarch64__)
+    uint64_t val;
+    asm volatile("isb\n\tmrs %0, cntvct_el0\n\tisb" : "=r"(val)::"memory");
+    return val;
+#endif
+}
+
+#ifdef __linux__
+static inline int measure_open(uint32_t type, uint64_t config, int group_fd)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = group_fd == -1;  // 只有領頭的計數器需要先停用
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int) syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+
+/*
+ * 讀出一個計數器；未開啟 PERF_FORMAT_GROUP，每個 fd 各自回傳
+ * { value, time_enabled, time_running }。
+ */
+static inline uint64_t measure_read(int fd, bool *scaled)
+{
+    uint64_t buf[3];
+
+    *scaled = false;
+    if (read(fd, buf, sizeof(buf)) != sizeof(buf) || buf[2] == 0) {
+        return MEASURE_UNAVAILABLE;
+    }
+    if (buf[2] < buf[1]) {
+        *scaled = true;
+        return (uint64_t) ((double) buf[0] * buf[1] / buf[2]);
+    }
+    return buf[0];
+}
+#endif
+
+/**
+ * measure_init - 準備量測
+ * @m:            量測狀態
+ * @use_counters: 為 false 時只量 cycle，不開啟任何效能計數器
+ *
+ * 回傳 true 表示至少有一個效能計數器可用。
+ */
+static inline bool measure_init(measure_t *m, bool use_counters)
+{
+    m->leader = -1;
+    for (int i = 0; i < MEASURE_NUM_COUNTERS; i++) {
+        m->fds[i] = -1;
+    }
+#ifdef __linux__
+    if (!use_counters) {
+        return false;
+    }
+    const struct {
+        uint32_t type;
+        uint64_t config;
+    } events[MEASURE_NUM_COUNTERS] = {
+        [MEASURE_INSTRUCTIONS] = {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+        [MEASURE_CACHE_MISSES] = {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+        [MEASURE_BRANCH_MISSES] = {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+        [MEASURE_DTLB_MISSES] = {PERF_TYPE_HW_CACHE,
+                                 PERF_COUNT_HW_CACHE_DTLB |
+                                     (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                     (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+    };
+    // 全部放在同一個群組，確保計數器同時被排程，數值之間可以互相比較
+    for (int i = 0; i < MEASURE_NUM_COUNTERS; i++) {
+        m->fds[i] = measure_open(events[i].type, events[i].config, m->leader);
+        if (m->fds[i] >= 0 && m->leader < 0) {
+            m->leader = m->fds[i];
+        }
+    }
+    return m->leader >= 0;
+#else
+    (void) use_counters;
+    return false;
+#endif
+}
+
+static inline bool measure_has(const measure_t *m, enum measure_counter c)
+{
+    return m->fds[c] >= 0;
+}
+
+// 重設並啟動計數器，最後才讀取起始 cycle，讓系統呼叫落在量測區段外
+static inline void measure_begin(measure_t *m, measure_sample_t *s)
+{
+#ifdef __linux__
+    if (m->leader >= 0) {
+        ioctl(m->leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(m->leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+#else
+    (void) m;
+#endif
+    s->cycles = measure_cycles_begin();
+}
+
+// 先讀結束 cycle，再停止並讀出計數器
+static inline void measure_end(measure_t *m, measure_sample_t *s)
+{
+    s->cycles = measure_cycles_end() - s->cycles;
+#ifdef __linux__
+    if (m->leader >= 0) {
+        ioctl(m->leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    }
+#endif
+    for (int i = 0; i < MEASURE_NUM_COUNTERS; i++) {
+        s->counters[i] = MEASURE_UNAVAILABLE;
+        s->scaled[i] = false;
+#ifdef __linux__
+        if (m->fds[i] >= 0) {
+            s->counters[i] = measure_read(m->fds[i], &s->scaled[i]);
+        }
+#endif
+    }
+}
+
+static inline void measure_close(measure_t *m)
+{
+    for (int i = 0; i < MEASURE_NUM_COUNTERS; i++) {
+#ifdef __linux__
+        if (m->fds[i] >= 0) {
+            close(m->fds[i]);
+        }
+#endif
+        m->fds[i] = -1;
+    }
+    m->leader = -1;
+}
+
+#endif /* MEASURE_H */
@@ -0,0 +1,187 @@
+#ifndef MEM_ACCOUNT_H
+#define MEM_ACCOUNT_H
+
+/*
+ * 可選的記憶體用量統計
+ *
+ * 每個資料結構實例有自己的 mem_account_t，所有配置與釋放都經過這裡的包裝函式，
+ * 記錄目前仍存活的位元組數、配置次數與最高用量。位元組分成兩種：
+ * - bytes：呼叫端要求的大小。
+ * - footprint：實際占用的 heap，包含 malloc 的區塊標頭與對齊。glibc 以
+ *   malloc_usable_size 加上區塊標頭求得，其他 libc 依常見的 malloc 估算。
+ *   小配置（hash_key、block_t、strdup 的字串）的額外成本主要出現在這裡。
+ *
+ * 只有在編譯時定義 MEM_ACCOUNT（-DMEM_ACCOUNT）才會統計；否則包裝函式直接呼叫
+ * malloc 與 free，欄位維持 0，沒有額外成本。
+ *
+ * free 無法得知區塊原本要求的大小，釋放時由呼叫端傳入（類似 C++ 的 sized delete）。
+ * mem 為 NULL 時不統計，方便沒有實例結構的資料（例如只有根指標的樹）共用同一套函式。
+ *
+ * 用法：
+ *
+ *   mem_account_t mem;
+ *   mem_account_init(&mem, "free tree");
+ *   block_t *b = mem_account_malloc(&mem, sizeof(*b));
+ *   ...
+ *   mem_account_report(&mem, stdout);
+ *   mem_account_free(&mem, b, sizeof(*b));
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#if defined(MEM_ACCOUNT) && defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+typedef struct {
+    const char *name;
+    size_t live_bytes;
+    size_t live_footprint;
+    size_t live_allocs;
+    size_t peak_bytes;
+    size_t peak_footprint;
+    size_t total_allocs;
+    size_t total_frees;
+} mem_account_t;
+
+static inline bool mem_account_enabled(void)
+{
+#ifdef MEM_ACCOUNT
+    return true;
+#else
+    return false;
+#endif
+}
+
+static inline void mem_account_init(mem_account_t *mem, const char *name)
+{
+    memset(mem, 0, sizeof(*mem));
+    mem->name = name;
+}
+
+#ifdef MEM_ACCOUNT
+// 區塊實際占用的 heap 大小
+static inline size_t mem_account_footprint(void *ptr, size_t size)
+{
+#ifdef __GLIBC__
+    (void) size;
+    return malloc_usable_size(ptr) + sizeof(size_t);
+#else
+    // 一個 size_t 的標頭，以兩個 size_t 對齊，最小四個 size_t
+    const size_t align = 2 * sizeof(size_t);
+    size_t chunk = (size + sizeof(size_t) + align - 1) & ~(align - 1);
+    (void) ptr;
+    return chunk < 2 * align ? 2 * align : chunk;
+#endif
+}
+#endif
+
+/**
+ * mem_account_add - 記錄一個已配置的區塊
+ * @mem:  統計對象，NULL 時不記錄
+ * @ptr:  以 malloc 配置的區塊，NULL 時不記錄
+ * @size: 要求的大小
+ *
+ * 用於實例結構本身：結構配置出來之後才有 mem_account_t 可以記錄。
+ */
+static inline void mem_account_add(mem_account_t *mem, void *ptr, size_t size)
+{
+#ifdef MEM_ACCOUNT
+    if (!mem || !ptr) {
+        return;
+    }
+    mem->live_bytes += size;
+    mem->live_footprint += mem_account_footprint(ptr, size);
+    mem->live_allocs++;
+    mem->total_allocs++;
+    if (mem->live_bytes > mem->peak_bytes) {
+        mem->peak_bytes = mem->live_bytes;
+    }
+    if (mem->live_footprint > mem->peak_footprint) {
+        mem->peak_footprint = mem->live_footprint;
+    }
+#else
+    (void) mem;
+    (void) ptr;
+    (void) size;
+#endif
+}
+
+static inline void *mem_account_malloc(mem_account_t *mem, size_t size)
+{
+    void *ptr = malloc(size);
+    mem_account_add(mem, ptr, size);
+    return ptr;
+}
+
+static inline void *mem_account_calloc(mem_account_t *mem, size_t n, size_t size)
+{
+    void *ptr = calloc(n, size);
+    mem_account_add(mem, ptr, n * size);
+    return ptr;
+}
+
+static inline char *mem_account_strdup(mem_account_t *mem, const char *s)
+{
+    size_t len = strlen(s) + 1;
+    char *copy = mem_account_malloc(mem, len);
+    if (copy) {
+        memcpy(copy, s, len);
+    }
+    return copy;
+}
+
+/**
+ * mem_account_free - 釋放區塊並更新統計
+ * @mem:  統計對象，NULL 時只釋放
+ * @ptr:  要釋放的區塊
+ * @size: 配置時要求的大小
+ *
+ * 統計在 free 之前更新，mem 可以放在 ptr 指向的結構裡。
+ */
+static inline void mem_account_free(mem_account_t *mem, void *ptr, size_t size)
+{
+#ifdef MEM_ACCOUNT
+    if (mem && ptr) {
+        mem->live_bytes -= size;
+        mem->live_footprint -= mem_account_footprint(ptr, size);
+        mem->live_allocs--;
+        mem->total_frees++;
+    }
+#else
+    (void) mem;
+    (void) size;
+#endif
+    free(ptr);
+}
+
+/**
+ * mem_account_report - 印出目前與最高用量
+ * @mem: 統計對象
+ * @out: 輸出位置
+ *
+ * overhead 為 footprint 比要求的大小多出的比例。
+ */
+static inline void mem_account_report(const mem_account_t *mem, FILE *out)
+{
+    const char *name = mem->name ? mem->name : "(unnamed)";
+    if (!mem_account_enabled()) {
+        fprintf(out, "%s: memory accounting disabled, build with -DMEM_ACCOUNT\n", name);
+        return;
+    }
+    double overhead = mem->live_bytes
+                          ? 100.0 * (double) (mem->live_footprint - mem->live_bytes) /
+                                (double) mem->live_bytes
+                          : 0;
+    fprintf(out,
+            "%s: live %zu bytes (%zu with malloc overhead, +%.1f%%) in %zu blocks, "
+            "peak %zu bytes (%zu), %zu allocs, %zu frees\n",
+            name, mem->live_bytes, mem->live_footprint, overhead, mem->live_allocs,
+            mem->peak_bytes, mem->peak_footprint, mem->total_allocs, mem->total_frees);
+}
+
+#endif /* MEM_ACCOUNT_H */
@@ -0,0 +1,499 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "intrusive.h"
+#include "measure.h"
+
+// 鏈表元素結構：包含一個字串與鏈表節點
+typedef struct {
+    char *value;
+    struct list_head list;
+} element_t;
+
+#include "list_sort.h"
+
+// 節點的字串值
+#define node_value(node) (list_entry(node, element_t, list)->value)
+
+/*---------------------- 自然合併排序（Timsort 風格） ----------------------*/
+
+/*
+ * 排序期間每條 run 都是以 next 串起、以 NULL 結尾的單向串列，
+ * 並記錄頭、尾與長度；全部合併完成後再補回 prev。
+ */
+#define MIN_GALLOP 7
+// run 長度滿足 Timsort 不變式時呈費氏數列成長，128 層遠超過 2^64 個節點所需
+#define MAX_RUNS 128
+// 短 run 以二分插入補到 minrun，minrun 落在 [MIN_MERGE / 2, MIN_MERGE]
+#define MIN_MERGE 64
+
+struct run {
+    struct list_head *head;
+    struct list_head *tail;
+    size_t len;
+};
+
+/**
+ * find_natural_run - 從 node 開始切出一條自然 run
+ * @node: run 的第一個節點
+ * @r:    輸出的 run，tail->next 會設為 NULL
+ *
+ * 回傳 run 之後的下一個節點。嚴格遞減的 run 會以重新串接的方式反轉；
+ * 只取嚴格遞減是為了讓相等的鍵值不會被反轉順序，保持穩定。
+ */
+static struct list_head *find_natural_run(struct list_head *node, struct run *r)
+{
+    struct list_head *next = node->next;
+    r->head = node;
+    r->tail = node;
+    r->len = 1;
+
+    if (!next) {
+        return NULL;
+    }
+    if (cmp_numeric(node_value(next), node_value(node)) < 0) {
+        // 嚴格遞減：邊走邊把節點插到 run 的最前面
+        r->tail->next = NULL;
+        while (next && cmp_numeric(node_value(next), node_value(r->head)) < 0) {
+            struct list_head *after = next->next;
+            next->next = r->head;
+            r->head = next;
+            r->len++;
+            next = after;
+        }
+        return next;
+    }
+    while (next && cmp_numeric(node_value(next), node_value(r->tail)) >= 0) {
+        r->tail = next;
+        r->len++;
+        next = next->next;
+    }
+    r->tail->next = NULL;
+    return next;
+}
+
+/*
+ * 與 Timsort 相同的 minrun：取 n 的最高 6 個位元，其餘位元不全為 0 時加 1。
+ * n / minrun 因此恰為或略小於 2 的冪次，最後的合併兩邊長度相近。
+ */
+static size_t compute_minrun(size_t n)
+{
+    size_t r = 0;
+    while (n >= MIN_MERGE) {
+        r |= n & 1;
+        n >>= 1;
+    }
+    return n + r;
+}
+
+/**
+ * extend_run - 以二分插入把 run 之後的節點併入 r，直到長度為 minrun
+ * @r:      已切出的自然 run，長度小於 minrun
+ * @next:   run 之後的下一個節點
+ * @minrun: 目標長度，不超過 MIN_MERGE
+ *
+ * 隨機輸入的自然 run 平均只有兩個節點，直接合併會產生約 n / 2 條 run。
+ * 節點指標先放進陣列，每個新節點以二分搜尋找位置（O(log minrun) 次比較），
+ * 移動的只是陣列中的指標，最後再依序串回單向串列。
+ * 插在所有相等的鍵值之後，保持穩定。回傳擴充後 run 的下一個節點。
+ */
+static struct list_head *extend_run(struct run *r, struct list_head *next, size_t minrun)
+{
+    struct list_head *buf[MIN_MERGE];
+    size_t len = 0;
+
+    for (struct list_head *node = r->head; node; node = node->next) {
+        buf[len++] = node;
+    }
+    while (next && len < minrun) {
+        size_t lo = 0, hi = len;
+        while (lo < hi) {
+            size_t mid = (lo + hi) / 2;
+            if (cmp_numeric(node_value(buf[mid]), node_value(next)) <= 0) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        memmove(&buf[lo + 1], &buf[lo], (len - lo) * sizeof(buf[0]));
+        buf[lo] = next;
+        len++;
+        next = next->next;
+    }
+
+    for (size_t i = 0; i + 1 < len; i++) {
+        buf[i]->next = buf[i + 1];
+    }
+    buf[len - 1]->next = NULL;
+    r->head = buf[0];
+    r->tail = buf[len - 1];
+    r->len = len;
+    return next;
+}
+
+/**
+ * find_run - 切出一條自然 run，不足 minrun 時以二分插入補齊
+ * @node:   run 的第一個節點
+ * @r:      輸出的 run，tail->next 會設為 NULL
+ * @minrun: run 的最小長度（剩下的節點不夠時除外）
+ *
+ * 回傳 run 之後的下一個節點。
+ */
+static struct list_head *find_run(struct list_head *node, struct run *r, size_t minrun)
+{
+    struct list_head *next = find_natural_run(node, r);
+    if (next && r->len < minrun) {
+        next = extend_run(r, next, minrun);
+    }
+    return next;
+}
+
+/**
+ * gallop - 從 node 起找出最長一段滿足條件的前綴，回傳最後一個節點
+ * @node:   第一個節點
+ * @key:    比較對象
+ * @strict: true 時條件為 node < key，否則為 node <= key
+ *
+ * 先以 1, 2, 4, ... 的步長往前試探，超過後在最後一段做二分搜尋，
+ * 比較次數為 O(log k)。鏈表仍需逐一走過節點，但走訪遠比比較便宜。
+ * node 本身不滿足條件時回傳 NULL。
+ */
+static struct list_head *gallop(struct list_head *node, const char *key, bool strict)
+{
+    struct list_head *last_ok = node;
+    size_t step = 1;
+
+#define GALLOP_OK(n) (strict ? cmp_numeric(node_value(n), key) < 0 \
+                             : cmp_numeric(node_value(n), key) <= 0)
+    if (!GALLOP_OK(node)) {
+        return NULL;
+    }
+    for (;;) {
+        struct list_head *probe = last_ok;
+        size_t dist = 0;
+        while (dist < step && probe->next) {
+            probe = probe->next;
+            dist++;
+        }
+        if (dist == 0) {
+            return last_ok;
+        }
+        if (GALLOP_OK(probe)) {
+            last_ok = probe;
+            if (dist < step) {
+                return last_ok;  // 已到串列尾端
+            }
+            step *= 2;
+            continue;
+        }
+        // 答案在 last_ok 之後、probe 之前：last_ok 滿足，距離 dist 的 probe 不滿足
+        while (dist > 1) {
+            size_t half = dist / 2;
+            struct list_head *mid = last_ok;
+            for (size_t i = 0; i < half; i++) {
+                mid = mid->next;
+            }
+            if (GALLOP_OK(mid)) {
+                last_ok = mid;
+                dist -= half;
+            } else {
+                dist = half;
+            }
+        }
+        return last_ok;
+    }
+#undef GALLOP_OK
+}
+
+/**
+ * merge_runs - 穩定合併相鄰的兩條 run，a 在原串列中位於 b 之前
+ *
+ * - a 的最後一個不大於 b 的第一個時直接串接，已排序的輸入只需一次比較。
+ * - 任一邊連續勝出 MIN_GALLOP 次後進入 galloping，整段一次接到輸出。
+ */
+static void merge_runs(struct run *a, struct run *b)
+{
+    if (cmp_numeric(node_value(a->tail), node_value(b->head)) <= 0) {
+        a->tail->next = b->head;
+        a->tail = b->tail;
+        a->len += b->len;
+        return;
+    }
+
+    struct list_head *x = a->head, *y = b->head;
+    struct list_head *out = NULL, **tail = &out;
+    size_t wins_x = 0, wins_y = 0;
+
+    while (x && y) {
+        if (wins_x >= MIN_GALLOP) {
+            // a 連續勝出：找出 a 中所有不大於 y 的節點，整段接上
+            struct list_head *end = gallop(x, node_value(y), false);
+            wins_x = 0;
+            if (end) {
+                *tail = x;
+                tail = &end->next;
+                x = end->next;
+                continue;
+            }
+        } else if (wins_y >= MIN_GALLOP) {
+            // b 連續勝出：找出 b 中所有嚴格小於 x 的節點，整段接上
+            struct list_head *end = gallop(y, node_value(x), true);
+            wins_y = 0;
+            if (end) {
+                *tail = y;
+                tail = &end->next;
+                y = end->next;
+                continue;
+            }
+        }
+        if (cmp_numeric(node_value(y), node_value(x)) < 0) {
+            *tail = y;
+            tail = &y->next;
+            y = y->next;
+            wins_y++;
+            wins_x = 0;
+        } else {
+            *tail = x;
+            tail = &x->next;
+            x = x->next;
+            wins_x++;
+            wins_y = 0;
+        }
+    }
+    if (x) {
+        *tail = x;  // a 的尾端仍是合併後的尾端
+    } else {
+        *tail = y;
+        a->tail = b->tail;
+    }
+    a->head = out;
+    a->len += b->len;
+}
+
+// 合併 runs[i] 與 runs[i + 1]，結果放在 runs[i]
+static void merge_at(struct run *runs, int *n, int i)
+{
+    merge_runs(&runs[i], &runs[i + 1]);
+    for (int j = i + 1; j < *n - 1; j++) {
+        runs[j] = runs[j + 1];
+    }
+    (*n)--;
+}
+
+/*
+ * 維持 Timsort 的不變式（採用修正後的版本，同時檢查往下兩層）：
+ *   len[i - 2] > len[i - 1] + len[i]，len[i - 1] > len[i]
+ * 確保每次合併的兩條 run 長度相近，且堆疊深度為 O(log n)。
+ */
+static void merge_collapse(struct run *runs, int *n)
+{
+    while (*n > 1) {
+        int i = *n - 2;
+        if ((i > 0 && runs[i - 1].len <= runs[i].len + runs[i + 1].len) ||
+            (i > 1 && runs[i - 2].len <= runs[i - 1].len + runs[i].len)) {
+            if (runs[i - 1].len < runs[i + 1].len) {
+                i--;
+            }
+        } else if (runs[i].len > runs[i + 1].len) {
+            break;
+        }
+        merge_at(runs, n, i);
+    }
+}
+
+/**
+ * natural_merge_sort - 偵測既有 run 的穩定合併排序
+ * @head: 隊列頭
+ *
+ * 說明：
+ * - 依序切出遞增（或反轉後的嚴格遞減）run，不足 minrun 的以二分插入補齊，
+ *   放入 run 堆疊並依不變式合併。
+ * - 已排序或反向排序的輸入只有一條 run，為 O(n)；
+ *   「已排序加上隨機尾端」只需排序尾端再與前段合併一次。
+ * - 只改變節點的鏈結，不複製任何字串。
+ */
+void natural_merge_sort(struct list_head *head)
+{
+    if (list_empty(head) || list_is_singular(head)) {
+        return;
+    }
+    struct run runs[MAX_RUNS];
+    int n = 0;
+    size_t count = 0;
+    struct list_head *node;
+
+    list_for_each(node, head) {
+        count++;
+    }
+    size_t minrun = compute_minrun(count);
+
+    head->prev->next = NULL;
+    node = head->next;
+    while (node) {
+        node = find_run(node, &runs[n++], minrun);
+        merge_collapse(runs, &n);
+    }
+    while (n > 1) {
+        int i = n - 2;
+        if (i > 0 && runs[i - 1].len < runs[i + 1].len) {
+            i--;
+        }
+        merge_at(runs, &n, i);
+    }
+
+    // 補回 prev 指標
+    struct list_head *prev = head;
+    head->next = runs[0].head;
+    for (node = runs[0].head; node; node = node->next) {
+        node->prev = prev;
+        prev = node;
+    }
+    prev->next = head;
+    head->prev = prev;
+}
+
+/*---------------------- 鏈表上的排序（對照組） ----------------------*/
+
+DEFINE_LIST_MERGE_SORT(list_merge_sort, cmp_numeric)
+
+/*---------------------- Main 測試 ----------------------*/
+
+// 沉積排序為 O(n^2)，超過此大小就不跑
+#define QUADRATIC_SORT_LIMIT 10000
+// 「已排序加上隨機尾端」中隨機尾端所佔的比例（分母）
+#define RANDOM_TAIL_FRACTION 10
+
+enum input_shape { SHAPE_SORTED, SHAPE_REVERSED, SHAPE_RANDOM, SHAPE_SORTED_TAIL };
+
+static const char *const shape_names[] = {"sorted", "reversed", "random", "sorted+tail"};
+
+/*
+ * 元素從連續的陣列 pool 依序取出並依序串到鏈表尾端，
+ * 因此「原本的順序」就是位址順序，可用來檢查排序是否穩定。
+ */
+typedef struct {
+    element_t *pool;
+    char (*strings)[12];
+    size_t n;
+} test_queue_t;
+
+static void build_queue(struct list_head *head, test_queue_t *q, enum input_shape shape)
+{
+    srand(1);
+    INIT_LIST_HEAD(head);
+    for (size_t i = 0; i < q->n; i++) {
+        int value;
+        switch (shape) {
+        case SHAPE_SORTED:
+            value = (int) i;
+            break;
+        case SHAPE_REVERSED:
+            value = (int) (q->n - i);
+            break;
+        case SHAPE_RANDOM:
+            value = rand() % 1000;
+            break;
+        default:
+            value = i < q->n - q->n / RANDOM_TAIL_FRACTION ? (int) i : rand() % (int) q->n;
+            break;
+        }
+        sprintf(q->strings[i], "%d", value);
+        q->pool[i].value = q->strings[i];
+        list_add_tail(&q->pool[i].list, head);
+    }
+}
+
+// 檢查排序結果：數值遞增、節點數不變；stable 為 true 時鍵值相同者需維持原本的位址順序
+static bool check_sorted(struct list_head *head, size_t n, bool stable)
+{
+    size_t count = 0;
+    element_t *prev = NULL;
+    for (struct list_head *pos = head->next; pos != head; pos = pos->next) {
+        element_t *elem = list_entry(pos, element_t, list);
+        if (pos->next->prev != pos) {
+            return false;
+        }
+        if (prev) {
+            int diff = cmp_numeric(prev->value, elem->value);
+            if (diff > 0 || (stable && diff == 0 && prev > elem)) {
+                return false;
+            }
+        }
+        prev = elem;
+        count++;
+    }
+    return count == n;
+}
+
+/*---------------------- 效能測試 ----------------------*/
+
+#include "sort_bench.h"
+
+static const sort_bench_case_t bench_cases[] = {
+    {"natural_merge_sort", natural_merge_sort, SORT_BENCH_NO_LIMIT},
+    {"list_merge_sort", list_merge_sort, SORT_BENCH_NO_LIMIT},
+};
+
+int main(int argc, char *argv[])
+{
+    // --bench：以固定種子跑完整的效能測試並輸出 CSV
+    if (argc > 1 && strcmp(argv[1], "--bench") == 0) {
+        return sort_bench_main(argc, argv, bench_cases,
+                               sizeof(bench_cases) / sizeof(bench_cases[0]));
+    }
+    const struct {
+        const char *name;
+        void (*sort)(struct list_head *head);
+        size_t max_elements;
+        bool stable;
+    } cases[] = {
+        {"natural_merge_sort", natural_merge_sort, 1000000, true},
+        {"list_merge_sort", list_merge_sort, 1000000, true},
+        {"sediment_sort", sediment_sort, QUADRATIC_SORT_LIMIT, false},
+    };
+    size_t max_elements = 1000000;
+    test_queue_t q = {
+        .pool = malloc(max_elements * sizeof(element_t)),
+        .strings = malloc(max_elements * sizeof(*q.strings)),
+    };
+    if (!q.pool || !q.strings) {
+        fprintf(stderr, "malloc error\n");
+        return 1;
+    }
+
+    printf("%-20s %-12s %10s %16s %12s\n", "sort", "input", "elements", "cycles",
+           "cycles/elem");
+    for (size_t n = 1000; n <= max_elements; n *= 10) {
+        for (int shape = SHAPE_SORTED; shape <= SHAPE_SORTED_TAIL; shape++) {
+            for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+                if (n > cases[c].max_elements) {
+                    continue;
+                }
+                struct list_head head;
+                q.n = n;
+                build_queue(&head, &q, shape);
+
+                int64_t cycles = measure_cycles_begin();
+                cases[c].sort(&head);
+                cycles = measure_cycles_end() - cycles;
+
+                // 沉積排序交換的是字串而不是節點，只檢查順序
+                if (!check_sorted(&head, n, cases[c].stable)) {
+                    fprintf(stderr, "%s: wrong result on %s input\n", cases[c].name,
+                            shape_names[shape]);
+                    return 1;
+                }
+                printf("%-20s %-12s %10zu %16ld %12.1f\n", cases[c].name, shape_names[shape],
+                       n, (long) cycles, (double) cycles / n);
+            }
+        }
+    }
+
+    free(q.pool);
+    free(q.strings);
+    return 0;
+}
@@ -0,0 +1,661 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <stdint.h>
+
+#include "intrusive.h"
+#include "measure.h"
+
+// 鏈表元素結構：包含一個字串與鏈表節點
+typedef struct element {
+    char *value;
+    struct list_head list;
+    struct element *left;  // 只在配對堆積中使用，見下方說明
+} element_t;
+
+#include "list_sort.h"
+
+/*---------------------- 配對堆積（重用 list_head 指標） ----------------------*/
+
+/*
+ * 隊列只需要反覆取出最小值、新元素又不斷以 q_insert_head 加入時，
+ * 每批都重新排序整個隊列是浪費的。配對堆積的節點直接使用 element_t：
+ * - list.next 為最左邊的子節點，沒有子節點時為 NULL。
+ * - list.prev 為右邊的兄弟節點，最右邊的子節點與根為 NULL。
+ * - left 為左邊的兄弟節點；最左邊的子節點改存父節點，兩者以
+ *   left->list.next == node 區分。根的 left 為 NULL。
+ * 元素在堆積中時不屬於任何隊列；取出後 list 重新初始化，可以再放回隊列。
+ *
+ * 成本：
+ * - 插入：與根比較一次後掛上去，O(1)。
+ * - 取出最小值：兩趟配對合併根的子節點，均攤 O(log n)。
+ * - decrease-key：經由 left 把節點連同子樹切下，O(1)，再與根合併一次。
+ *   均攤成本與取出最小值相同，為 O(log n)。
+ * left 讓 element_t 多一個指標；只使用 list 兩個指標的做法需沿兄弟串列
+ * 尋找父節點，decrease-key 變成 O(兄弟數)。
+ */
+
+typedef struct {
+    element_t *root;
+    size_t size;
+} pheap_t;
+
+static inline void pheap_init(pheap_t *heap)
+{
+    heap->root = NULL;
+    heap->size = 0;
+}
+
+static inline bool pheap_empty(const pheap_t *heap)
+{
+    return !heap->root;
+}
+
+static inline element_t *ph_child(const element_t *node)
+{
+    return (element_t *) node->list.next;
+}
+
+// 右邊的兄弟節點，node 是最右邊的子節點或根時回傳 NULL
+static inline element_t *ph_sibling(const element_t *node)
+{
+    return (element_t *) node->list.prev;
+}
+
+// 設為樹根：沒有兄弟，也沒有父節點
+static inline element_t *ph_make_root(element_t *node)
+{
+    node->list.prev = NULL;
+    node->left = NULL;
+    return node;
+}
+
+/**
+ * ph_cut - 把非根節點連同子樹從父節點的子節點串列移除
+ *
+ * node->left 是父節點時改寫父節點的 list.next，否則改寫左邊兄弟的
+ * list.prev，再讓右邊的兄弟指回 node->left，O(1)。
+ */
+static inline void ph_cut(element_t *node)
+{
+    element_t *left = node->left, *right = ph_sibling(node);
+    if (ph_child(left) == node) {
+        left->list.next = (struct list_head *) right;
+    } else {
+        left->list.prev = (struct list_head *) right;
+    }
+    if (right) {
+        right->left = left;
+    }
+    ph_make_root(node);
+}
+
+// 釋放堆積中所有元素（包含字串），以 list.prev 串成待釋放的堆疊，不需遞迴
+void pheap_free(pheap_t *heap)
+{
+    element_t *stack = heap->root;
+    if (stack) {
+        stack->list.prev = NULL;
+    }
+    while (stack) {
+        element_t *node = stack;
+        stack = (element_t *) node->list.prev;
+        for (element_t *child = ph_child(node), *next; child; child = next) {
+            next = ph_sibling(child);
+            child->list.prev = (struct list_head *) stack;
+            stack = child;
+        }
+        free(node->value);
+        free(node);
+    }
+    pheap_init(heap);
+}
+
+/**
+ * DEFINE_PAIRING_HEAP - 產生以 cmp 比較的配對堆積函式
+ * @name: 函式名稱前綴
+ * @cmp:  比較函式，回傳值與 strcmp 相同
+ *
+ * 產生：
+ * - name_push(heap, elem)：加入一個不在任何隊列中的元素，O(1)
+ * - name_insert(heap, s)：與 q_insert_head 相同地配置元素並加入堆積
+ * - name_from_queue(heap, head)：把整個隊列的元素移入堆積，O(n)，
+ *   比逐一 push 更適合初始建立：逐一 push 會讓根有 n 個子節點
+ * - name_pop(heap)：取出最小的元素，空堆積回傳 NULL
+ * - name_decrease_key(heap, elem)：呼叫端把 elem->value 換成較小的值之後呼叫
+ * 鍵值相同的元素取出順序不固定。
+ */
+#define DEFINE_PAIRING_HEAP(name, cmp)                                         \
+    /* 合併兩棵堆積，較大的根成為較小的根最左邊的子節點 */                     \
+    static inline element_t *name##_link(element_t *a, element_t *b)           \
+    {                                                                          \
+        if (cmp(b->value, a->value) < 0) {                                     \
+            element_t *tmp = a;                                                \
+            a = b;                                                             \
+            b = tmp;                                                           \
+        }                                                                      \
+        element_t *child = ph_child(a);                                        \
+        if (child) {                                                           \
+            child->left = b;                                                   \
+        }                                                                      \
+        b->list.prev = (struct list_head *) child;                             \
+        b->left = a;                                                           \
+        a->list.next = (struct list_head *) b;                                 \
+        return a;                                                              \
+    }                                                                          \
+                                                                               \
+    void name##_push(pheap_t *heap, element_t *elem)                           \
+    {                                                                          \
+        elem->list.next = NULL;                                                \
+        ph_make_root(elem);                                                    \
+        heap->root = heap->root ? name##_link(heap->root, elem) : elem;        \
+        heap->size++;                                                          \
+    }                                                                          \
+                                                                               \
+    bool name##_insert(pheap_t *heap, char *s)                                 \
+    {                                                                          \
+        element_t *elem = malloc(sizeof(element_t));                           \
+        if (!elem) {                                                           \
+            return false;                                                      \
+        }                                                                      \
+        elem->value = strdup(s);                                               \
+        if (!elem->value) {                                                    \
+            free(elem);                                                        \
+            return false;                                                      \
+        }                                                                      \
+        name##_push(heap, elem);                                               \
+        return true;                                                           \
+    }                                                                          \
+                                                                               \
+    /* 多趟配對：每一趟把相鄰的兩棵合併，直到剩下一棵。總共 O(n) 次比較，  \
+     * 根只有 O(log n) 個子節點，第一次 pop 不必走過 n 個兄弟節點 */        \
+    void name##_from_queue(pheap_t *heap, struct list_head *head)              \
+    {                                                                          \
+        element_t *chain = heap->root;                                         \
+        struct list_head *pos, *safe;                                          \
+        list_for_each_safe(pos, safe, head) {                                  \
+            element_t *elem = list_entry(pos, element_t, list);                \
+            elem->list.next = NULL;                                            \
+            elem->list.prev = (struct list_head *) chain;                      \
+            chain = elem;                                                      \
+            heap->size++;                                                      \
+        }                                                                      \
+        INIT_LIST_HEAD(head);                                                  \
+        while (chain && chain->list.prev) {                                    \
+            element_t *stack = NULL;                                           \
+            while (chain) {                                                    \
+                element_t *a = chain, *b = (element_t *) a->list.prev;         \
+                chain = b ? (element_t *) b->list.prev : NULL;                 \
+                if (b) {                                                       \
+                    a = name##_link(a, b);                                     \
+                }                                                              \
+                a->list.prev = (struct list_head *) stack;                     \
+                stack = a;                                                     \
+            }                                                                  \
+            chain = stack;                                                     \
+        }                                                                      \
+        heap->root = chain ? ph_make_root(chain) : NULL;                       \
+    }                                                                          \
+                                                                               \
+    /* 兩趟配對：由左至右兩兩合併，再由右至左併成一棵 */                       \
+    static element_t *name##_merge_pairs(element_t *first)                     \
+    {                                                                          \
+        element_t *stack = NULL;                                               \
+        while (first) {                                                        \
+            element_t *a = first, *b = ph_sibling(a);                          \
+            first = b ? ph_sibling(b) : NULL;                                  \
+            if (b) {                                                           \
+                a = name##_link(a, b);                                         \
+            }                                                                  \
+            /* 合併結果以 list.prev 串成堆疊，第二趟由最右邊開始 */             \
+            a->list.prev = (struct list_head *) stack;                         \
+            stack = a;                                                         \
+        }                                                                      \
+        element_t *root = NULL;                                                \
+        while (stack) {                                                        \
+            element_t *next = (element_t *) stack->list.prev;                  \
+            root = root ? name##_link(stack, root) : stack;                    \
+            stack = next;                                                      \
+        }                                                                      \
+        return root ? ph_make_root(root) : NULL;                               \
+    }                                                                          \
+                                                                               \
+    element_t *name##_pop(pheap_t *heap)                                       \
+    {                                                                          \
+        element_t *min = heap->root;                                           \
+        if (!min) {                                                            \
+            return NULL;                                                       \
+        }                                                                      \
+        heap->root = name##_merge_pairs(ph_child(min));                        \
+        heap->size--;                                                          \
+        INIT_LIST_HEAD(&min->list);                                            \
+        return min;                                                            \
+    }                                                                          \
+                                                                               \
+    void name##_decrease_key(pheap_t *heap, element_t *elem)                   \
+    {                                                                          \
+        if (elem == heap->root) {                                              \
+            return;                                                            \
+        }                                                                      \
+        ph_cut(elem);                                                          \
+        heap->root = name##_link(heap->root, elem);                            \
+    }
+
+DEFINE_PAIRING_HEAP(pheap_numeric, cmp_numeric)
+DEFINE_PAIRING_HEAP(pheap_string, cmp_string)
+
+/*---------------------- 重新排序（對照組） ----------------------*/
+
+DEFINE_LIST_MERGE_SORT(list_merge_sort, cmp_numeric)
+
+/*---------------------- Main 測試 ----------------------*/
+
+/**
+ * pheap_check - 檢查堆積結構：子節點不小於父節點、left 指回左邊的兄弟或父節點，
+ * 節點數等於 size。以 list.prev 以外的陣列當作堆疊走訪，不改動堆積。
+ */
+static bool pheap_check(const pheap_t *heap, int (*cmp)(const char *, const char *))
+{
+    if (!heap->root) {
+        return heap->size == 0;
+    }
+    if (heap->root->list.prev || heap->root->left) {
+        return false;
+    }
+    element_t **stack = malloc((heap->size + 1) * sizeof(element_t *));
+    size_t depth = 0, count = 0;
+    bool ok = stack != NULL;
+    if (ok) {
+        stack[depth++] = heap->root;
+    }
+    while (ok && depth) {
+        element_t *node = stack[--depth];
+        count++;
+        element_t *left = node;
+        for (element_t *child = ph_child(node); ok && child;
+             left = child, child = ph_sibling(child)) {
+            ok = cmp(child->value, node->value) >= 0 && depth < heap->size &&
+                 child->left == left;
+            if (ok) {
+                stack[depth++] = child;
+            }
+        }
+    }
+    free(stack);
+    return ok && count == heap->size;
+}
+
+static int int_cmp(const void *a, const void *b)
+{
+    int x = *(const int *) a, y = *(const int *) b;
+    return (x > y) - (x < y);
+}
+
+static element_t *new_element(int value)
+{
+    char buf[16];
+    element_t *elem = malloc(sizeof(element_t));
+    if (!elem) {
+        return NULL;
+    }
+    sprintf(buf, "%d", value);
+    elem->value = strdup(buf);
+    if (!elem->value) {
+        free(elem);
+        return NULL;
+    }
+    return elem;
+}
+
+// 以隨機的插入、取出與 decrease-key 操作比對暴力搜尋的最小值
+static bool check_random_ops(int ops, int modulo)
+{
+    pheap_t heap;
+    element_t **live = malloc((ops + 1) * sizeof(element_t *));
+    int *ref = malloc((ops + 1) * sizeof(int));
+    size_t n = 0;
+    bool ok = live && ref;
+
+    pheap_init(&heap);
+    for (int i = 0; ok && i < ops; i++) {
+        int op = rand() % 8;
+        if (op < 4 || n == 0) {
+            element_t *elem = new_element(rand() % modulo);
+            ok = elem != NULL;
+            if (ok) {
+                pheap_numeric_push(&heap, elem);
+                live[n++] = elem;
+            }
+        } else if (op < 6) {
+            // 取出的值必須是目前所有值中最小的
+            int min = atoi(live[0]->value);
+            for (size_t j = 1; j < n; j++) {
+                int v = atoi(live[j]->value);
+                min = v < min ? v : min;
+            }
+            element_t *elem = pheap_numeric_pop(&heap);
+            ok = elem && atoi(elem->value) == min && list_empty(&elem->list);
+            for (size_t j = 0; ok && j < n; j++) {
+                if (live[j] == elem) {
+                    live[j] = live[--n];
+                    break;
+                }
+            }
+            if (elem) {
+                free(elem->value);
+                free(elem);
+            }
+        } else if (op == 7) {
+            // 把一個短隊列併入非空的堆積
+            struct list_head queue;
+            INIT_LIST_HEAD(&queue);
+            for (int k = rand() % 4; ok && k > 0 && i < ops; k--, i++) {
+                element_t *elem = new_element(rand() % modulo);
+                ok = elem != NULL;
+                if (ok) {
+                    list_add(&elem->list, &queue);
+                    live[n++] = elem;
+                }
+            }
+            pheap_numeric_from_queue(&heap, &queue);
+            ok = ok && list_empty(&queue);
+        } else {
+            element_t *elem = live[rand() % n];
+            char buf[16];
+            sprintf(buf, "%d", atoi(elem->value) - rand() % modulo);
+            free(elem->value);
+            elem->value = strdup(buf);
+            ok = elem->value != NULL;
+            if (ok) {
+                pheap_numeric_decrease_key(&heap, elem);
+            }
+        }
+        ok = ok && heap.size == n && pheap_check(&heap, cmp_numeric);
+    }
+
+    // 剩下的元素依序取出，必須與排序後的參考陣列相同
+    for (size_t j = 0; ok && j < n; j++) {
+        ref[j] = atoi(live[j]->value);
+    }
+    if (ok) {
+        qsort(ref, n, sizeof(int), int_cmp);
+    }
+    for (size_t j = 0; ok && j < n; j++) {
+        element_t *elem = pheap_numeric_pop(&heap);
+        ok = elem && atoi(elem->value) == ref[j];
+        if (elem) {
+            free(elem->value);
+            free(elem);
+        }
+    }
+    ok = ok && pheap_empty(&heap);
+    pheap_free(&heap);
+    free(live);
+    free(ref);
+    return ok;
+}
+
+// 隊列整批移入堆積後依序取出，結果必須與 list_merge_sort 相同
+static bool check_from_queue(int n)
+{
+    struct list_head *queue = q_new(), *sorted = q_new();
+    pheap_t heap;
+    bool ok = queue && sorted;
+
+    for (int i = 0; ok && i < n; i++) {
+        char buf[16];
+        sprintf(buf, "%d", rand() % 1000);
+        ok = q_insert_head(queue, buf) && q_insert_head(sorted, buf);
+    }
+    pheap_init(&heap);
+    if (ok) {
+        list_merge_sort(sorted);
+        pheap_string_from_queue(&heap, queue);
+        ok = list_empty(queue) && heap.size == (size_t) n &&
+             pheap_check(&heap, cmp_string);
+    }
+    // 字典順序的最小值不一定是數值順序的最小值，改以數值順序重建
+    element_t *elem;
+    while (ok && (elem = pheap_string_pop(&heap))) {
+        list_add_tail(&elem->list, queue);
+    }
+    if (ok) {
+        pheap_numeric_from_queue(&heap, queue);
+    }
+    struct list_head *pos;
+    if (sorted) {
+        list_for_each(pos, sorted) {
+            if (!ok) {
+                break;
+            }
+            elem = pheap_numeric_pop(&heap);
+            ok = elem && cmp_numeric(elem->value, list_entry(pos, element_t, list)->value) == 0;
+            if (elem) {
+                list_add_tail(&elem->list, queue);
+            }
+        }
+    }
+    ok = ok && pheap_empty(&heap);
+    pheap_free(&heap);
+    q_free(queue);
+    q_free(sorted);
+    return ok;
+}
+
+/*
+ * 效能比較：隊列維持 n 個元素，每批以 q_insert_head 加入 batch 個新元素，
+ * 再取出最小的 batch 個。對照組每批都重新排序整個隊列再從頭取出，
+ * 堆積只需要 batch 次 O(1) 插入與 batch 次均攤 O(log n) 的取出。
+ * 新元素的字串在計時外準備，所有方法取出的元素相同，以 checksum 核對。
+ */
+#define BENCH_BATCHES 20
+
+typedef enum {
+    BENCH_PAIRING_HEAP,
+    BENCH_MERGE_SORT,
+    BENCH_INSERTION_SORT,
+    BENCH_SEDIMENT_SORT,
+    BENCH_MODES
+} bench_mode_t;
+
+static const char *const bench_names[BENCH_MODES] = {"pairing_heap", "list_merge_sort",
+                                                     "insertion_sort", "sediment_sort"};
+
+static int64_t run_batches(bench_mode_t mode, int n, int batch, unsigned seed, long *checksum)
+{
+    struct list_head *queue = q_new();
+    char (*values)[16] = malloc(batch * sizeof(*values));
+    pheap_t heap;
+    int64_t cycles = 0;
+
+    *checksum = 0;
+    if (!queue || !values) {
+        free(values);
+        q_free(queue);
+        return -1;
+    }
+    pheap_init(&heap);
+    srand(seed);
+    for (int i = 0; i < n; i++) {
+        sprintf(values[0], "%d", rand() % 1000000);
+        q_insert_head(queue, values[0]);
+    }
+    if (mode == BENCH_PAIRING_HEAP) {
+        pheap_numeric_from_queue(&heap, queue);
+    }
+
+    for (int b = 0; b < BENCH_BATCHES; b++) {
+        for (int i = 0; i < batch; i++) {
+            sprintf(values[i], "%d", rand() % 1000000);
+        }
+        int64_t start = measure_cycles_begin();
+        if (mode == BENCH_PAIRING_HEAP) {
+            for (int i = 0; i < batch; i++) {
+                pheap_numeric_insert(&heap, values[i]);
+            }
+            for (int i = 0; i < batch; i++) {
+                element_t *elem = pheap_numeric_pop(&heap);
+                *checksum += atoi(elem->value);
+                free(elem->value);
+                free(elem);
+            }
+        } else {
+            for (int i = 0; i < batch; i++) {
+                q_insert_head(queue, values[i]);
+            }
+            if (mode == BENCH_MERGE_SORT) {
+                list_merge_sort(queue);
+            } else if (mode == BENCH_INSERTION_SORT) {
+                insertion_sort_numeric(queue);
+            } else {
+                sediment_sort(queue);
+            }
+            for (int i = 0; i < batch; i++) {
+                element_t *elem = list_first_entry(queue, element_t, list);
+                list_del(&elem->list);
+                *checksum += atoi(elem->value);
+                free(elem->value);
+                free(elem);
+            }
+        }
+        cycles += measure_cycles_end() - start;
+    }
+    pheap_free(&heap);
+    q_free(queue);
+    free(values);
+    return cycles;
+}
+
+/*
+ * decrease-key 的成本：以 from_queue 建立 n 個元素的堆積並取出一個，
+ * 再對其餘元素依隨機順序各做一次 decrease-key，最後依序取出驗證順序。
+ */
+static bool bench_decrease_key(int n)
+{
+    pheap_t heap;
+    struct list_head *queue = q_new();
+    element_t **elems = malloc(n * sizeof(element_t *));
+    char **fresh = calloc(n, sizeof(char *));
+    bool ok = queue && elems && fresh;
+
+    for (int i = 0; ok && i < n; i++) {
+        char buf[16];
+        sprintf(buf, "%d", rand() % 1000000);
+        ok = q_insert_head(queue, buf);
+        if (ok) {
+            elems[i] = list_first_entry(queue, element_t, list);
+        }
+    }
+    pheap_init(&heap);
+    if (!ok) {
+        free(elems);
+        free(fresh);
+        q_free(queue);
+        return false;
+    }
+    pheap_numeric_from_queue(&heap, queue);
+    free(queue);
+    element_t *first = pheap_numeric_pop(&heap);
+    for (int i = 0; i < n; i++) {
+        if (elems[i] == first) {
+            elems[i] = elems[--n];
+            break;
+        }
+    }
+    for (int i = n - 1; i > 0; i--) {
+        int j = rand() % (i + 1);
+        element_t *tmp = elems[i];
+        elems[i] = elems[j];
+        elems[j] = tmp;
+    }
+    for (int i = 0; i < n; i++) {
+        char buf[16];
+        sprintf(buf, "%d", atoi(elems[i]->value) - rand() % 1000000);
+        fresh[i] = strdup(buf);
+    }
+
+    int64_t cycles = measure_cycles_begin();
+    for (int i = 0; i < n; i++) {
+        // fresh[i] 換成舊字串，計時結束後一起釋放
+        char *old = elems[i]->value;
+        elems[i]->value = fresh[i];
+        fresh[i] = old;
+        pheap_numeric_decrease_key(&heap, elems[i]);
+    }
+    cycles = measure_cycles_end() - cycles;
+
+    int prev = INT32_MIN;
+    for (int i = 0; ok && i < n; i++) {
+        element_t *elem = pheap_numeric_pop(&heap);
+        ok = elem && atoi(elem->value) >= prev;
+        if (elem) {
+            prev = atoi(elem->value);
+            free(elem->value);
+            free(elem);
+        }
+    }
+    ok = ok && pheap_empty(&heap);
+    printf("%-22s %10d %6s %16ld %12.1f\n", "decrease_key", n, "-", (long) cycles,
+           (double) cycles / n);
+
+    for (int i = 0; i < n; i++) {
+        free(fresh[i]);
+    }
+    free(first->value);
+    free(first);
+    pheap_free(&heap);
+    free(elems);
+    free(fresh);
+    return ok;
+}
+
+int main(void)
+{
+    srand((unsigned) time(NULL));
+
+    // 正確性檢查
+    const int sizes[] = {1, 2, 7, 100, 1000, 5000};
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        if (!check_random_ops(sizes[s], 50) || !check_random_ops(sizes[s], 1000000) ||
+            !check_from_queue(sizes[s])) {
+            fprintf(stderr, "pairing heap check failed: n=%d\n", sizes[s]);
+            return 1;
+        }
+    }
+    printf("pairing heap checks passed\n");
+
+    // 效能比較，cycles/elem 為每個取出元素的平均成本
+    printf("%-22s %10s %6s %16s %12s\n", "method", "queue", "batch", "cycles", "cycles/elem");
+    for (int n = 1000; n <= 100000; n *= 10) {
+        const int batches[] = {1, 10, 100};
+        for (size_t j = 0; j < sizeof(batches) / sizeof(batches[0]); j++) {
+            int batch = batches[j];
+            long expect = 0;
+            for (bench_mode_t mode = 0; mode < BENCH_MODES; mode++) {
+                // O(n^2) 的排序只跑最小的大小
+                if ((mode == BENCH_INSERTION_SORT || mode == BENCH_SEDIMENT_SORT) && n > 1000) {
+                    continue;
+                }
+                long checksum;
+                int64_t cycles = run_batches(mode, n, batch, (unsigned) n + batch, &checksum);
+                if (cycles < 0 || (mode != BENCH_PAIRING_HEAP && checksum != expect)) {
+                    fprintf(stderr, "%s: wrong result\n", bench_names[mode]);
+                    return 1;
+                }
+                expect = checksum;
+                printf("%-22s %10d %6d %16ld %12.1f\n", bench_names[mode], n, batch,
+                       (long) cycles, (double) cycles / ((long) batch * BENCH_BATCHES));
+            }
+        }
+    }
+    for (int n = 1000; n <= 1000000; n *= 10) {
+        if (!bench_decrease_key(n)) {
+            fprintf(stderr, "decrease_key: wrong result\n");
+            return 1;
+        }
+    }
+    return 0;
+}
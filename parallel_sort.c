@@ -0,0 +1,304 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "intrusive.h"
+#include "measure.h"
+
+// 編譯：gcc -O2 -pthread parallel_sort.c
+
+// 鏈表元素結構：包含一個字串與鏈表節點
+typedef struct {
+    char *value;
+    struct list_head list;
+} element_t;
+
+#include "list_sort.h"
+
+/*---------------------- 單執行緒合併排序 ----------------------*/
+
+DEFINE_LIST_MERGE_SORT(list_merge_sort, cmp_numeric)
+DEFINE_LIST_MERGE_SORT(list_merge_sort_string, cmp_string)
+DEFINE_LIST_MERGE_SORT(list_merge_sort_length_first, cmp_length_first)
+
+/*---------------------- 敗者樹 k 路合併 ----------------------*/
+
+#define MAX_THREADS 64
+
+/*
+ * 敗者樹：tree[1..k-1] 存放每場比賽的敗者，tree[0] 為整體勝者。
+ * 葉節點 i 的父節點為 (i + k) / 2。每取出一個節點只需沿著一條路徑
+ * 重賽 log2(k) 次。
+ * - 已用完的串列視為 +inf。
+ * - 建樹時以虛擬索引 k 代表 -inf。
+ * - 鍵值相同時索引小者勝，因為較小的索引來自原鏈表較前面的區段。
+ * - key[i] 快取每條串列第一個節點的字串，比賽時不必再經過節點取值；
+ *   比較一律透過排序使用的比較器，合併結果與子排序的順序一致。
+ */
+struct loser_tree {
+    int k;
+    int tree[MAX_THREADS];
+    struct list_head *runs;            // k 條已排序的串列
+    const char *key[MAX_THREADS + 1];  // 每條串列目前第一個節點的值，用完為 NULL
+};
+
+static inline void loser_tree_load_key(struct loser_tree *lt, int i)
+{
+    lt->key[i] = list_empty(&lt->runs[i])
+                     ? NULL
+                     : list_entry(lt->runs[i].next, element_t, list)->value;
+}
+
+/**
+ * DEFINE_PARALLEL_SORT(name, cmp, sort) - 以比較器 cmp 產生多執行緒排序 name
+ * @sort: 以同一個 cmp 產生的單執行緒排序，每段子鏈表由它排序
+ *
+ * 說明：
+ * - 把隊列依原本順序切成 num_threads 段連續的子鏈表（num_threads 為 1 到 MAX_THREADS）。
+ * - 每段由一個執行緒以 sort 排序。
+ * - 最後由呼叫者以敗者樹做 k 路合併。
+ * - 子排序與合併皆為穩定，因此整體也是穩定排序。
+ * - 建立執行緒失敗時，該段改由呼叫者自己排序。
+ */
+#define DEFINE_PARALLEL_SORT(name, cmp, sort)                                          \
+    static inline bool name##_beats(const struct loser_tree *lt, int a, int b)         \
+    {                                                                                  \
+        if (a == lt->k || b == lt->k) {                                                \
+            return a == lt->k;                                                         \
+        }                                                                              \
+        if (!lt->key[a] || !lt->key[b]) {                                              \
+            return lt->key[a] || (!lt->key[b] && a < b);                               \
+        }                                                                              \
+        int diff = cmp(lt->key[a], lt->key[b]);                                        \
+        return diff < 0 || (diff == 0 && a < b);                                       \
+    }                                                                                  \
+                                                                                       \
+    /* 葉節點 s 的值改變後，從 s 往上重賽到根 */                                       \
+    static void name##_adjust(struct loser_tree *lt, int s)                            \
+    {                                                                                  \
+        for (int t = (s + lt->k) >> 1; t > 0; t >>= 1) {                               \
+            if (name##_beats(lt, lt->tree[t], s)) {                                    \
+                int tmp = s;                                                           \
+                s = lt->tree[t];                                                       \
+                lt->tree[t] = tmp;                                                     \
+            }                                                                          \
+        }                                                                              \
+        lt->tree[0] = s;                                                               \
+    }                                                                                  \
+                                                                                       \
+    /* 以敗者樹把 k 條已排序的串列合併到空的 head，結束後 runs 皆為空 */               \
+    static void name##_merge(struct list_head *head, struct list_head *runs, int k)    \
+    {                                                                                  \
+        struct loser_tree lt = {.k = k, .runs = runs};                                 \
+                                                                                       \
+        for (int i = 0; i < k; i++) {                                                  \
+            loser_tree_load_key(&lt, i);                                               \
+            lt.tree[i] = k;                                                            \
+        }                                                                              \
+        for (int i = k - 1; i >= 0; i--) {                                             \
+            name##_adjust(&lt, i);                                                     \
+        }                                                                              \
+                                                                                       \
+        for (;;) {                                                                     \
+            int w = lt.tree[0];                                                        \
+            if (!lt.key[w]) {                                                          \
+                break; /* 勝者已用完，代表全部都用完了 */                              \
+            }                                                                          \
+            struct list_head *node = runs[w].next;                                     \
+            list_del(node);                                                            \
+            list_add_tail(node, head);                                                 \
+            loser_tree_load_key(&lt, w);                                               \
+            name##_adjust(&lt, w);                                                     \
+        }                                                                              \
+    }                                                                                  \
+                                                                                       \
+    static void *name##_worker(void *arg)                                              \
+    {                                                                                  \
+        sort((struct list_head *) arg);                                                \
+        return NULL;                                                                   \
+    }                                                                                  \
+                                                                                       \
+    void name(struct list_head *head, int num_threads)                                 \
+    {                                                                                  \
+        if (list_empty(head) || list_is_singular(head)) {                              \
+            return;                                                                    \
+        }                                                                              \
+        if (num_threads < 1) {                                                         \
+            num_threads = 1;                                                           \
+        }                                                                              \
+        if (num_threads > MAX_THREADS) {                                               \
+            num_threads = MAX_THREADS;                                                 \
+        }                                                                              \
+                                                                                       \
+        size_t n = 0;                                                                  \
+        for (struct list_head *pos = head->next; pos != head; pos = pos->next) {       \
+            n++;                                                                       \
+        }                                                                              \
+        if (n < (size_t) num_threads) {                                                \
+            num_threads = (int) n;                                                     \
+        }                                                                              \
+                                                                                       \
+        struct list_head runs[MAX_THREADS];                                            \
+        pthread_t tid[MAX_THREADS];                                                    \
+        bool started[MAX_THREADS] = {false};                                           \
+                                                                                       \
+        /* 依序切出 num_threads - 1 段，剩下的全部給最後一段 */                        \
+        for (int t = 0; t < num_threads - 1; t++) {                                    \
+            size_t len = n / num_threads;                                              \
+            struct list_head *entry = head;                                            \
+            for (size_t i = 0; i < len; i++) {                                         \
+                entry = entry->next;                                                   \
+            }                                                                          \
+            INIT_LIST_HEAD(&runs[t]);                                                  \
+            list_cut_position(&runs[t], head, entry);                                  \
+        }                                                                              \
+        INIT_LIST_HEAD(&runs[num_threads - 1]);                                        \
+        list_cut_position(&runs[num_threads - 1], head, head->prev);                   \
+                                                                                       \
+        for (int t = 1; t < num_threads; t++) {                                        \
+            started[t] = pthread_create(&tid[t], NULL, name##_worker, &runs[t]) == 0;  \
+        }                                                                              \
+        sort(&runs[0]);                                                                \
+        for (int t = 1; t < num_threads; t++) {                                        \
+            if (started[t]) {                                                          \
+                pthread_join(tid[t], NULL);                                            \
+            } else {                                                                   \
+                sort(&runs[t]);                                                        \
+            }                                                                          \
+        }                                                                              \
+                                                                                       \
+        name##_merge(head, runs, num_threads);                                         \
+    }
+
+DEFINE_PARALLEL_SORT(parallel_sort, cmp_numeric, list_merge_sort)
+DEFINE_PARALLEL_SORT(parallel_sort_string, cmp_string, list_merge_sort_string)
+DEFINE_PARALLEL_SORT(parallel_sort_length_first, cmp_length_first,
+                     list_merge_sort_length_first)
+
+/*---------------------- Main 測試 ----------------------*/
+
+/*
+ * 元素從連續的陣列 pool 依序取出並依序串到鏈表尾端，
+ * 因此「原本的順序」就是位址順序，可用來檢查排序是否穩定。
+ */
+typedef struct {
+    element_t *pool;
+    char (*strings)[8];
+    size_t n;
+} test_queue_t;
+
+static void build_queue(struct list_head *head, test_queue_t *q, unsigned seed)
+{
+    srand(seed);
+    INIT_LIST_HEAD(head);
+    for (size_t i = 0; i < q->n; i++) {
+        sprintf(q->strings[i], "%d", rand() % 1000);
+        q->pool[i].value = q->strings[i];
+        list_add_tail(&q->pool[i].list, head);
+    }
+}
+
+// 檢查排序結果：依 cmp 遞增、鍵值相同者維持原本的位址順序、且節點數不變
+static bool check_sorted_stable(struct list_head *head, size_t n,
+                                int (*cmp)(const char *, const char *))
+{
+    size_t count = 0;
+    element_t *prev = NULL;
+    for (struct list_head *pos = head->next; pos != head; pos = pos->next) {
+        element_t *elem = list_entry(pos, element_t, list);
+        if (pos->next->prev != pos) {
+            return false;
+        }
+        if (prev) {
+            int diff = cmp(prev->value, elem->value);
+            if (diff > 0 || (diff == 0 && prev > elem)) {
+                return false;
+            }
+        }
+        prev = elem;
+        count++;
+    }
+    return count == n;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t max_elements = argc > 1 ? strtoul(argv[1], NULL, 10) : 10000000;
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    if (ncpu < 1) {
+        ncpu = 1;
+    }
+    int max_threads = ncpu * 2 > MAX_THREADS ? MAX_THREADS : (int) ncpu * 2;
+
+    test_queue_t q = {
+        .pool = malloc(max_elements * sizeof(element_t)),
+        .strings = malloc(max_elements * sizeof(*q.strings)),
+    };
+    if (!q.pool || !q.strings) {
+        fprintf(stderr, "malloc error\n");
+        return 1;
+    }
+
+    // 每個比較器都要與 list_merge_sort 的順序一致，字串順序下 "10" < "9"
+    const struct {
+        const char *name;
+        void (*sort)(struct list_head *, int);
+        int (*cmp)(const char *, const char *);
+    } checks[] = {
+        {"parallel_sort", parallel_sort, cmp_numeric},
+        {"parallel_sort_string", parallel_sort_string, cmp_string},
+        {"parallel_sort_length_first", parallel_sort_length_first, cmp_length_first},
+    };
+    q.n = max_elements < 100000 ? max_elements : 100000;
+    for (size_t c = 0; c < sizeof(checks) / sizeof(checks[0]); c++) {
+        for (int t = 1; t <= max_threads; t *= 2) {
+            struct list_head head;
+            build_queue(&head, &q, 2);
+            checks[c].sort(&head, t);
+            if (!check_sorted_stable(&head, q.n, checks[c].cmp)) {
+                fprintf(stderr, "%s: wrong or unstable result (%d threads)\n", checks[c].name,
+                        t);
+                return 1;
+            }
+        }
+    }
+
+    printf("online CPUs: %ld\n", ncpu);
+    printf("%-16s %10s %8s %16s %8s\n", "sort", "elements", "threads", "cycles", "speedup");
+    for (size_t n = 100000; n <= max_elements; n *= 10) {
+        struct list_head head;
+        q.n = n;
+
+        build_queue(&head, &q, 1);
+        int64_t base = measure_cycles_begin();
+        list_merge_sort(&head);
+        base = measure_cycles_end() - base;
+        if (!check_sorted_stable(&head, n, cmp_numeric)) {
+            fprintf(stderr, "list_merge_sort: wrong or unstable result\n");
+            return 1;
+        }
+        printf("%-16s %10zu %8d %16ld %8.2f\n", "list_merge_sort", n, 1, (long) base, 1.0);
+
+        for (int t = 1; t <= max_threads; t *= 2) {
+            build_queue(&head, &q, 1);
+            int64_t cycles = measure_cycles_begin();
+            parallel_sort(&head, t);
+            cycles = measure_cycles_end() - cycles;
+            if (!check_sorted_stable(&head, n, cmp_numeric)) {
+                fprintf(stderr, "parallel_sort: wrong or unstable result (%d threads)\n", t);
+                return 1;
+            }
+            printf("%-16s %10zu %8d %16ld %8.2f\n", "parallel_sort", n, t, (long) cycles,
+                   (double) base / cycles);
+        }
+    }
+
+    free(q.pool);
+    free(q.strings);
+    return 0;
+}
@@ -0,0 +1,374 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <stdint.h>
+
+#include "intrusive.h"
+#include "measure.h"
+
+#include "mem_account.h"
+
+// 鏈表元素結構：包含一個字串與鏈表節點
+typedef struct {
+    char *value;
+    struct list_head list;
+} element_t;
+
+/*
+ * 一般隊列的頭：head 必須是第一個成員，q_new 回傳 &queue->head，
+ * 呼叫端仍只看到 struct list_head。mem 統計這個隊列的頭、元素與字串。
+ */
+typedef struct {
+    struct list_head head;
+    mem_account_t mem;
+} malloc_queue_t;
+
+// 取得 q_new 建立的隊列的記憶體統計
+static inline mem_account_t *q_mem(struct list_head *head)
+{
+    return &container_of(head, malloc_queue_t, head)->mem;
+}
+
+// 建立一個空的雙向鏈表（隊列）
+struct list_head *q_new()
+{
+    malloc_queue_t *q = malloc(sizeof(malloc_queue_t));
+    if (!q) {
+        return NULL;
+    }
+    mem_account_init(&q->mem, "malloc queue");
+    mem_account_add(&q->mem, q, sizeof(*q));
+    INIT_LIST_HEAD(&q->head);
+    return &q->head;
+}
+
+// 在鏈表頭插入新元素，並複製字串 s
+bool q_insert_head(struct list_head *head, char *s)
+{
+    if (!head) {
+        return false;
+    }
+    mem_account_t *mem = q_mem(head);
+    element_t *new_qelement = mem_account_malloc(mem, sizeof(element_t));
+    if (!new_qelement) {
+        return false;
+    }
+    new_qelement->value = mem_account_strdup(mem, s);
+    if (!new_qelement->value) {
+        mem_account_free(mem, new_qelement, sizeof(element_t));
+        return false;
+    }
+    list_add(&new_qelement->list, head);
+    return true;
+}
+
+// 釋放整個隊列（包含元素與字串）
+void q_free(struct list_head *head)
+{
+    if (!head) {
+        return;
+    }
+    mem_account_t *mem = q_mem(head);
+    struct list_head *pos, *safe;
+    list_for_each_safe(pos, safe, head) {
+        element_t *elem = list_entry(pos, element_t, list);
+        mem_account_free(mem, elem->value, strlen(elem->value) + 1);
+        mem_account_free(mem, elem, sizeof(element_t));
+    }
+    mem_account_free(mem, container_of(head, malloc_queue_t, head), sizeof(malloc_queue_t));
+}
+
+// 遍歷鏈表並印出前 max_print 個元素的字串
+void print_list(struct list_head *head, int max_print) {
+    struct list_head *pos;
+    int count = 0;
+    for (pos = head->next; pos != head && count < max_print; pos = pos->next) {
+        element_t *elem = container_of(pos, element_t, list);
+        printf("Element %d: %s\n", count, elem->value);
+        count++;
+    }
+}
+
+
+/*---------------------- Arena 隊列 ----------------------*/
+
+/*
+ * 一般的隊列每個元素要三次配置（呼叫端的字串、element_t、strdup），
+ * 釋放時也要逐一 free。arena 隊列改成：
+ * - element_t 與短字串一起從 arena 以遞增指標方式切出，
+ *   value 直接指向緊接在後面的 inline_value，一次配置都不用。
+ * - 長度超過 INLINE_VALUE_SIZE - 1 的字串才另外 malloc，並以 heap_values
+ *   串起來，釋放時不需要走訪元素。
+ * - 整個隊列以 q_free_arena 一次釋放所有 arena 區塊。
+ * 元素仍是一般的 element_t，所有鏈表排序都可以直接使用。
+ */
+#define ARENA_CHUNK_SIZE (64 * 1024)
+#define INLINE_VALUE_SIZE 16
+
+typedef struct arena_chunk {
+    struct arena_chunk *next;
+    size_t used;
+    size_t size;
+    _Alignas(max_align_t) char data[];
+} arena_chunk_t;
+
+typedef struct {
+    element_t elem;
+    char inline_value[INLINE_VALUE_SIZE];
+} arena_element_t;
+
+// 放不進 inline_value 的字串，前面多一個指標把所有長字串串起來
+typedef struct heap_value {
+    struct heap_value *next;
+    char value[];
+} heap_value_t;
+
+typedef struct {
+    struct list_head head;      // 必須是第一個成員，讓 queue 與 &queue->head 可互換
+    arena_chunk_t *chunks;      // 目前使用中的區塊在最前面
+    heap_value_t *heap_values;
+    size_t num_chunks;
+    size_t num_heap_values;
+    mem_account_t mem;          // 隊列本身、arena 區塊與長字串
+} arena_queue_t;
+
+/*
+ * 從 arena 切出 size 位元組，以 align 對齊（2 的冪次，不超過 max_align_t）。
+ * 呼叫端傳入型別本身的對齊需求，而不是一律用 max_align_t：
+ * 40 位元組的 arena_element_t 以 16 對齊會被墊成 48，白白多用 20%。
+ */
+static void *arena_alloc(arena_queue_t *q, size_t size, size_t align)
+{
+    arena_chunk_t *chunk = q->chunks;
+    size_t offset = chunk ? (chunk->used + align - 1) & ~(align - 1) : 0;
+
+    if (!chunk || offset > chunk->size || chunk->size - offset < size) {
+        size_t chunk_size = size > ARENA_CHUNK_SIZE ? size : ARENA_CHUNK_SIZE;
+        chunk = mem_account_malloc(&q->mem, sizeof(arena_chunk_t) + chunk_size);
+        if (!chunk) {
+            return NULL;
+        }
+        chunk->used = 0;
+        chunk->size = chunk_size;
+        chunk->next = q->chunks;
+        q->chunks = chunk;
+        q->num_chunks++;
+        offset = 0;
+    }
+    void *p = chunk->data + offset;
+    chunk->used = offset + size;
+    return p;
+}
+
+// 建立一個空的 arena 隊列
+arena_queue_t *q_new_arena()
+{
+    arena_queue_t *q = malloc(sizeof(arena_queue_t));
+    if (!q) {
+        return NULL;
+    }
+    mem_account_init(&q->mem, "arena queue");
+    mem_account_add(&q->mem, q, sizeof(*q));
+    INIT_LIST_HEAD(&q->head);
+    q->chunks = NULL;
+    q->heap_values = NULL;
+    q->num_chunks = 0;
+    q->num_heap_values = 0;
+    return q;
+}
+
+/**
+ * q_insert_head_arena - 在 arena 隊列頭插入新元素，並複製字串 s
+ *
+ * 短字串存放在元素內，長字串才使用 malloc。
+ * 失敗時已切出的 arena 空間不會歸還，但會在 q_free_arena 時一併釋放。
+ */
+bool q_insert_head_arena(arena_queue_t *q, const char *s)
+{
+    if (!q) {
+        return false;
+    }
+    arena_element_t *new_qelement = arena_alloc(q, sizeof(arena_element_t), _Alignof(arena_element_t));
+    if (!new_qelement) {
+        return false;
+    }
+    size_t len = strlen(s);
+    if (len < INLINE_VALUE_SIZE) {
+        memcpy(new_qelement->inline_value, s, len + 1);
+        new_qelement->elem.value = new_qelement->inline_value;
+    } else {
+        heap_value_t *hv = mem_account_malloc(&q->mem, sizeof(heap_value_t) + len + 1);
+        if (!hv) {
+            return false;
+        }
+        memcpy(hv->value, s, len + 1);
+        hv->next = q->heap_values;
+        q->heap_values = hv;
+        q->num_heap_values++;
+        new_qelement->elem.value = hv->value;
+    }
+    list_add(&new_qelement->elem.list, &q->head);
+    return true;
+}
+
+// 釋放整個 arena 隊列：只走訪區塊與長字串，不走訪元素
+void q_free_arena(arena_queue_t *q)
+{
+    if (!q) {
+        return;
+    }
+    for (heap_value_t *hv = q->heap_values; hv;) {
+        heap_value_t *next = hv->next;
+        mem_account_free(&q->mem, hv, sizeof(heap_value_t) + strlen(hv->value) + 1);
+        hv = next;
+    }
+    for (arena_chunk_t *chunk = q->chunks; chunk;) {
+        arena_chunk_t *next = chunk->next;
+        mem_account_free(&q->mem, chunk, sizeof(arena_chunk_t) + chunk->size);
+        chunk = next;
+    }
+    mem_account_free(&q->mem, q, sizeof(arena_queue_t));
+}
+
+/*---------------------- Main 測試 ----------------------*/
+
+// 走訪整個隊列並加總數值，用來比較兩種配置方式的走訪成本
+static long sum_list(struct list_head *head)
+{
+    long sum = 0;
+    struct list_head *pos;
+    for (pos = head->next; pos != head; pos = pos->next) {
+        sum += atoi(list_entry(pos, element_t, list)->value);
+    }
+    return sum;
+}
+
+/*
+ * --mem：以同一組資料建立兩種隊列，比較每個元素實際占用的記憶體
+ * （需以 -DMEM_ACCOUNT 編譯）。value_len 控制字串長度，超過 inline 容量時
+ * arena 隊列也要為字串另外 malloc。
+ */
+static int mem_report(void)
+{
+    const int value_lens[] = {3, 7, 40};
+    for (size_t v = 0; v < sizeof(value_lens) / sizeof(value_lens[0]); v++) {
+        for (int num_elements = 1000; num_elements <= 1000000; num_elements *= 10) {
+            char value[64];
+            struct list_head *queue = q_new();
+            arena_queue_t *aq = q_new_arena();
+            if (!queue || !aq) {
+                fprintf(stderr, "Failed to create list.\n");
+                return 1;
+            }
+            for (int i = 0; i < num_elements; i++) {
+                // 固定長度：i % 1000 補 0 到 value_lens[v] 位
+                snprintf(value, sizeof(value), "%0*d", value_lens[v], i % 1000);
+                if (!q_insert_head(queue, value) || !q_insert_head_arena(aq, value)) {
+                    fprintf(stderr, "Failed to insert element.\n");
+                    return 1;
+                }
+            }
+            printf("%d elements, %d-byte values\n", num_elements, value_lens[v]);
+            mem_account_t *mems[] = {q_mem(queue), &aq->mem};
+            for (int m = 0; m < 2; m++) {
+                printf("  ");
+                mem_account_report(mems[m], stdout);
+                if (mem_account_enabled()) {
+                    printf("    %.1f bytes/element with malloc overhead\n",
+                           (double) mems[m]->live_footprint / num_elements);
+                }
+            }
+            q_free(queue);
+            q_free_arena(aq);
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc > 1 && strcmp(argv[1], "--mem") == 0) {
+        return mem_report();
+    }
+
+    printf("%-8s %10s %14s %14s %14s\n", "queue", "elements", "build/elem",
+           "traverse/elem", "free/elem");
+    for (int num_elements = 1000; num_elements <= 10000000; num_elements *= 10) {
+        char random_str[8];
+        int64_t build, traverse, teardown;
+        long sum_malloc, sum_arena;
+
+        // 一般隊列：q_insert_head 每個元素 malloc + strdup
+        srand(1);
+        build = measure_cycles_begin();
+        struct list_head *queue = q_new();
+        if (!queue) {
+            fprintf(stderr, "Failed to create list.\n");
+            return 1;
+        }
+        for (int i = 0; i < num_elements; i++) {
+            sprintf(random_str, "%d", rand() % 1000);
+            if (!q_insert_head(queue, random_str)) {
+                fprintf(stderr, "Failed to insert element.\n");
+                return 1;
+            }
+        }
+        build = measure_cycles_end() - build;
+        traverse = measure_cycles_begin();
+        sum_malloc = sum_list(queue);
+        traverse = measure_cycles_end() - traverse;
+        teardown = measure_cycles_begin();
+        q_free(queue);
+        teardown = measure_cycles_end() - teardown;
+        printf("%-8s %10d %14.1f %14.1f %14.1f\n", "malloc", num_elements,
+               (double) build / num_elements, (double) traverse / num_elements,
+               (double) teardown / num_elements);
+
+        // arena 隊列：同一組資料
+        srand(1);
+        build = measure_cycles_begin();
+        arena_queue_t *aq = q_new_arena();
+        if (!aq) {
+            fprintf(stderr, "Failed to create list.\n");
+            return 1;
+        }
+        for (int i = 0; i < num_elements; i++) {
+            sprintf(random_str, "%d", rand() % 1000);
+            if (!q_insert_head_arena(aq, random_str)) {
+                fprintf(stderr, "Failed to insert element.\n");
+                return 1;
+            }
+        }
+        build = measure_cycles_end() - build;
+        traverse = measure_cycles_begin();
+        sum_arena = sum_list(&aq->head);
+        traverse = measure_cycles_end() - traverse;
+        teardown = measure_cycles_begin();
+        q_free_arena(aq);
+        teardown = measure_cycles_end() - teardown;
+        printf("%-8s %10d %14.1f %14.1f %14.1f\n", "arena", num_elements,
+               (double) build / num_elements, (double) traverse / num_elements,
+               (double) teardown / num_elements);
+
+        if (sum_malloc != sum_arena) {
+            fprintf(stderr, "arena queue holds different values\n");
+            return 1;
+        }
+    }
+
+    // 長字串改用 malloc，仍可一起釋放
+    arena_queue_t *aq = q_new_arena();
+    if (!aq || !q_insert_head_arena(aq, "short") ||
+        !q_insert_head_arena(aq, "a value that does not fit inline") ||
+        aq->num_heap_values != 1 ||
+        strcmp(list_entry(aq->head.next, element_t, list)->value,
+               "a value that does not fit inline") != 0) {
+        fprintf(stderr, "long value fallback failed\n");
+        return 1;
+    }
+    q_free_arena(aq);
+    return 0;
+}
@@ -0,0 +1,230 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <stdint.h>
+
+#include "intrusive.h"
+#include "measure.h"
+
+// 鏈表元素結構：包含一個字串與鏈表節點
+typedef struct {
+    char *value;
+    struct list_head list;
+} element_t;
+
+#include "list_sort.h"
+
+// 遍歷鏈表並印出前 max_print 個元素的字串
+void print_list(struct list_head *head, int max_print) {
+    struct list_head *pos;
+    int count = 0;
+    for (pos = head->next; pos != head && count < max_print; pos = pos->next) {
+        element_t *elem = container_of(pos, element_t, list);
+        printf("Element %d: %s\n", count, elem->value);
+        count++;
+    }
+}
+
+/*---------------------- Radix Sort ----------------------*/
+
+#define RADIX_BITS 8
+#define RADIX_BUCKETS (1 << RADIX_BITS)
+
+// 將整數鍵值轉為無號數，並翻轉符號位元，使負數排在正數之前
+static inline uint32_t radix_numeric_key(const char *s)
+{
+    return (uint32_t) atoi(s) ^ 0x80000000u;
+}
+
+// 依照 digit 函式把每個節點搬到對應的桶中，最後依序串回 head
+// 只改變節點的鏈結，不複製任何字串；同一個桶內保留原本順序（穩定）
+#define RADIX_SCATTER_GATHER(head, buckets, digit_expr)           \
+    do {                                                          \
+        struct list_head *pos_, *safe_;                           \
+        for (int b_ = 0; b_ < RADIX_BUCKETS; b_++)                \
+            INIT_LIST_HEAD(&(buckets)[b_]);                       \
+        list_for_each_safe(pos_, safe_, head) {                   \
+            const char *s = list_entry(pos_, element_t, list)->value; \
+            list_add_tail(pos_, &(buckets)[(digit_expr)]);        \
+        }                                                         \
+        INIT_LIST_HEAD(head);                                     \
+        for (int b_ = 0; b_ < RADIX_BUCKETS; b_++)                \
+            list_splice_tail(&(buckets)[b_], head);               \
+    } while (0)
+
+/**
+ * radix_sort_numeric - 以 atoi 的整數值做 LSD 基數排序
+ * @head: 隊列頭
+ *
+ * 說明：
+ * - 每輪取 8 位元當作一個位數，最多 4 輪。
+ * - 先掃一次找出所有鍵值中會變動的位元，全部相同的位數整輪略過，
+ *   例如 rand() % 1000 只需要 2 輪。
+ */
+void radix_sort_numeric(struct list_head *head)
+{
+    if (list_empty(head) || list_is_singular(head)) {
+        return;
+    }
+    struct list_head buckets[RADIX_BUCKETS];
+    struct list_head *pos;
+
+    uint32_t first = radix_numeric_key(list_entry(head->next, element_t, list)->value);
+    uint32_t diff = 0;
+    for (pos = head->next; pos != head; pos = pos->next) {
+        diff |= radix_numeric_key(list_entry(pos, element_t, list)->value) ^ first;
+    }
+
+    for (int shift = 0; shift < 32; shift += RADIX_BITS) {
+        if (!((diff >> shift) & (RADIX_BUCKETS - 1))) {
+            continue;  // 此位數所有鍵值都相同，不影響順序
+        }
+        RADIX_SCATTER_GATHER(head, buckets,
+                             (radix_numeric_key(s) >> shift) & (RADIX_BUCKETS - 1));
+    }
+}
+
+/**
+ * radix_sort_string - 與 strcmp 相同順序的 LSD 基數排序
+ * @head: 隊列頭
+ *
+ * 說明：
+ * - 從最長字串的最後一個字元往前，每輪以一個位元組分桶。
+ * - 較短的字串在超出長度的位置視為 0，因此會排在以它為前綴的字串之前。
+ * - 先依長度做一次穩定的分桶，長度相同者維持原本順序、短的在前。
+ *   第 i 輪只有長度大於 i 的字串需要分桶，它們正好是鏈表的尾段；
+ *   其餘字串的位數都是 0，留在前段不動，順序與原本的做法相同。
+ *   每個字串的長度只在分桶前計算，整體為 O(n·L)，不必每輪以 strnlen 重新量測。
+ */
+void radix_sort_string(struct list_head *head)
+{
+    if (list_empty(head) || list_is_singular(head)) {
+        return;
+    }
+    struct list_head buckets[RADIX_BUCKETS];
+    struct list_head active;
+    struct list_head *pos;
+
+    size_t max_len = 0;
+    for (pos = head->next; pos != head; pos = pos->next) {
+        size_t len = strlen(list_entry(pos, element_t, list)->value);
+        if (len > max_len) {
+            max_len = len;
+        }
+    }
+
+    // 依長度穩定排序；max_len 以上的位數全為 0，整輪略過
+    for (unsigned shift = 0; shift < 8 * sizeof(size_t) && (max_len >> shift);
+         shift += RADIX_BITS) {
+        RADIX_SCATTER_GATHER(head, buckets, (strlen(s) >> shift) & (RADIX_BUCKETS - 1));
+    }
+
+    // active 存放長度大於 i 的字串，已依第 i + 1 個字元之後的部分排好
+    INIT_LIST_HEAD(&active);
+    for (size_t i = max_len; i-- > 0;) {
+        // 長度恰為 i + 1 的字串在 head 的尾端，依原本順序移到 active 前面
+        while (!list_empty(head) &&
+               strnlen(list_entry(head->prev, element_t, list)->value, i + 1) > i) {
+            list_move(head->prev, &active);
+        }
+        RADIX_SCATTER_GATHER(&active, buckets, (unsigned char) s[i]);
+    }
+    // 只剩空字串留在 head，排在最前面
+    list_splice_tail(&active, head);
+}
+
+/*---------------------- 比較排序（對照組） ----------------------*/
+
+/*---------------------- Main 測試 ----------------------*/
+
+// 比較排序為 O(n^2)，超過此大小就不跑
+#define COMPARISON_SORT_LIMIT 10000
+
+typedef struct {
+    const char *name;
+    void (*sort)(struct list_head *head);
+    bool numeric;     // true: 以 atoi 比較；false: 以 strcmp 比較
+    int max_elements;
+} sort_case_t;
+
+static bool is_sorted(struct list_head *head, bool numeric)
+{
+    struct list_head *pos;
+    for (pos = head->next; pos != head && pos->next != head; pos = pos->next) {
+        const char *a = list_entry(pos, element_t, list)->value;
+        const char *b = list_entry(pos->next, element_t, list)->value;
+        if (numeric ? atoi(a) > atoi(b) : strcmp(a, b) > 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*---------------------- 效能測試 ----------------------*/
+
+#include "sort_bench.h"
+
+static const sort_bench_case_t bench_cases[] = {
+    {"radix_sort_numeric", radix_sort_numeric, SORT_BENCH_NO_LIMIT},
+    {"radix_sort_string", radix_sort_string, SORT_BENCH_NO_LIMIT},
+};
+
+int main(int argc, char *argv[])
+{
+    // --bench：以固定種子跑完整的效能測試並輸出 CSV
+    if (argc > 1 && strcmp(argv[1], "--bench") == 0) {
+        return sort_bench_main(argc, argv, bench_cases,
+                               sizeof(bench_cases) / sizeof(bench_cases[0]));
+    }
+    const sort_case_t cases[] = {
+        {"radix_sort_numeric", radix_sort_numeric, true, 10000000},
+        {"radix_sort_string", radix_sort_string, false, 10000000},
+        {"sediment_sort", sediment_sort, true, COMPARISON_SORT_LIMIT},
+        {"insertion_sort", insertion_sort, false, COMPARISON_SORT_LIMIT},
+    };
+    unsigned seed = (unsigned) time(NULL);
+
+    printf("%-20s %10s %16s %12s\n", "sort", "elements", "cycles", "cycles/elem");
+    for (int num_elements = 1000; num_elements <= 10000000; num_elements *= 10) {
+        for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+            if (num_elements > cases[c].max_elements) {
+                printf("%-20s %10d %16s %12s\n", cases[c].name, num_elements, "skipped", "-");
+                continue;
+            }
+
+            // 每個排序都用同一組資料
+            srand(seed);
+            struct list_head *queue = q_new();
+            if (!queue) {
+                fprintf(stderr, "Failed to create list.\n");
+                return 1;
+            }
+            for (int i = 0; i < num_elements; i++) {
+                char random_str[8];
+                sprintf(random_str, "%d", rand() % 1000);
+                if (!q_insert_head(queue, random_str)) {
+                    fprintf(stderr, "Failed to insert element.\n");
+                    q_free(queue);
+                    return 1;
+                }
+            }
+
+            int64_t cycles = measure_cycles_begin();
+            cases[c].sort(queue);
+            cycles = measure_cycles_end() - cycles;
+
+            if (!is_sorted(queue, cases[c].numeric)) {
+                fprintf(stderr, "%s: list is not sorted\n", cases[c].name);
+                q_free(queue);
+                return 1;
+            }
+            printf("%-20s %10d %16ld %12.1f\n", cases[c].name, num_elements,
+                   (long) cycles, (double) cycles / num_elements);
+            q_free(queue);
+        }
+    }
+    return 0;
+}
@@ -2,320 +2,451 @@
 #include <stdlib.h>
 #include <time.h>
 
-typedef enum { RED, BLACK } color_t;
+#include "intrusive.h"
+#include "mem_account.h"
+#include "snapshot.h"
 
+/* Free blocks indexed by size; balancing lives in intrusive.h */
 typedef struct block {
     size_t size;
-    struct block *l, *r, *parent;
-    color_t color;
+    struct rb_node node;
 } block_t;
 
-block_t *root = NULL;
+struct rb_root root = RB_ROOT;
 
 // Function prototypes
-void rotate_left(block_t **root, block_t *x);
-void rotate_right(block_t **root, block_t *x);
-void insert_fixup(block_t **root, block_t *z);
-void delete_fixup(block_t **root, block_t *x);
-void rb_insert(block_t **root, block_t *z);
-block_t *rb_minimum(block_t *node);
-void rb_transplant(block_t **root, block_t *u, block_t *v);
-void rb_delete(block_t **root, block_t *z);
+void rb_insert(struct rb_root *root, block_t *z);
+block_t *rb_minimum(struct rb_root *root);
+void rb_delete(struct rb_root *root, block_t *z);
 block_t *new_block(size_t size);
-block_t *find_block(block_t *root, size_t size);
-
-// Left rotate
-void rotate_left(block_t **root, block_t *x) {
-    block_t *y = x->r;
-    x->r = y->l;
-    if (y->l) y->l->parent = x;
-    y->parent = x->parent;
-    if (!x->parent) *root = y;
-    else if (x == x->parent->l) x->parent->l = y;
-    else x->parent->r = y;
-    y->l = x;
-    x->parent = y;
-}
-
-// Right rotate
-void rotate_right(block_t **root, block_t *y) {
-    block_t *x = y->l;
-    y->l = x->r;
-    if (x->r) x->r->parent = y;
-    x->parent = y->parent;
-    if (!y->parent) *root = x;
-    else if (y == y->parent->l) y->parent->l = x;
-    else y->parent->r = x;
-    x->r = y;
-    y->parent = x;
-}
+block_t *new_block_mem(mem_account_t *mem, size_t size);
+void free_block_mem(mem_account_t *mem, block_t *block);
+block_t *find_block(struct rb_root *root, size_t size);
 
-// Fix RB Tree after insertion
-void insert_fixup(block_t **root, block_t *z) {
-    while (z->parent && z->parent->color == RED) {
-        if (z->parent == z->parent->parent->l) {
-            block_t *y = z->parent->parent->r;
-            if (y && y->color == RED) {
-                z->parent->color = BLACK;
-                y->color = BLACK;
-                z->parent->parent->color = RED;
-                z = z->parent->parent;
-            } else {
-                if (z == z->parent->r) {
-                    z = z->parent;
-                    rotate_left(root, z);
-                }
-                z->parent->color = BLACK;
-                z->parent->parent->color = RED;
-                rotate_right(root, z->parent->parent);
-            }
-        } else {
-            block_t *y = z->parent->parent->l;
-            if (y && y->color == RED) {
-                z->parent->color = BLACK;
-                y->color = BLACK;
-                z->parent->parent->color = RED;
-                z = z->parent->parent;
-            } else {
-                if (z == z->parent->l) {
-                    z = z->parent;
-                    rotate_right(root, z);
-                }
-                z->parent->color = BLACK;
-                z->parent->parent->color = RED;
-                rotate_left(root, z->parent->parent);
-            }
-        }
-    }
-    (*root)->color = BLACK;
+static inline block_t *rb_block(struct rb_node *node) {
+    return node ? rb_entry(node, block_t, node) : NULL;
 }
 
-// Insert a block into RB tree
-void rb_insert(block_t **root, block_t *z) {
-    block_t *y = NULL;
-    block_t *x = *root;
+// Insert a block into RB tree; equal sizes go to the right
+void rb_insert(struct rb_root *root, block_t *z) {
+    struct rb_node **link = &root->node, *parent = NULL;
 
-    while (x) {
-        y = x;
-        if (z->size < x->size)
-            x = x->l;
+    while (*link) {
+        parent = *link;
+        if (z->size < rb_block(parent)->size)
+            link = &parent->left;
         else
-            x = x->r;
-    }
-    z->parent = y;
-
-    if (!y) 
-        *root = z;
-    else if (z->size < y->size) 
-        y->l = z;
-    else 
-        y->r = z;
-
-    z->l = NULL;
-    z->r = NULL;
-    z->color = RED;
-    insert_fixup(root, z);
-}
-
-// Find the smallest (leftmost) node in a subtree.
-block_t *rb_minimum(block_t *node) {
-    while (node->l) {  // Keep going left
-        node = node->l;
-    }
-    return node;  // Leftmost node is the minimum
-}
-
-// Delete a block from RB tree
-void rb_delete(block_t **root, block_t *z) {
-    block_t *y = z, *x;
-    color_t y_original_color = y->color;
-
-    if (!z->l) {
-        x = z->r;
-        rb_transplant(root, z, z->r);
-    } else if (!z->r) {
-        x = z->l;
-        rb_transplant(root, z, z->l);
-    } else {
-        y = rb_minimum(z->r);
-        y_original_color = y->color;
-        x = y->r;
-        if (y->parent == z) {
-            if (x) x->parent = y;
-        } else {
-            rb_transplant(root, y, y->r);
-            y->r = z->r;
-            y->r->parent = y;
-        }
-        rb_transplant(root, z, y);
-        y->l = z->l;
-        y->l->parent = y;
-        y->color = z->color;
-    }
-    if (y_original_color == BLACK) {
-        if (x) {
-            delete_fixup(root, x);
-        } else {
-            //printf("Warning: x is NULL, skipping delete_fixup()\n");
-            ;
-        }
+            link = &parent->right;
     }
+    rb_link_node(&z->node, parent, link);
+    rb_insert_color(&z->node, root);
 }
 
-void rb_transplant(block_t **root, block_t *u, block_t *v) {
-    if (!u->parent) {  // If u is the root
-        *root = v;
-    } else if (u == u->parent->l) {  // If u is a left child
-        u->parent->l = v;
-    } else {  // If u is a right child
-        u->parent->r = v;
-    }
-    
-    if (v) {  // Update parent pointer of v (if v is not NULL)
-        v->parent = u->parent;
-    }
+// Find the smallest block in the tree, NULL when it is empty
+block_t *rb_minimum(struct rb_root *root) {
+    return rb_block(rb_first(root));
 }
 
-void delete_fixup(block_t **root, block_t *x) {
-    while (x != *root && (!x || x->color == BLACK) && (x->parent)) {
-        if (x == x->parent->l) { // x is a left child
-            block_t *w = x->parent->r; // Sibling of x
-            
-            // Case 1: Sibling w is RED
-            if (w->color == RED) {
-                w->color = BLACK;
-                x->parent->color = RED;
-                rotate_left(root, x->parent);
-                w = x->parent->r;
-            }
-	    
-            // Case 2: Both of w's children are BLACK
-            if ((!w->l || w->l->color == BLACK) && (!w->r || w->r->color == BLACK)) {
-                w->color = RED;
-                x = x->parent; // Move problem up to parent
-            } else {
-                // Case 3: w’s left child is RED, right child is BLACK
-                if (!w->r || w->r->color == BLACK) {
-                    if (w->l) w->l->color = BLACK;
-                    w->color = RED;
-                    rotate_right(root, w);
-                    w = x->parent->r;
-                }
-
-                // Case 4: w’s right child is RED
-                w->color = x->parent->color;
-                x->parent->color = BLACK;
-                if (w->r) w->r->color = BLACK;
-                rotate_left(root, x->parent);
-                x = *root; // End loop
-            }
-        } else { // Mirror cases where x is a right child
-            block_t *w = x->parent->l;    
-                
-            // Case 1: Sibling w is RED
-            if (w->color == RED) {
-                w->color = BLACK;
-                x->parent->color = RED;
-                rotate_right(root, x->parent);
-                w = x->parent->l;
-            }
-
-            // Case 2: Both of w's children are BLACK
-            if ((!w->l || w->l->color == BLACK) && (!w->r || w->r->color == BLACK)) {
-                w->color = RED;
-                x = x->parent;
-            } else {
-                // Case 3: w’s right child is RED, left child is BLACK
-                if (!w->l || w->l->color == BLACK) {
-                    if (w->r) w->r->color = BLACK;
-                    w->color = RED;
-                    rotate_left(root, w);
-                    w = x->parent->l;
-                }
-
-                // Case 4: w’s left child is RED
-                w->color = x->parent->color;
-                x->parent->color = BLACK;
-                if (w->l) w->l->color = BLACK;
-                rotate_right(root, x->parent);
-                x = *root; // End loop
-            }
-        }
-    }
-    if (x) 
-        x->color = BLACK; // Restore black balance
+// Delete a block from RB tree; the block itself is left to the caller
+void rb_delete(struct rb_root *root, block_t *z) {
+    rb_erase(&z->node, root);
 }
 
-// Create new block
-block_t *new_block(size_t size) {
-    block_t *new = (block_t *)malloc(sizeof(block_t)); // FIX: Allocate correct size
+// Create new block, counted in mem when it is not NULL
+block_t *new_block_mem(mem_account_t *mem, size_t size) {
+    block_t *new = (block_t *)mem_account_malloc(mem, sizeof(block_t)); // FIX: Allocate correct size
     if (!new) {
         fprintf(stderr, "Memory allocation failed\n");
         exit(EXIT_FAILURE);
     }
     new->size = size;
-    new->color = RED;
-    new->l = NULL;
-    new->r = NULL;
-    new->parent = NULL;
+    new->node.parent = NULL;
+    new->node.left = NULL;
+    new->node.right = NULL;
+    new->node.color = RB_COLOR_RED;
     return new;
 }
 
-void print_tree_val(block_t *root) {
-    if (!root)
+block_t *new_block(size_t size) {
+    return new_block_mem(NULL, size);
+}
+
+// Free a block that is no longer in any tree
+void free_block_mem(mem_account_t *mem, block_t *block) {
+    mem_account_free(mem, block, sizeof(block_t));
+}
+
+void print_tree_val(struct rb_node *node) {
+    if (!node)
         return;
-    if (root->r){
-        printf("   %ld->", root->size);
-        printf("%ld\n", root->r->size);
-        print_tree_val(root->r);
+    if (node->right){
+        printf("   %ld->", rb_block(node)->size);
+        printf("%ld\n", rb_block(node->right)->size);
+        print_tree_val(node->right);
     }
-    if (root->l){
-        printf("   %ld->", root->size);
-        printf("%ld\n", root->l->size);
-        print_tree_val(root->l);
+    if (node->left){
+        printf("   %ld->", rb_block(node)->size);
+        printf("%ld\n", rb_block(node->left)->size);
+        print_tree_val(node->left);
     }
 }
 
-void print_tree_color(block_t *root, color_t color) {
-    if (!root)
+void print_tree_color(struct rb_node *node, enum rb_color color) {
+    if (!node)
         return;
-    if (root-> color == color)
-        printf("    %ld\n", root->size);
-    if (root->r)
-        print_tree_color(root->r, color);
-    if (root->l)
-        print_tree_color(root->l, color);
+    if (node->color == color)
+        printf("    %ld\n", rb_block(node)->size);
+    if (node->right)
+        print_tree_color(node->right, color);
+    if (node->left)
+        print_tree_color(node->left, color);
 }
 
-block_t *find_block(block_t *root, size_t size) {
-    if (!root)
-        return NULL;
-    if (root->size == size)
-        return root;
-    if (root->size > size)
-        return find_block(root->l, size);
-    else
-        return find_block(root->r, size); 
+block_t *find_block(struct rb_root *root, size_t size) {
+    struct rb_node *node = root->node;
+    while (node) {
+        block_t *block = rb_block(node);
+        if (block->size == size)
+            return block;
+        node = block->size > size ? node->left : node->right;
+    }
+    return NULL;
 }
 
-void generate_graviz(block_t *root){
+void generate_graviz(struct rb_root *root){
     printf("digraph G {\n");
     printf("  subgraph red {\n");
     printf("    node [color=\"red\", style=\"filled\", group=\"red\"]\n");
-    print_tree_color(root, RED);
+    print_tree_color(root->node, RB_COLOR_RED);
     printf("  }\n");
     
     printf("  subgraph black {\n");
     printf("    node [color=\"black\", style=\"filled\", group=\"black\", fontcolor=\"white\"]\n");
-    print_tree_color(root, BLACK);
+    print_tree_color(root->node, RB_COLOR_BLACK);
     printf("  }\n");
     
-    print_tree_val(root);
+    print_tree_val(root->node);
     printf("}\n\n\n\n");
 }
 
-int main() {
+/*
+ * Timing analysis (--dudect): class 0 always searches for the smallest block,
+ * class 1 searches for random sizes. Any difference shows how much
+ * find_block latency depends on the depth of the requested size.
+ */
+#include <stdint.h>
+#include <string.h>
+#include "dudect.h"
+
+#define DUDECT_TREE_BLOCKS 10000
+#define DUDECT_MEASUREMENTS 20000
+
+typedef struct {
+    struct rb_root tree;
+    size_t fixed_size;
+    size_t sizes[DUDECT_MEASUREMENTS];
+} rb_dudect_ctx_t;
+
+static block_t *volatile rb_dudect_sink;
+
+static void rb_dudect_prepare(void *ctx, const uint8_t *classes, size_t n) {
+    rb_dudect_ctx_t *c = ctx;
+    for (size_t i = 0; i < n; i++)
+        c->sizes[i] = classes[i] ? (size_t)(rand() % DUDECT_TREE_BLOCKS) : c->fixed_size;
+}
+
+static void rb_dudect_run(void *ctx, size_t i) {
+    rb_dudect_ctx_t *c = ctx;
+    rb_dudect_sink = find_block(&c->tree, c->sizes[i]);
+}
+
+static void free_tree(struct rb_node *node) {
+    if (!node)
+        return;
+    free_tree(node->left);
+    free_tree(node->right);
+    free(rb_block(node));
+}
+
+static int rb_dudect(int batches) {
+    static rb_dudect_ctx_t ctx;
+    int order[DUDECT_TREE_BLOCKS];
+    for (int i = 0; i < DUDECT_TREE_BLOCKS; i++)
+        order[i] = i;
+    for (int i = DUDECT_TREE_BLOCKS - 1; i > 0; i--) {
+        int idx = rand() % (i + 1);
+        int temp = order[idx];
+        order[idx] = order[i];
+        order[i] = temp;
+    }
+    ctx.tree = RB_ROOT;
+    for (int i = 0; i < DUDECT_TREE_BLOCKS; i++)
+        rb_insert(&ctx.tree, new_block(order[i]));
+    ctx.fixed_size = rb_minimum(&ctx.tree)->size;
+
+    dudect_target_t target = {
+        .name = "find_block",
+        .measurements = DUDECT_MEASUREMENTS,
+        .ctx = &ctx,
+        .prepare = rb_dudect_prepare,
+        .run = rb_dudect_run,
+    };
+    int leaks = dudect_run(&target, batches);
+    free_tree(ctx.tree.node);
+    return leaks;
+}
+
+/*
+ * Memory footprint (--mem, build with -DMEM_ACCOUNT): build free trees of
+ * growing size, remove and free half of the blocks, and report what the tree
+ * occupies per block at its peak and after the removals.
+ */
+static void free_tree_mem(mem_account_t *mem, struct rb_node *node) {
+    if (!node)
+        return;
+    free_tree_mem(mem, node->left);
+    free_tree_mem(mem, node->right);
+    free_block_mem(mem, rb_block(node));
+}
+
+static int rb_mem_report(void) {
+    for (int blocks = 1000; blocks <= 1000000; blocks *= 10) {
+        mem_account_t mem;
+        struct rb_root tree = RB_ROOT;
+        mem_account_init(&mem, "rbtree free index");
+        for (int i = 0; i < blocks; i++)
+            rb_insert(&tree, new_block_mem(&mem, (size_t)(uint32_t)(i * 2654435761u)));
+        for (int i = 0; i < blocks / 2; i++) {
+            block_t *min = rb_minimum(&tree);
+            rb_delete(&tree, min);
+            free_block_mem(&mem, min);
+        }
+        printf("%d blocks inserted, %d left", blocks, blocks - blocks / 2);
+        if (mem_account_enabled())
+            printf(": %.1f bytes/block with malloc overhead",
+                   (double)mem.live_footprint / (blocks - blocks / 2));
+        printf("\n");
+        mem_account_report(&mem, stdout);
+        free_tree_mem(&mem, tree.node);
+    }
+    return 0;
+}
+
+/*
+ * Snapshots: rb_save writes the sizes of a free tree in order as a flat
+ * uint64_t array after the snapshot header. The image holds no pointers, so
+ * rb_snapshot_open only maps it, and lookups binary-search the array.
+ * rb_snapshot_promote turns it back into a tree in O(n) without rotations.
+ */
+#define RB_SNAPSHOT_MAGIC "RBSNAP"
+
+typedef struct {
+    snapshot_t snap;
+    size_t count;
+    const uint64_t *sizes;
+} rb_snapshot_t;
+
+static uint64_t rb_snapshot_size(uint64_t count) {
+    return sizeof(snapshot_header_t) + count * sizeof(uint64_t);
+}
+
+// Write the tree to path; returns 0 on success, -1 on failure
+int rb_save(struct rb_root *root, const char *path) {
+    uint64_t count = 0;
+    for (struct rb_node *node = rb_first(root); node; node = rb_next(node))
+        count++;
+
+    uint64_t size = rb_snapshot_size(count);
+    FILE *f = snapshot_create(path, RB_SNAPSHOT_MAGIC, count, 0, size);
+    if (!f)
+        return -1;
+    // batch the sizes so stdio sees large writes
+    uint64_t buf[4096];
+    size_t n = 0;
+    for (struct rb_node *node = rb_first(root); node; node = rb_next(node)) {
+        buf[n++] = rb_block(node)->size;
+        if (n == sizeof(buf) / sizeof(buf[0]) || !rb_next(node)) {
+            if (fwrite(buf, sizeof(buf[0]), n, f) != n) {
+                // a short image makes snapshot_finish discard the temporary file
+                size = UINT64_MAX;
+                break;
+            }
+            n = 0;
+        }
+    }
+    return snapshot_finish(f, path, size);
+}
+
+// Map a snapshot for read-only use; returns 0 on success, -1 on failure
+int rb_snapshot_open(rb_snapshot_t *rs, const char *path) {
+    if (snapshot_open(&rs->snap, path, RB_SNAPSHOT_MAGIC) != 0)
+        return -1;
+    const snapshot_header_t *h = rs->snap.header;
+    if (h->image_size != rb_snapshot_size(h->count)) {
+        fprintf(stderr, "%s: corrupt free tree snapshot\n", path);
+        snapshot_close(&rs->snap);
+        return -1;
+    }
+    rs->count = h->count;
+    rs->sizes = snapshot_section(&rs->snap, sizeof(snapshot_header_t));
+    return 0;
+}
+
+// Index of the first size >= size, count when there is none
+size_t rb_snapshot_lower_bound(const rb_snapshot_t *rs, size_t size) {
+    size_t lo = 0, hi = rs->count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (rs->sizes[mid] < size)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+// Same as find_block, but returns a pointer into the read-only image
+const uint64_t *rb_snapshot_find(const rb_snapshot_t *rs, size_t size) {
+    size_t i = rb_snapshot_lower_bound(rs, size);
+    return i < rs->count && rs->sizes[i] == size ? &rs->sizes[i] : NULL;
+}
+
+/*
+ * Build a balanced subtree from the half-open range sizes[lo, hi) in
+ * order, so the blocks are allocated in address order too. Every level is
+ * full except possibly the deepest one, which is colored red; all
+ * root-to-leaf paths then have the same number of black nodes.
+ */
+static struct rb_node *rb_build_sorted(mem_account_t *mem, const uint64_t *sizes, size_t lo,
+                                       size_t hi, int level, int red_level) {
+    if (lo >= hi)
+        return NULL;
+    size_t mid = lo + (hi - lo - 1) / 2;
+    struct rb_node *left = rb_build_sorted(mem, sizes, lo, mid, level + 1, red_level);
+    block_t *block = new_block_mem(mem, sizes[mid]);
+    struct rb_node *node = &block->node;
+    struct rb_node *right = rb_build_sorted(mem, sizes, mid + 1, hi, level + 1, red_level);
+
+    node->left = left;
+    node->right = right;
+    if (left)
+        left->parent = node;
+    if (right)
+        right->parent = node;
+    node->color = level == red_level ? RB_COLOR_RED : RB_COLOR_BLACK;
+    return node;
+}
+
+// Build a mutable free tree from the image; blocks are counted in mem when it is not NULL
+struct rb_root rb_snapshot_promote(const rb_snapshot_t *rs, mem_account_t *mem) {
+    // depth of the deepest level, which is the only one that may be partial
+    int red_level = -1;
+    for (size_t n = rs->count; n; n /= 2)
+        red_level++;
+    // a deepest level that is full needs no red nodes
+    if (rs->count && ((rs->count + 1) & rs->count) == 0)
+        red_level = -1;
+
+    struct rb_root root = RB_ROOT;
+    root.node = rb_build_sorted(mem, rs->sizes, 0, rs->count, 0, red_level);
+    if (root.node)
+        root.node->parent = NULL;
+    return root;
+}
+
+void rb_snapshot_close(rb_snapshot_t *rs) {
+    snapshot_close(&rs->snap);
+}
+
+/*
+ * Startup benchmark (--snapshot [max blocks] [path]): for 10^6 blocks and
+ * up, compare rebuilding a free tree with rb_insert against opening its
+ * snapshot, then time lookups on both and promoting the image back to a
+ * tree. The page cache is warm after rb_save, so "open" is the cost of mmap
+ * alone. Both trees are live at once, so 10^8 blocks need about 10 GB.
+ */
+#define SNAPSHOT_BENCH_LOOKUPS 1000000
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static int rb_snapshot_bench(long max_blocks, const char *path) {
+    printf("%10s %10s %10s %10s %10s %10s %13s %13s %10s\n", "blocks", "build_s", "save_s",
+           "MiB", "open_ms", "promote_s", "find_block_ns", "image_find_ns", "verify");
+    for (long blocks = 1000000; blocks <= max_blocks; blocks *= 10) {
+        double t0 = now_seconds();
+        struct rb_root tree = RB_ROOT;
+        for (long i = 0; i < blocks; i++)
+            rb_insert(&tree, new_block((size_t)(uint32_t)(i * 2654435761u)));
+        double build = now_seconds() - t0;
+
+        t0 = now_seconds();
+        if (rb_save(&tree, path) != 0)
+            return 1;
+        double save = now_seconds() - t0;
+
+        rb_snapshot_t rs;
+        t0 = now_seconds();
+        if (rb_snapshot_open(&rs, path) != 0)
+            return 1;
+        double open = now_seconds() - t0;
+
+        // the same pseudo-random sizes for both lookups
+        uint32_t seed = 1;
+        long hits = 0;
+        t0 = now_seconds();
+        for (int i = 0; i < SNAPSHOT_BENCH_LOOKUPS; i++) {
+            seed = seed * 1103515245u + 12345u;
+            hits += rb_snapshot_find(&rs, (uint32_t)((seed % blocks) * 2654435761u)) != NULL;
+        }
+        double image_find = now_seconds() - t0;
+
+        seed = 1;
+        t0 = now_seconds();
+        for (int i = 0; i < SNAPSHOT_BENCH_LOOKUPS; i++) {
+            seed = seed * 1103515245u + 12345u;
+            hits += find_block(&tree, (uint32_t)((seed % blocks) * 2654435761u)) != NULL;
+        }
+        double tree_find = now_seconds() - t0;
+
+        // promote before freeing tree, so both start from an unfragmented heap
+        t0 = now_seconds();
+        struct rb_root promoted = rb_snapshot_promote(&rs, NULL);
+        double promote = now_seconds() - t0;
+        free_tree(tree.node);
+
+        bool ok = hits == 2L * SNAPSHOT_BENCH_LOOKUPS;
+        size_t i = 0;
+        for (struct rb_node *node = rb_first(&promoted); ok && node; node = rb_next(node), i++)
+            ok = i < rs.count && rb_block(node)->size == rs.sizes[i];
+        ok = ok && i == rs.count;
+        free_tree(promoted.node);
+        rb_snapshot_close(&rs);
+
+        printf("%10ld %10.3f %10.3f %10.1f %10.3f %10.3f %13.1f %13.1f %10s\n", blocks, build,
+               save, (double)rb_snapshot_size(blocks) / (1 << 20), open * 1e3, promote,
+               tree_find * 1e9 / SNAPSHOT_BENCH_LOOKUPS,
+               image_find * 1e9 / SNAPSHOT_BENCH_LOOKUPS, ok ? "ok" : "FAIL");
+        if (!ok)
+            return 1;
+    }
+    unlink(path);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
     srand( time(NULL) );
+    if (argc > 1 && strcmp(argv[1], "--dudect") == 0)
+        return rb_dudect(argc > 2 ? atoi(argv[2]) : 10);
+    if (argc > 1 && strcmp(argv[1], "--mem") == 0)
+        return rb_mem_report();
+    if (argc > 1 && strcmp(argv[1], "--snapshot") == 0)
+        return rb_snapshot_bench(argc > 2 ? atol(argv[2]) : 10000000,
+                                 argc > 3 ? argv[3] : "/tmp/rbtree.snapshot");
+
     int array_size = 10000;
     // Generate random number table
     int rand_table[array_size];
@@ -346,7 +477,7 @@ int main() {
 
     for(int i = array_size-1; i > array_size/2; i--) {
         //printf("remove: %d\n", rand_table[i]);
-        block_t *target = find_block(root, rand_table[i]);
+        block_t *target = find_block(&root, rand_table[i]);
         rb_delete(&root, target);
     }
     // Print the tree after remove nodes
@@ -0,0 +1,243 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+/*
+ * 資料結構的快照檔：以 mmap 載入後直接唯讀使用
+ *
+ * 重新啟動時逐筆 map_add / rb_insert 重建資料結構，每個節點都要一次 malloc
+ * 與一次插入。快照把資料結構寫成與位址無關的映像檔：
+ * - 檔案內沒有指標，只有陣列與索引（或從檔頭起算的位移），
+ *   mmap 到任何位址都能直接使用，不需要逐一修正指標。
+ * - 載入只做一次 mmap 與檔頭檢查，頁面在第一次存取時才由核心讀入。
+ * - 各區段從 8 位元組對齊的位移開始，可以直接以對應型別存取。
+ *
+ * 檔案格式：snapshot_header_t（64 位元組）之後接各種類自訂的區段，
+ * 區段位移由 count 與 param 算出，讀寫兩端使用同一個計算函式。
+ * 數值以主機的位元組序寫入，載入時以 byte_order 檢查是否相符。
+ *
+ * 寫入時先寫到 path.tmp，完成後才 rename，中途失敗不會留下殘缺的快照。
+ *
+ * 用法：
+ *
+ *   FILE *f = snapshot_create(path, "MAPSNAP", count, bits, size);
+ *   fwrite(..., f);                // 依序寫入各區段
+ *   snapshot_finish(f, path, size);
+ *
+ *   snapshot_t snap;
+ *   snapshot_open(&snap, path, "MAPSNAP");
+ *   const uint32_t *start = snapshot_section(&snap, offset);
+ *   ...
+ *   snapshot_close(&snap);
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_BYTE_ORDER 0x01020304u
+#define SNAPSHOT_MAGIC_SIZE 8
+#define SNAPSHOT_ALIGN 8
+
+typedef struct {
+    char magic[SNAPSHOT_MAGIC_SIZE];  // 資料種類，例如 "MAPSNAP"
+    uint32_t version;
+    uint32_t byte_order;  // 寫入端的 SNAPSHOT_BYTE_ORDER
+    uint64_t count;       // 元素數
+    uint64_t param;       // 種類自訂，例如 map 的 bits
+    uint64_t image_size;  // 含檔頭的總大小，用來檢查截斷
+    uint64_t reserved[3];
+} snapshot_header_t;
+
+_Static_assert(sizeof(snapshot_header_t) == 64, "snapshot header must stay 64 bytes");
+
+/**
+ * snapshot_t - 已 mmap 的快照
+ * @base:   映像起點，也就是檔頭
+ * @size:   映像大小
+ * @header: 檔頭
+ */
+typedef struct {
+    void *base;
+    size_t size;
+    const snapshot_header_t *header;
+} snapshot_t;
+
+// 把位移進位到區段對齊
+static inline uint64_t snapshot_align(uint64_t offset)
+{
+    return (offset + SNAPSHOT_ALIGN - 1) & ~(uint64_t) (SNAPSHOT_ALIGN - 1);
+}
+
+static inline const void *snapshot_section(const snapshot_t *snap, uint64_t offset)
+{
+    return (const char *) snap->base + offset;
+}
+
+// 複製資料種類，超過 7 個字元的部分捨去，其餘補 0
+static inline void snapshot_set_magic(char *dst, const char *magic)
+{
+    size_t len = strlen(magic);
+    if (len > SNAPSHOT_MAGIC_SIZE - 1) {
+        len = SNAPSHOT_MAGIC_SIZE - 1;
+    }
+    memset(dst, 0, SNAPSHOT_MAGIC_SIZE);
+    memcpy(dst, magic, len);
+}
+
+// 以 0 補齊到 offset，讓下一個區段從對齊的位置開始
+static inline int snapshot_pad(FILE *f, uint64_t offset)
+{
+    static const char zero[SNAPSHOT_ALIGN];
+    long pos = ftell(f);
+    if (pos < 0 || (uint64_t) pos > offset || offset - (uint64_t) pos > SNAPSHOT_ALIGN) {
+        return -1;
+    }
+    size_t n = (size_t) (offset - (uint64_t) pos);
+    return fwrite(zero, 1, n, f) == n ? 0 : -1;
+}
+
+/**
+ * snapshot_create - 建立暫存的快照檔並寫入檔頭
+ * @path:       快照路徑，實際寫到 path.tmp
+ * @magic:      資料種類，最多 7 個字元
+ * @count:      元素數
+ * @param:      種類自訂的參數
+ * @image_size: 含檔頭的總大小
+ *
+ * 回傳寫入中的檔案，失敗時回傳 NULL。
+ */
+static inline FILE *snapshot_create(const char *path, const char *magic, uint64_t count,
+                                    uint64_t param, uint64_t image_size)
+{
+    char tmp[4096];
+    if (snprintf(tmp, sizeof(tmp), "%s.tmp", path) >= (int) sizeof(tmp)) {
+        return NULL;
+    }
+    FILE *f = fopen(tmp, "wb");
+    if (!f) {
+        perror(tmp);
+        return NULL;
+    }
+    // 大區段一次寫出，不經過 stdio 預設的小緩衝區
+    setvbuf(f, NULL, _IOFBF, 1 << 20);
+
+    snapshot_header_t header;
+    memset(&header, 0, sizeof(header));
+    snapshot_set_magic(header.magic, magic);
+    header.version = SNAPSHOT_VERSION;
+    header.byte_order = SNAPSHOT_BYTE_ORDER;
+    header.count = count;
+    header.param = param;
+    header.image_size = image_size;
+    if (fwrite(&header, sizeof(header), 1, f) != 1) {
+        perror(tmp);
+        fclose(f);
+        unlink(tmp);
+        return NULL;
+    }
+    return f;
+}
+
+/**
+ * snapshot_finish - 關閉快照檔並取代 path
+ * @f:          snapshot_create 回傳的檔案
+ * @path:       快照路徑
+ * @image_size: 預期寫入的總大小，與檔頭相同
+ *
+ * 成功回傳 0，失敗回傳 -1 並刪除暫存檔。
+ */
+static inline int snapshot_finish(FILE *f, const char *path, uint64_t image_size)
+{
+    char tmp[4096];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+
+    long written = ftell(f);
+    bool ok = written >= 0 && (uint64_t) written == image_size;
+    if (fclose(f) != 0) {
+        ok = false;
+    }
+    if (!ok) {
+        fprintf(stderr, "%s: failed to write snapshot\n", tmp);
+        unlink(tmp);
+        return -1;
+    }
+    if (rename(tmp, path) != 0) {
+        perror(path);
+        unlink(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * snapshot_open - 以 mmap 載入快照並檢查檔頭
+ * @snap:  載入結果
+ * @path:  快照路徑
+ * @magic: 預期的資料種類
+ *
+ * 成功回傳 0。格式不符、版本不同或檔案被截斷時回傳 -1。
+ */
+static inline int snapshot_open(snapshot_t *snap, const char *path, const char *magic)
+{
+    memset(snap, 0, sizeof(*snap));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror(path);
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(snapshot_header_t)) {
+        fprintf(stderr, "%s: not a snapshot\n", path);
+        close(fd);
+        return -1;
+    }
+    void *base = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // 映射建立後就不需要檔案描述子
+    close(fd);
+    if (base == MAP_FAILED) {
+        perror(path);
+        return -1;
+    }
+
+    const snapshot_header_t *header = base;
+    char want[SNAPSHOT_MAGIC_SIZE];
+    snapshot_set_magic(want, magic);
+    const char *error = NULL;
+    if (memcmp(header->magic, want, SNAPSHOT_MAGIC_SIZE) != 0) {
+        error = "unexpected snapshot type";
+    } else if (header->version != SNAPSHOT_VERSION) {
+        error = "unsupported snapshot version";
+    } else if (header->byte_order != SNAPSHOT_BYTE_ORDER) {
+        error = "snapshot written with a different byte order";
+    } else if (header->image_size != (uint64_t) st.st_size) {
+        error = "truncated snapshot";
+    }
+    if (error) {
+        fprintf(stderr, "%s: %s\n", path, error);
+        munmap(base, (size_t) st.st_size);
+        return -1;
+    }
+
+    snap->base = base;
+    snap->size = (size_t) st.st_size;
+    snap->header = header;
+    return 0;
+}
+
+static inline void snapshot_close(snapshot_t *snap)
+{
+    if (snap->base) {
+        munmap(snap->base, snap->size);
+    }
+    memset(snap, 0, sizeof(*snap));
+}
+
+#endif /* SNAPSHOT_H */
@@ -0,0 +1,284 @@
+#ifndef SORT_BENCH_H
+#define SORT_BENCH_H
+
+/*
+ * 鏈表排序的共用效能測試
+ *
+ * 各排序程式以 `--bench` 進入此模式：
+ *
+ *   ./sort --bench [--reps N] [--warmup N] [--max N] [--seed S] [--only NAME]
+ *                  [--counters]
+ *
+ * 對每個排序、每種輸入分布與每個大小，先跑 warmup 次不計入，再跑 reps 次，
+ * 以 CSV 輸出中位數、p99 與每個元素的 cycles。輸入只由 seed、分布與大小決定，
+ * 不同排序、不同程式、不同次建置都會拿到相同的資料，結果可以直接合併比較。
+ * 加上 --counters 時另外輸出每個元素的指令數與各種失誤次數（見 measure.h），
+ * 無法使用的計數器欄位留空。計數器被核心輪流排程時數值為放大後的估計值，
+ * 最後一欄 scaled_reps 記錄有幾次量測屬於這種情況，為 0 時才是完整計數。
+ *
+ * 使用前需先定義 element_t；鏈表操作來自 intrusive.h。
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+
+#include "intrusive.h"
+#include "measure.h"
+
+typedef struct {
+    const char *name;
+    void (*sort)(struct list_head *head);
+    int max_elements;  // O(n^2) 的排序用較小的上限
+} sort_bench_case_t;
+
+// O(n^2) 排序的建議上限；其他排序只受 --max 限制
+#define SORT_BENCH_QUADRATIC_LIMIT 3000
+#define SORT_BENCH_NO_LIMIT INT_MAX
+
+enum sort_bench_dist {
+    SORT_BENCH_RANDOM,
+    SORT_BENCH_SORTED,
+    SORT_BENCH_REVERSED,
+    SORT_BENCH_NEARLY_SORTED,  // 已排序後隨機交換 1% 的位置
+    SORT_BENCH_FEW_UNIQUE,     // 只有 16 種鍵值
+    SORT_BENCH_NUM_DISTS,
+};
+
+static const char *const sort_bench_dist_names[SORT_BENCH_NUM_DISTS] = {
+    "random", "sorted", "reversed", "nearly_sorted", "few_unique",
+};
+
+// 每個值固定 10 位數並補 0，atoi 與 strcmp 的順序相同，任何比較器都適用
+#define SORT_BENCH_VALUE_LEN 11
+
+// xorshift64*，不依賴 libc 的 rand() 實作，跨平台結果一致
+static inline uint64_t sort_bench_rand(uint64_t *state)
+{
+    uint64_t x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+// 依分布產生 n 個值，寫入 values[i * SORT_BENCH_VALUE_LEN]
+static inline void sort_bench_generate(char *values, int n, enum sort_bench_dist dist,
+                                uint64_t seed)
+{
+    uint64_t state = (seed ^ ((uint64_t) n * 0x9E3779B97F4A7C15ULL) ^
+                      ((uint64_t) dist << 56)) | 1;
+    int *keys = malloc((n + 1) * sizeof(int));
+    if (!keys) {
+        abort();
+    }
+
+    for (int i = 0; i < n; i++) {
+        switch (dist) {
+        case SORT_BENCH_RANDOM:
+            keys[i] = (int) (sort_bench_rand(&state) % 1000000000);
+            break;
+        case SORT_BENCH_SORTED:
+        case SORT_BENCH_NEARLY_SORTED:
+            keys[i] = i;
+            break;
+        case SORT_BENCH_REVERSED:
+            keys[i] = n - i;
+            break;
+        default:
+            keys[i] = (int) (sort_bench_rand(&state) % 16);
+            break;
+        }
+    }
+    if (dist == SORT_BENCH_NEARLY_SORTED) {
+        for (int s = 0; s < n / 100; s++) {
+            int a = (int) (sort_bench_rand(&state) % n);
+            int b = (int) (sort_bench_rand(&state) % n);
+            int tmp = keys[a];
+            keys[a] = keys[b];
+            keys[b] = tmp;
+        }
+    }
+    for (int i = 0; i < n; i++) {
+        snprintf(values + (size_t) i * SORT_BENCH_VALUE_LEN, SORT_BENCH_VALUE_LEN, "%010d",
+                 keys[i]);
+    }
+    free(keys);
+}
+
+// 以預先配置的節點重建隊列，不計入量測時間
+static inline void sort_bench_build(struct list_head *head, element_t *nodes, char *values, int n)
+{
+    struct list_head *prev = head;
+    for (int i = 0; i < n; i++) {
+        nodes[i].value = values + (size_t) i * SORT_BENCH_VALUE_LEN;
+        nodes[i].list.prev = prev;
+        prev->next = &nodes[i].list;
+        prev = &nodes[i].list;
+    }
+    prev->next = head;
+    head->prev = prev;
+}
+
+// 檢查結果已排序、節點數不變，且 prev 指標一致
+static inline bool sort_bench_verify(const struct list_head *head, int n)
+{
+    int count = 0;
+    const struct list_head *pos;
+    for (pos = head->next; pos != head; pos = pos->next, count++) {
+        if (count > n || pos->next->prev != pos) {
+            return false;
+        }
+        if (pos->next != head && strcmp(container_of(pos, element_t, list)->value,
+                                        container_of(pos->next, element_t, list)->value) > 0) {
+            return false;
+        }
+    }
+    return count == n;
+}
+
+static inline int sort_bench_cmp_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * sort_bench_main - 依命令列參數執行效能測試並輸出 CSV
+ * @argc:      main 的參數個數
+ * @argv:      main 的參數，argv[1] 為 --bench
+ * @cases:     要測試的排序
+ * @num_cases: 排序個數
+ *
+ * 大小依 1、3、10 的倍數由 100 增加到 --max；超過 max_elements 的組合略過。
+ * 每個組合只在第一次量測後檢查結果，排序錯誤時回傳 1。
+ */
+static inline int sort_bench_main(int argc, char *argv[], const sort_bench_case_t *cases,
+                           size_t num_cases)
+{
+    int reps = 11, warmup = 2, max_elements = 100000;
+    uint64_t seed = 1;
+    const char *only = NULL;
+    bool counters = false;
+
+    for (int i = 2; i < argc; i++) {
+        if (i + 1 < argc && strcmp(argv[i], "--reps") == 0) {
+            reps = atoi(argv[++i]);
+        } else if (i + 1 < argc && strcmp(argv[i], "--warmup") == 0) {
+            warmup = atoi(argv[++i]);
+        } else if (i + 1 < argc && strcmp(argv[i], "--max") == 0) {
+            max_elements = atoi(argv[++i]);
+        } else if (i + 1 < argc && strcmp(argv[i], "--seed") == 0) {
+            seed = strtoull(argv[++i], NULL, 0);
+        } else if (i + 1 < argc && strcmp(argv[i], "--only") == 0) {
+            only = argv[++i];
+        } else if (strcmp(argv[i], "--counters") == 0) {
+            counters = true;
+        } else {
+            fprintf(stderr,
+                    "usage: %s --bench [--reps N] [--warmup N] [--max N] [--seed S] "
+                    "[--only NAME] [--counters]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+    if (reps < 1 || warmup < 0 || max_elements < 1) {
+        fprintf(stderr, "invalid benchmark parameters\n");
+        return 1;
+    }
+
+    // samples[0] 為 cycles，samples[1 + i] 為第 i 個效能計數器
+    uint64_t *samples = malloc((size_t) reps * (1 + MEASURE_NUM_COUNTERS) * sizeof(uint64_t));
+    char *values = malloc((size_t) max_elements * SORT_BENCH_VALUE_LEN);
+    element_t *nodes = malloc((size_t) max_elements * sizeof(element_t));
+    if (!samples || !values || !nodes) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    measure_t m;
+    if (!measure_init(&m, counters) && counters) {
+        fprintf(stderr, "perf counters unavailable, reporting cycles only\n");
+    }
+
+    printf("sort,distribution,elements,seed,reps,median_cycles,p99_cycles,cycles_per_elem");
+    for (int i = 0; counters && i < MEASURE_NUM_COUNTERS; i++) {
+        printf(",%s_per_elem", measure_counter_names[i]);
+    }
+    printf(counters ? ",scaled_reps\n" : "\n");
+    int status = 0;
+    for (int base = 100; base <= max_elements && !status; base *= 10) {
+        const int steps[] = {base, base * 3};
+        for (int st = 0; st < 2 && steps[st] <= max_elements && !status; st++) {
+            int n = steps[st];
+            for (int d = 0; d < SORT_BENCH_NUM_DISTS && !status; d++) {
+                sort_bench_generate(values, n, d, seed);
+                for (size_t c = 0; c < num_cases && !status; c++) {
+                    if (n > cases[c].max_elements ||
+                        (only && strcmp(only, cases[c].name) != 0)) {
+                        continue;
+                    }
+                    struct list_head head;
+                    int scaled_reps = 0;
+                    for (int r = -warmup; r < reps; r++) {
+                        measure_sample_t sample;
+                        sort_bench_build(&head, nodes, values, n);
+                        measure_begin(&m, &sample);
+                        cases[c].sort(&head);
+                        measure_end(&m, &sample);
+                        if (r == -warmup && !sort_bench_verify(&head, n)) {
+                            fprintf(stderr, "%s: list is not sorted (%s, n=%d)\n",
+                                    cases[c].name, sort_bench_dist_names[d], n);
+                            status = 1;
+                            break;
+                        }
+                        if (r >= 0) {
+                            samples[r] = sample.cycles;
+                            bool scaled = false;
+                            for (int i = 0; i < MEASURE_NUM_COUNTERS; i++) {
+                                samples[(size_t) (1 + i) * reps + r] = sample.counters[i];
+                                scaled |= sample.scaled[i];
+                            }
+                            scaled_reps += scaled;
+                        }
+                    }
+                    if (status) {
+                        break;
+                    }
+                    qsort(samples, reps, sizeof(uint64_t), sort_bench_cmp_u64);
+                    uint64_t median = samples[reps / 2];
+                    uint64_t p99 = samples[(reps * 99 + 99) / 100 - 1];
+                    printf("%s,%s,%d,%llu,%d,%llu,%llu,%.2f", cases[c].name,
+                           sort_bench_dist_names[d], n, (unsigned long long) seed, reps,
+                           (unsigned long long) median, (unsigned long long) p99,
+                           (double) median / n);
+                    for (int i = 0; counters && i < MEASURE_NUM_COUNTERS; i++) {
+                        uint64_t *column = samples + (size_t) (1 + i) * reps;
+                        qsort(column, reps, sizeof(uint64_t), sort_bench_cmp_u64);
+                        if (measure_has(&m, i) && column[reps / 2] != MEASURE_UNAVAILABLE) {
+                            printf(",%.2f", (double) column[reps / 2] / n);
+                        } else {
+                            printf(",");
+                        }
+                    }
+                    if (counters) {
+                        printf(",%d", scaled_reps);
+                    }
+                    printf("\n");
+                    fflush(stdout);
+                }
+            }
+        }
+    }
+
+    measure_close(&m);
+    free(samples);
+    free(values);
+    free(nodes);
+    return status;
+}
+
+#endif /* SORT_BENCH_H */
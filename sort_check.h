@@ -0,0 +1,106 @@
+#ifndef SORT_CHECK_H
+#define SORT_CHECK_H
+
+/*
+ * 鏈表排序的共用正確性檢查：與 qsort 對照
+ *
+ * 以同一組資料分別交給待測排序與 qsort，逐一比較每個位置的值。
+ * 值相等即可，不檢查是否為同一個節點；穩定性由各程式自己的檢查負責。
+ *
+ * - 隨機輸入：rand() % range，range 小於元素數時一定有重複的鍵值。
+ * - SORT_CHECK_ASCENDING：第 i 個位置的值為 i，用來檢查已排序的輸入。
+ *
+ * 使用前需先定義 element_t；隊列與比較器來自 list_sort.h。
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "list_sort.h"
+
+#define SORT_CHECK_ASCENDING 0
+
+// 以比較器 cmp 產生對字串指標陣列排序的 qsort 比較函式 name
+#define DEFINE_QSORT_CMP(name, cmp)                          \
+    static int name(const void *a, const void *b)            \
+    {                                                        \
+        return cmp(*(char *const *) a, *(char *const *) b);  \
+    }
+
+DEFINE_QSORT_CMP(qsort_cmp_numeric, cmp_numeric)
+DEFINE_QSORT_CMP(qsort_cmp_string, cmp_string)
+DEFINE_QSORT_CMP(qsort_cmp_length_first, cmp_length_first)
+
+// 第 i 個輸入值；range 為 SORT_CHECK_ASCENDING 時為 i，否則為 rand() % range
+static inline void sort_check_value(char buf[12], int i, int range)
+{
+    sprintf(buf, "%d", range == SORT_CHECK_ASCENDING ? i : rand() % range);
+}
+
+/**
+ * sort_check_matches - 把 expected 以 qsort 排序後與 sorted 逐一比較
+ * @sorted:    待測排序的結果
+ * @expected:  同一組輸入的字串，會被重新排列
+ * @qsort_cmp: 對應比較器的 qsort 版本
+ * @cmp:       比較器本身（只用來判斷兩個值是否相等）
+ *
+ * 回傳 true 表示 sorted 恰有 num_elements 個節點，且每個位置的值都與 qsort 結果相等。
+ */
+static inline bool sort_check_matches(struct list_head *sorted, char **expected,
+                                      int num_elements,
+                                      int (*qsort_cmp)(const void *, const void *),
+                                      int (*cmp)(const char *, const char *))
+{
+    qsort(expected, num_elements, sizeof(char *), qsort_cmp);
+
+    int i = 0;
+    struct list_head *pos;
+    list_for_each(pos, sorted) {
+        if (i >= num_elements ||
+            cmp(list_entry(pos, element_t, list)->value, expected[i]) != 0) {
+            return false;
+        }
+        i++;
+    }
+    return i == num_elements;
+}
+
+/**
+ * check_against_qsort - 以同一組資料比對鏈表排序與 qsort 的結果
+ * @sort:      要檢查的鏈表排序
+ * @qsort_cmp: 對應比較器的 qsort 版本
+ * @cmp:       比較器本身（只用來判斷兩個值是否相等）
+ * @range:     輸入為 rand() % range，或 SORT_CHECK_ASCENDING
+ *
+ * 回傳 true 表示排序後每個位置的值都與 qsort 結果相等。
+ */
+static inline bool check_against_qsort(void (*sort)(struct list_head *),
+                                       int (*qsort_cmp)(const void *, const void *),
+                                       int (*cmp)(const char *, const char *),
+                                       int num_elements, int range)
+{
+    struct list_head *queue = q_new();
+    char **expected = malloc(num_elements * sizeof(char *));
+    bool ok = queue && expected;
+
+    // q_insert_head 插在頭端，由後往前產生，隊列中第 i 個就是第 i 個輸入值
+    for (int i = num_elements - 1; ok && i >= 0; i--) {
+        char value[12];
+        sort_check_value(value, i, range);
+        ok = q_insert_head(queue, value);
+        if (ok) {
+            expected[i] = list_entry(queue->next, element_t, list)->value;
+        }
+    }
+    if (ok) {
+        sort(queue);
+        ok = sort_check_matches(queue, expected, num_elements, qsort_cmp, cmp);
+    }
+
+    q_free(queue);
+    free(expected);
+    return ok;
+}
+
+#endif /* SORT_CHECK_H */
@@ -0,0 +1,537 @@
+// Build: gcc -O2 splay_tree.c -lm
+#include <assert.h>
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "intrusive.h"
+
+/*
+ * Splay-tree free index.
+ *
+ * Same block_t and the same insert_free_tree / remove_free_tree /
+ * find_free_tree API as BST.c, but every operation splays the node it
+ * touches to the root (top-down, Sleator & Tarjan). When a few sizes are
+ * requested over and over they stay within a couple of links of the root,
+ * while rbtree.c pays a full O(log n) descent for each of them.
+ *
+ * Blocks are ordered by (size, address) so that equal sizes can coexist
+ * and remove_free_tree always unlinks exactly the block it is given.
+ * find_free_tree only compares sizes and returns any block of that size.
+ */
+typedef struct block {
+    size_t size;
+    struct block *l, *r;
+} block_t;
+
+/* Order by size; when target is not NULL, break ties by address. */
+static inline int splay_cmp(size_t size, const block_t *target, const block_t *node) {
+    if (size != node->size)
+        return size < node->size ? -1 : 1;
+    if (!target || target == node)
+        return 0;
+    return (uintptr_t)target < (uintptr_t)node ? -1 : 1;
+}
+
+/*
+ * Nodes compared against a key, summed over both indexes' search loops so the
+ * benchmark can report how far each one walks per request.
+ */
+static unsigned long node_visits;
+
+/*
+ * Top-down splay: bring the node matching (size, target) to the root, or
+ * the last node on the search path when there is no match. Nodes left of
+ * the path are collected in a left tree, nodes right of it in a right
+ * tree, and both are hung under the new root at the end.
+ */
+static block_t *splay(block_t *t, size_t size, const block_t *target) {
+    block_t header = {0, NULL, NULL};
+    block_t *l = &header, *r = &header;
+
+    if (!t)
+        return NULL;
+    for (;;) {
+        int c = splay_cmp(size, target, t);
+        node_visits++;
+        if (c < 0) {
+            if (!t->l)
+                break;
+            node_visits++;
+            if (splay_cmp(size, target, t->l) < 0) {
+                /* zig-zig: rotate right */
+                block_t *y = t->l;
+                t->l = y->r;
+                y->r = t;
+                t = y;
+                if (!t->l)
+                    break;
+            }
+            /* link right */
+            r->l = t;
+            r = t;
+            t = t->l;
+        } else if (c > 0) {
+            if (!t->r)
+                break;
+            node_visits++;
+            if (splay_cmp(size, target, t->r) > 0) {
+                /* zag-zag: rotate left */
+                block_t *y = t->r;
+                t->r = y->l;
+                y->l = t;
+                t = y;
+                if (!t->r)
+                    break;
+            }
+            /* link left */
+            l->r = t;
+            l = t;
+            t = t->r;
+        } else {
+            break;
+        }
+    }
+    /* assemble */
+    l->r = t->l;
+    r->l = t->r;
+    t->l = header.r;
+    t->r = header.l;
+    return t;
+}
+
+/*
+ * Find a block of target->size. On a hit the block is splayed to the root
+ * and the returned pointer is root itself; NULL when no block matches.
+ */
+block_t **find_free_tree(block_t **root, block_t *target) {
+    if (!*root)
+        return NULL;
+    *root = splay(*root, target->size, NULL);
+    return (*root)->size == target->size ? root : NULL;
+}
+
+/* Splay target to the root and join its two subtrees. */
+void remove_free_tree(block_t **root, block_t *target) {
+    block_t *t = splay(*root, target->size, target);
+    assert(t == target);
+
+    if (!t->l) {
+        *root = t->r;
+    } else {
+        /* target is larger than everything on its left, so the splay leaves
+         * the left maximum at the root with an empty right subtree. */
+        block_t *x = splay(t->l, target->size, target);
+        x->r = t->r;
+        *root = x;
+    }
+
+    /* Clear the removed node's child pointers to avoid dangling references. */
+    target->l = NULL;
+    target->r = NULL;
+}
+
+/* Split the tree around node and make node the new root. */
+void insert_free_tree(block_t **root, block_t *node) {
+    if (!*root) {
+        node->l = node->r = NULL;
+        *root = node;
+        return;
+    }
+
+    block_t *t = splay(*root, node->size, node);
+    assert(t != node);
+    if (splay_cmp(node->size, node, t) < 0) {
+        node->l = t->l;
+        node->r = t;
+        t->l = NULL;
+    } else {
+        node->r = t->r;
+        node->l = t;
+        t->r = NULL;
+    }
+    *root = node;
+}
+
+/* Free every block in the tree without recursion; splay trees can be deep. */
+static void free_tree(block_t *root) {
+    while (root) {
+        if (root->l) {
+            block_t *y = root->l;
+            root->l = y->r;
+            y->r = root;
+            root = y;
+        } else {
+            block_t *next = root->r;
+            free(root);
+            root = next;
+        }
+    }
+}
+
+/*
+ * The rbtree.c free index, for comparison. rbtree.c is its own program, so
+ * the three operations the benchmark needs are repeated here on top of
+ * intrusive.h.
+ */
+typedef struct rb_block {
+    size_t size;
+    struct rb_node node;
+} rb_block_t;
+
+static void rb_free_insert(struct rb_root *root, rb_block_t *z) {
+    struct rb_node **link = &root->node, *parent = NULL;
+
+    while (*link) {
+        parent = *link;
+        node_visits++;
+        if (z->size < rb_entry(parent, rb_block_t, node)->size)
+            link = &parent->left;
+        else
+            link = &parent->right;
+    }
+    rb_link_node(&z->node, parent, link);
+    rb_insert_color(&z->node, root);
+}
+
+static rb_block_t *rb_free_find(struct rb_root *root, size_t size) {
+    struct rb_node *node = root->node;
+    while (node) {
+        rb_block_t *block = rb_entry(node, rb_block_t, node);
+        node_visits++;
+        if (block->size == size)
+            return block;
+        node = block->size > size ? node->left : node->right;
+    }
+    return NULL;
+}
+
+/* Small deterministic generator so both indexes see the same trace. */
+static inline uint64_t xorshift64(uint64_t *state) {
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return *state = x;
+}
+
+static inline double xorshift_unit(uint64_t *state) {
+    return (xorshift64(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/*
+ * Correctness check (--check): random inserts, removes and finds over a
+ * small size range, so duplicates are common, against a per-size count.
+ * After every operation the in-order walk must be sorted by
+ * (size, address) and hold exactly the expected blocks.
+ */
+static int check_tree(block_t *root, const int *count, int sizes, int total, block_t **stack) {
+    int depth = 0, seen = 0;
+    const block_t *prev = NULL;
+    int *walk = (int *)calloc(sizes, sizeof(int));
+    if (!walk)
+        return 0;
+
+    block_t *node = root;
+    while (node || depth) {
+        while (node) {
+            stack[depth++] = node;
+            node = node->l;
+        }
+        node = stack[--depth];
+        if (prev && splay_cmp(prev->size, prev, node) >= 0) {
+            free(walk);
+            return 0;
+        }
+        walk[node->size]++;
+        seen++;
+        prev = node;
+        node = node->r;
+    }
+    int ok = seen == total && memcmp(walk, count, sizes * sizeof(int)) == 0;
+    free(walk);
+    return ok;
+}
+
+static int splay_check(int sizes, int blocks, long ops, uint64_t seed) {
+    block_t **table = (block_t **)malloc(blocks * sizeof(block_t *));
+    block_t **stack = (block_t **)malloc(blocks * sizeof(block_t *));
+    char *in_tree = (char *)calloc(blocks, 1);
+    int *count = (int *)calloc(sizes, sizeof(int));
+    block_t *root = NULL;
+    int total = 0, ok = 1;
+
+    if (!table || !stack || !in_tree || !count) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < blocks; i++) {
+        table[i] = (block_t *)malloc(sizeof(block_t));
+        if (!table[i]) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+        table[i]->size = xorshift64(&seed) % sizes;
+        table[i]->l = table[i]->r = NULL;
+    }
+
+    for (long op = 0; op < ops && ok; op++) {
+        int i = xorshift64(&seed) % blocks;
+        block_t key = {xorshift64(&seed) % sizes, NULL, NULL};
+        block_t **found;
+
+        switch (xorshift64(&seed) % 3) {
+        case 0:
+            if (in_tree[i])
+                break;
+            insert_free_tree(&root, table[i]);
+            in_tree[i] = 1;
+            count[table[i]->size]++;
+            total++;
+            break;
+        case 1:
+            if (!in_tree[i])
+                break;
+            remove_free_tree(&root, table[i]);
+            in_tree[i] = 0;
+            count[table[i]->size]--;
+            total--;
+            ok = !table[i]->l && !table[i]->r;
+            break;
+        default:
+            found = find_free_tree(&root, &key);
+            ok = found ? count[key.size] > 0 && *found == root && root->size == key.size
+                       : count[key.size] == 0;
+            break;
+        }
+        if (ok)
+            ok = check_tree(root, count, sizes, total, stack);
+    }
+
+    for (int i = 0; i < blocks; i++)
+        if (!in_tree[i])
+            free(table[i]);
+    free_tree(root);
+    free(count);
+    free(in_tree);
+    free(stack);
+    free(table);
+    return ok;
+}
+
+/*
+ * Zipf benchmark (--bench): the index starts with one free block for each
+ * of SIZES distinct sizes. Sizes are ranked in random order and every
+ * request picks rank k with probability proportional to 1 / k^s. A request
+ * takes a block of that size out of the index, or carves a new one when
+ * none is free, and keeps it live; once LIVE blocks are live the oldest one
+ * is freed back into the index. Hot sizes therefore have several free
+ * blocks at a time and are looked up, removed and reinserted constantly.
+ * Both indexes replay the same trace and must carve the same number of
+ * blocks.
+ *
+ * The "nodes" columns count nodes compared per request in the search
+ * loops: every splay step, and the red-black descents in find and insert
+ * (rebalancing in rb_insert_color and rb_erase is not counted). Both sides
+ * pay the same counter increment, so the ns/op columns stay comparable.
+ */
+#define SIZES (1 << 16)
+#define LIVE 256
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Fill trace with sizes drawn from a Zipf(s) distribution; s = 0 is uniform. */
+static void zipf_trace(size_t *trace, long ops, double s, const size_t *rank_size,
+                       uint64_t seed) {
+    double *cdf = (double *)malloc(SIZES * sizeof(double));
+    if (!cdf) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    double sum = 0;
+    for (int k = 0; k < SIZES; k++) {
+        sum += 1.0 / pow(k + 1, s);
+        cdf[k] = sum;
+    }
+    for (long i = 0; i < ops; i++) {
+        double u = xorshift_unit(&seed) * sum;
+        int lo = 0, hi = SIZES - 1;
+        while (lo < hi) {
+            int mid = lo + (hi - lo) / 2;
+            if (cdf[mid] < u)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        trace[i] = rank_size[lo];
+    }
+    free(cdf);
+}
+
+static long bench_splay(const size_t *trace, long ops, double *seconds, double *visits) {
+    /* at most one block per size plus one per request */
+    block_t *blocks = (block_t *)malloc((SIZES + ops) * sizeof(block_t));
+    block_t *live[LIVE];
+    block_t *root = NULL;
+    long carved = SIZES;
+    int head = 0, used = 0;
+
+    if (!blocks) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    /* Insert in a scattered order so the starting shape is not a path. */
+    for (int i = 0; i < SIZES; i++) {
+        int j = (int)(((uint64_t)i * 2654435761u) % SIZES);
+        blocks[j].size = 16 * (size_t)(j + 1);
+        insert_free_tree(&root, &blocks[j]);
+    }
+
+    node_visits = 0;
+    double start = now_seconds();
+    for (long i = 0; i < ops; i++) {
+        block_t key = {trace[i], NULL, NULL};
+        block_t **found = find_free_tree(&root, &key);
+        block_t *b;
+        if (found) {
+            b = *found;
+            remove_free_tree(&root, b);
+        } else {
+            b = &blocks[carved++];
+            b->size = trace[i];
+        }
+        if (used == LIVE) {
+            insert_free_tree(&root, live[head]);
+            used--;
+        }
+        live[head] = b;
+        head = (head + 1) % LIVE;
+        used++;
+    }
+    *seconds = now_seconds() - start;
+    *visits = (double)node_visits / ops;
+    free(blocks);
+    return carved - SIZES;
+}
+
+static long bench_rbtree(const size_t *trace, long ops, double *seconds, double *visits) {
+    rb_block_t *blocks = (rb_block_t *)malloc((SIZES + ops) * sizeof(rb_block_t));
+    rb_block_t *live[LIVE];
+    struct rb_root root = RB_ROOT;
+    long carved = SIZES;
+    int head = 0, used = 0;
+
+    if (!blocks) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < SIZES; i++) {
+        int j = (int)(((uint64_t)i * 2654435761u) % SIZES);
+        blocks[j].size = 16 * (size_t)(j + 1);
+        rb_free_insert(&root, &blocks[j]);
+    }
+
+    node_visits = 0;
+    double start = now_seconds();
+    for (long i = 0; i < ops; i++) {
+        rb_block_t *b = rb_free_find(&root, trace[i]);
+        if (b) {
+            rb_erase(&b->node, &root);
+        } else {
+            b = &blocks[carved++];
+            b->size = trace[i];
+        }
+        if (used == LIVE) {
+            rb_free_insert(&root, live[head]);
+            used--;
+        }
+        live[head] = b;
+        head = (head + 1) % LIVE;
+        used++;
+    }
+    *seconds = now_seconds() - start;
+    *visits = (double)node_visits / ops;
+    free(blocks);
+    return carved - SIZES;
+}
+
+static int splay_bench(long ops) {
+    size_t *rank_size = (size_t *)malloc(SIZES * sizeof(size_t));
+    size_t *trace = (size_t *)malloc(ops * sizeof(size_t));
+    uint64_t seed = 0x9e3779b97f4a7c15ull;
+    const double skew[] = {0.0, 0.8, 1.0, 1.2, 1.5, 2.0, 3.0};
+
+    if (!rank_size || !trace) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return EXIT_FAILURE;
+    }
+    /* Hot sizes are spread over the whole range, not clustered at one end. */
+    for (int k = 0; k < SIZES; k++)
+        rank_size[k] = 16 * (size_t)(k + 1);
+    for (int k = SIZES - 1; k > 0; k--) {
+        int j = xorshift64(&seed) % (k + 1);
+        size_t tmp = rank_size[k];
+        rank_size[k] = rank_size[j];
+        rank_size[j] = tmp;
+    }
+
+    printf("%d sizes, %d live, %ld requests\n", SIZES, LIVE, ops);
+    printf("%-6s %10s %12s %12s %12s %12s %8s\n", "zipf s", "carved", "splay nodes",
+           "rbtree nodes", "splay ns/op", "rbtree ns/op", "speedup");
+    for (size_t i = 0; i < sizeof(skew) / sizeof(skew[0]); i++) {
+        double splay_s, rb_s, splay_visits, rb_visits;
+        zipf_trace(trace, ops, skew[i], rank_size, seed + i);
+        long splay_carved = bench_splay(trace, ops, &splay_s, &splay_visits);
+        long rb_carved = bench_rbtree(trace, ops, &rb_s, &rb_visits);
+        if (splay_carved != rb_carved) {
+            fprintf(stderr, "carved blocks differ: splay %ld, rbtree %ld\n", splay_carved,
+                    rb_carved);
+            return EXIT_FAILURE;
+        }
+        printf("%-6.1f %10ld %12.1f %12.1f %12.1f %12.1f %7.2fx\n", skew[i], splay_carved,
+               splay_visits, rb_visits, splay_s * 1e9 / ops, rb_s * 1e9 / ops, rb_s / splay_s);
+    }
+
+    free(trace);
+    free(rank_size);
+    return 0;
+}
+
+/*
+ * Default run: check the splay tree, then compare it with the red-black
+ * free index on Zipf traces. --check and --bench [requests] run one part.
+ */
+int main(int argc, char *argv[]) {
+    int check = 1, bench = 1;
+    long ops = 2000000;
+
+    if (argc > 1 && strcmp(argv[1], "--check") == 0) {
+        bench = 0;
+    } else if (argc > 1 && strcmp(argv[1], "--bench") == 0) {
+        check = 0;
+        if (argc > 2)
+            ops = atol(argv[2]);
+    }
+
+    if (check) {
+        const int sizes[] = {1, 4, 64, 1000};
+        for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+            if (!splay_check(sizes[i], 2000, 200000, 12345 + i)) {
+                fprintf(stderr, "splay tree check failed: %d sizes\n", sizes[i]);
+                return EXIT_FAILURE;
+            }
+        }
+        printf("splay tree checks passed\n");
+    }
+    if (bench && ops > 0)
+        return splay_bench(ops);
+    return 0;
+}
@@ -1,5 +1,21 @@
+// 編譯：gcc -O2 -pthread sqrt_asm.c -lm
+// （-lm 用於與 libm 比較與驗證的參考值，-pthread 用於 --verify）
+
 #include <stdio.h>
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "measure.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SQRT_HAVE_X86 1
+#endif
 
 
 uint32_t sqrt_fixed_q9_23(uint32_t x) {
@@ -43,7 +59,1373 @@ uint32_t sqrt_fixed_q9_23(uint32_t x) {
     return r0;
 }
 
-int main(void) {
+/*---------------------- 其他核心 ----------------------*/
+
+/*
+ * 與 sqrt_fixed_q9_23 相同介面的其他實作：輸入與輸出都是 Q9.23，
+ * 結果為 floor(sqrt(x << 23))。shift-add 版本只在約 [0.71, 4.0) 有效，
+ * 且可能與 floor 差 1；下面兩個版本對任何 32 位元輸入都是精確的 floor。
+ */
+
+/**
+ * sqrt_digit_q9_23 - 逐位元（digit-by-digit）試減求整數平方根
+ *
+ * 每輪決定結果的一個位元：試著減去 (R + bit)，夠減就保留這個位元，
+ * 不夠減就還原（不減）。從 X 最高的偶數位元開始，[1.0, 4.0) 需要 24 輪。
+ */
+uint32_t sqrt_digit_q9_23(uint32_t x) {
+    uint64_t rem = (uint64_t) x << 23;
+    uint64_t root = 0;
+    if (!rem) {
+        return 0;
+    }
+    uint64_t bit = 1ull << ((63 - __builtin_clzll(rem)) & ~1);
+
+    for (; bit; bit >>= 2) {
+        if (rem >= root + bit) {
+            rem -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+    }
+    return (uint32_t) root;
+}
+
+/*
+ * 牛頓法的步數與種子表大小：每一步約把相對精度的位元數加倍，
+ * 結果最多 28 位元，剩下的誤差由最後的修正迴圈逐一走完。
+ * - 兩步（預設）：8 位元索引（192 項，384 位元組），誤差在 ±1 內。
+ * - 一步：8 位元的種子一步後誤差可達三千多，改用 12 位元索引
+ *   （3072 項，6 KiB），誤差最多 13。
+ */
+#ifndef SQRT_NEWTON_STEPS
+#define SQRT_NEWTON_STEPS 2
+#endif
+
+#if SQRT_NEWTON_STEPS < 1
+#error SQRT_NEWTON_STEPS must be at least 1
+#elif SQRT_NEWTON_STEPS == 1
+#define SQRT_SEED_BITS 12
+#else
+#define SQRT_SEED_BITS 8
+#endif
+
+/*
+ * 編譯期產生的 1/sqrt 種子表
+ *
+ * 正規化後的輸入 m 在 [1, 4)，取最高 SQRT_SEED_BITS 個位元當索引
+ * （8 位元時為 64..255），表中存放該區間中點的 1/sqrt(m)，格式為 Q0.16。
+ * 平方根以巢狀的牛頓法巨集展開成浮點常數運算式，由編譯器在編譯時求值，
+ * 不需要執行期初始化。
+ */
+#define SQRT_CE_STEP(x, s) (0.5 * ((s) + (x) / (s)))
+#define SQRT_CE(x)                                                          \
+    SQRT_CE_STEP(x, SQRT_CE_STEP(x, SQRT_CE_STEP(x, SQRT_CE_STEP(x,         \
+        SQRT_CE_STEP(x, SQRT_CE_STEP(x, 0.5 * (1.0 + (x))))))))
+#define SQRT_SEED_BASE (1 << (SQRT_SEED_BITS - 2))
+#define SQRT_SEED(i) (uint16_t) (65536.0 / SQRT_CE(((i) + 0.5) / SQRT_SEED_BASE) + 0.5),
+#define SQRT_SEED4(i) SQRT_SEED(i) SQRT_SEED(i + 1) SQRT_SEED(i + 2) SQRT_SEED(i + 3)
+#define SQRT_SEED16(i) SQRT_SEED4(i) SQRT_SEED4(i + 4) SQRT_SEED4(i + 8) SQRT_SEED4(i + 12)
+#define SQRT_SEED64(i) \
+    SQRT_SEED16(i) SQRT_SEED16(i + 16) SQRT_SEED16(i + 32) SQRT_SEED16(i + 48)
+#define SQRT_SEED256(i) \
+    SQRT_SEED64(i) SQRT_SEED64(i + 64) SQRT_SEED64(i + 128) SQRT_SEED64(i + 192)
+#define SQRT_SEED1024(i) \
+    SQRT_SEED256(i) SQRT_SEED256(i + 256) SQRT_SEED256(i + 512) SQRT_SEED256(i + 768)
+
+static const uint16_t sqrt_rsqrt_seed[3 * SQRT_SEED_BASE] = {
+#if SQRT_SEED_BITS == 8
+    SQRT_SEED64(64) SQRT_SEED64(128) SQRT_SEED64(192)
+#else
+    SQRT_SEED1024(1024) SQRT_SEED1024(2048) SQRT_SEED1024(3072)
+#endif
+};
+
+/**
+ * sqrt_newton_q9_23 - 查表取 1/sqrt 種子，再以牛頓法修正
+ *
+ * 說明：
+ * - X = x << 23 以偶數位移正規化到 [1, 4) * 2^62，m 為其 Q2.30。
+ * - y <- y * (3 - m * y^2) / 2 收斂到 1/sqrt(m)，不需要除法。
+ * - sqrt(m) = m * y，再位移回原本的大小。
+ * - 剩下的誤差最後逐一修正，得到精確的 floor；兩步時最多修正一次。
+ */
+uint32_t sqrt_newton_q9_23(uint32_t x) {
+    if (!x) {
+        return 0;
+    }
+    uint64_t X = (uint64_t) x << 23;
+    int s = __builtin_clzll(X) & ~1;
+    uint64_t Y = X << s;
+    uint32_t m = (uint32_t) (Y >> 32);
+    uint32_t y = (uint32_t) sqrt_rsqrt_seed[(Y >> (64 - SQRT_SEED_BITS)) - SQRT_SEED_BASE]
+                 << 14;
+
+    for (int i = 0; i < SQRT_NEWTON_STEPS; i++) {
+        uint32_t t = (uint32_t) (((uint64_t) m * y) >> 30);  // m * y
+        uint32_t u = (uint32_t) (((uint64_t) t * y) >> 30);  // m * y^2，約為 1
+        y = (uint32_t) (((uint64_t) y * ((3u << 30) - u)) >> 31);
+    }
+
+    uint64_t r = ((uint64_t) m * y) >> 30;  // sqrt(m)，Q2.30
+    uint64_t R = (r << 1) >> (s / 2);
+    while (R * R > X) {
+        R--;
+    }
+    while ((R + 1) * (R + 1) <= X) {
+        R++;
+    }
+    return (uint32_t) R;
+}
+
+/*
+ * 編譯時選擇 sqrt_q9_23 使用的核心，例如
+ *   gcc -O2 -DSQRT_KERNEL=SQRT_KERNEL_NEWTON sqrt_asm.c -lm
+ * 軟體 sqrtf 經由 sqrt_q9_23 呼叫所選的核心。
+ */
+#define SQRT_KERNEL_SHIFT_ADD 0
+#define SQRT_KERNEL_NEWTON 1
+#define SQRT_KERNEL_DIGIT 2
+
+#ifndef SQRT_KERNEL
+#define SQRT_KERNEL SQRT_KERNEL_SHIFT_ADD
+#endif
+
+static inline uint32_t sqrt_q9_23(uint32_t x) {
+#if SQRT_KERNEL == SQRT_KERNEL_NEWTON
+    return sqrt_newton_q9_23(x);
+#elif SQRT_KERNEL == SQRT_KERNEL_DIGIT
+    return sqrt_digit_q9_23(x);
+#elif SQRT_KERNEL == SQRT_KERNEL_SHIFT_ADD
+    return sqrt_fixed_q9_23(x);
+#else
+#error Unknown SQRT_KERNEL
+#endif
+}
+
+/*---------------------- 通用 shift-add 平方根產生器 ----------------------*/
+
+/*
+ * sqrt_fixed_q9_23 的 << 7、>> 8 與 13 輪都來自 Q9.23 與 32 位元暫存器：
+ * - 前移使 r0 落在 [2^(BITS-2), 2^BITS)，迴圈把 r0 乘上 P^2 逼近 2^BITS，
+ *   r2 = r0 * P 最後約為 sqrt(r0) * 2^(BITS/2)。
+ * - 後移 (s + BITS - frac) / 2 位把結果換回 frac 位小數，s 為前移量。
+ * - 每輪 ε 約減半，最後的一階修正把誤差變成約 ε^2，
+ *   所以 steps 輪約有 2 * steps - 1 位元的相對精度；只需要 12 位元時 7 輪就夠。
+ *
+ * 以巨集在編譯時展開，格式、前後移量與輪數都是常數，與手寫的版本相同。
+ *
+ * DEFINE_SQRT_SHIFT_ADD(name, uint_t, frac, steps)
+ *   與 sqrt_fixed_q9_23 相同的形式：固定前移，只在 [1.0, 4.0) 有效，
+ *   frac 不可超過 BITS - 2。
+ * DEFINE_SQRT_SHIFT_ADD_ANY(name, uint_t, work_t, frac, steps)
+ *   以 clz 正規化，任何輸入都有效。work_t 可以比 uint_t 寬，
+ *   多出的位元吸收迴圈中的截斷誤差；後移量很小的格式（如 Q1.31）需要。
+ *
+ * 64 位元的暫存器在最後的乘法使用 unsigned __int128。64 位元且後移量很小的格式
+ * （如 Q1.63）沒有更寬的暫存器可用，誤差會到十幾個 ULP。
+ */
+
+#define SQRT_CLZ(x) (sizeof(x) == 8 ? __builtin_clzll(x) : __builtin_clz((uint32_t) (x)))
+#define SQRT_MULHI(a, b)                                                      \
+    (sizeof(a) == 8 ? (uint64_t) (((unsigned __int128) (a) * (b)) >> 64)     \
+                    : (uint32_t) (((uint64_t) (a) * (b)) >> 32))
+
+// 迴圈與最後的修正，r0 與 r2 為 uint_t 變數
+#define SQRT_SHIFT_ADD_LOOP(uint_t, r0, r2, steps)                           \
+    do {                                                                     \
+        for (int shift = 1; shift <= (steps); ++shift) {                     \
+            uint_t temp = r0 + (r0 >> shift);                                \
+            if (temp < r0) {                                                 \
+                continue;                                                    \
+            }                                                                \
+            uint_t temp2 = temp + (temp >> shift);                           \
+            if (temp2 < temp) {                                              \
+                continue;                                                    \
+            }                                                                \
+            r0 = temp2;                                                      \
+            r2 = r2 + (r2 >> shift);                                         \
+        }                                                                    \
+        uint_t neg = -r0;                                                    \
+        r2 = r2 + (SQRT_MULHI(neg, r2) >> 1);                                \
+    } while (0)
+
+#define DEFINE_SQRT_SHIFT_ADD(name, uint_t, frac, steps)                     \
+    static inline uint_t name(uint_t x) {                                    \
+        enum { BITS = sizeof(uint_t) * 8 };                                  \
+        _Static_assert((frac) <= BITS - 2, #name ": [1.0, 4.0) does not fit"); \
+        uint_t r0 = x << (BITS - 2 - (frac));                                \
+        uint_t r2 = r0;                                                      \
+        SQRT_SHIFT_ADD_LOOP(uint_t, r0, r2, steps);                          \
+        return r2 >> (BITS - 1 - (frac));                                    \
+    }
+
+#define DEFINE_SQRT_SHIFT_ADD_ANY(name, uint_t, work_t, frac, steps)         \
+    static inline uint_t name(uint_t x) {                                    \
+        enum { WORK = sizeof(work_t) * 8 };                                  \
+        if (!x) {                                                            \
+            return 0;                                                        \
+        }                                                                    \
+        /* s + WORK - frac 必須是偶數；最高位已是 1 時只能右移一位 */         \
+        int s = SQRT_CLZ((work_t) x);                                        \
+        s -= (s + WORK - (frac)) & 1;                                        \
+        work_t r0 = s < 0 ? (work_t) x >> 1 : (work_t) x << s;               \
+        work_t r2 = r0;                                                      \
+        SQRT_SHIFT_ADD_LOOP(work_t, r0, r2, steps);                          \
+        return (uint_t) (r2 >> ((s + WORK - (frac)) / 2));                   \
+    }
+
+// 與 sqrt_fixed_q9_23 逐位元相同
+DEFINE_SQRT_SHIFT_ADD(sqrt_q9_23_s13, uint32_t, 23, 13)
+DEFINE_SQRT_SHIFT_ADD(sqrt_q9_23_s7, uint32_t, 23, 7)
+DEFINE_SQRT_SHIFT_ADD(sqrt_q16_16_s13, uint32_t, 16, 13)
+DEFINE_SQRT_SHIFT_ADD_ANY(sqrt_q16_16_any, uint32_t, uint64_t, 16, 16)
+DEFINE_SQRT_SHIFT_ADD_ANY(sqrt_q16_16_any_s7, uint32_t, uint32_t, 16, 7)
+DEFINE_SQRT_SHIFT_ADD_ANY(sqrt_q1_31_any, uint32_t, uint64_t, 31, 16)
+DEFINE_SQRT_SHIFT_ADD(sqrt_q32_32_s26, uint64_t, 32, 26)
+DEFINE_SQRT_SHIFT_ADD_ANY(sqrt_q32_32_any, uint64_t, uint64_t, 32, 26)
+DEFINE_SQRT_SHIFT_ADD_ANY(sqrt_q1_63_any, uint64_t, uint64_t, 63, 32)
+
+/*---------------------- 批次版本（SIMD） ----------------------*/
+
+/*
+ * 與 sqrt_fixed_q9_23 相同的演算法，一次處理 4（SSE2）或 8（AVX2）個值：
+ * - 純量版的溢位 continue 改成遮罩：兩次加法都沒有溢位的 lane 才更新。
+ * - 無號比較 temp < r0 以「兩邊翻轉符號位元後做有號比較」實作。
+ * - umull 的高 32 位元以 mul_epu32 分別算偶數與奇數 lane 再合併。
+ * 對任何輸入都與純量版逐位元相同。
+ */
+
+#ifdef SQRT_HAVE_X86
+// 無號比較 a > b：兩邊翻轉符號位元後做有號比較
+static inline __m128i sqrt_cmpgt_epu32(__m128i a, __m128i b) {
+    const __m128i sign = _mm_set1_epi32((int) 0x80000000u);
+    return _mm_cmpgt_epi32(_mm_xor_si128(a, sign), _mm_xor_si128(b, sign));
+}
+
+static void sqrt_fixed_q9_23_sse2(const uint32_t *in, uint32_t *out, size_t n) {
+    const __m128i hi_mask = _mm_set1_epi64x((long long) 0xFFFFFFFF00000000ull);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i r0 = _mm_slli_epi32(_mm_loadu_si128((const __m128i *) (in + i)), 7);
+        __m128i r2 = r0;
+        for (int shift = 1; shift <= 13; ++shift) {
+            __m128i t1 = _mm_add_epi32(r0, _mm_srli_epi32(r0, shift));
+            __m128i t2 = _mm_add_epi32(t1, _mm_srli_epi32(t1, shift));
+            // 任一次加法溢位（t1 < r0 或 t2 < t1）的 lane 維持原值
+            __m128i ovf = _mm_or_si128(sqrt_cmpgt_epu32(r0, t1), sqrt_cmpgt_epu32(t1, t2));
+            __m128i r2n = _mm_add_epi32(r2, _mm_srli_epi32(r2, shift));
+            r0 = _mm_or_si128(_mm_and_si128(ovf, r0), _mm_andnot_si128(ovf, t2));
+            r2 = _mm_or_si128(_mm_and_si128(ovf, r2), _mm_andnot_si128(ovf, r2n));
+        }
+        // umull 的高 32 位元：偶數 lane 與奇數 lane 分開乘再合併
+        __m128i neg = _mm_sub_epi32(_mm_setzero_si128(), r0);
+        __m128i even = _mm_srli_epi64(_mm_mul_epu32(neg, r2), 32);
+        __m128i odd = _mm_mul_epu32(_mm_srli_epi64(neg, 32), _mm_srli_epi64(r2, 32));
+        __m128i r3 = _mm_or_si128(even, _mm_and_si128(odd, hi_mask));
+        r0 = _mm_srli_epi32(_mm_add_epi32(r2, _mm_srli_epi32(r3, 1)), 8);
+        _mm_storeu_si128((__m128i *) (out + i), r0);
+    }
+    for (; i < n; i++) {
+        out[i] = sqrt_fixed_q9_23(in[i]);
+    }
+}
+
+__attribute__((target("avx2")))
+static inline __m256i sqrt_cmpgt_epu32_avx2(__m256i a, __m256i b) {
+    const __m256i sign = _mm256_set1_epi32((int) 0x80000000u);
+    return _mm256_cmpgt_epi32(_mm256_xor_si256(a, sign), _mm256_xor_si256(b, sign));
+}
+
+// 與 SSE2 版本相同，一次 8 個 lane
+__attribute__((target("avx2")))
+static void sqrt_fixed_q9_23_avx2(const uint32_t *in, uint32_t *out, size_t n) {
+    const __m256i hi_mask = _mm256_set1_epi64x((long long) 0xFFFFFFFF00000000ull);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i r0 = _mm256_slli_epi32(_mm256_loadu_si256((const __m256i *) (in + i)), 7);
+        __m256i r2 = r0;
+        for (int shift = 1; shift <= 13; ++shift) {
+            __m256i t1 = _mm256_add_epi32(r0, _mm256_srli_epi32(r0, shift));
+            __m256i t2 = _mm256_add_epi32(t1, _mm256_srli_epi32(t1, shift));
+            __m256i ovf = _mm256_or_si256(sqrt_cmpgt_epu32_avx2(r0, t1),
+                                          sqrt_cmpgt_epu32_avx2(t1, t2));
+            __m256i r2n = _mm256_add_epi32(r2, _mm256_srli_epi32(r2, shift));
+            r0 = _mm256_blendv_epi8(t2, r0, ovf);
+            r2 = _mm256_blendv_epi8(r2n, r2, ovf);
+        }
+        __m256i neg = _mm256_sub_epi32(_mm256_setzero_si256(), r0);
+        __m256i even = _mm256_srli_epi64(_mm256_mul_epu32(neg, r2), 32);
+        __m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(neg, 32), _mm256_srli_epi64(r2, 32));
+        __m256i r3 = _mm256_or_si256(even, _mm256_and_si256(odd, hi_mask));
+        r0 = _mm256_srli_epi32(_mm256_add_epi32(r2, _mm256_srli_epi32(r3, 1)), 8);
+        _mm256_storeu_si256((__m256i *) (out + i), r0);
+    }
+    for (; i < n; i++) {
+        out[i] = sqrt_fixed_q9_23(in[i]);
+    }
+}
+#endif
+
+static void sqrt_fixed_q9_23_scalar(const uint32_t *in, uint32_t *out, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        out[i] = sqrt_fixed_q9_23(in[i]);
+    }
+}
+
+/**
+ * sqrt_fixed_q9_23_batch - 對 in[0 .. n) 逐一求 sqrt_fixed_q9_23，寫入 out
+ *
+ * 依執行時的 CPU 選擇 AVX2、SSE2 或純量版本，結果完全相同。
+ * in 與 out 可以是同一個陣列。
+ */
+void sqrt_fixed_q9_23_batch(const uint32_t *in, uint32_t *out, size_t n) {
+#ifdef SQRT_HAVE_X86
+    if (__builtin_cpu_supports("avx2")) {
+        sqrt_fixed_q9_23_avx2(in, out, n);
+        return;
+    }
+    sqrt_fixed_q9_23_sse2(in, out, n);
+#else
+    sqrt_fixed_q9_23_scalar(in, out, n);
+#endif
+}
+
+/*---------------------- 批次版本測試 ----------------------*/
+
+typedef struct {
+    const char *name;
+    void (*fn)(const uint32_t *in, uint32_t *out, size_t n);
+} sqrt_batch_impl_t;
+
+static const sqrt_batch_impl_t sqrt_batch_impls[] = {
+    {"scalar", sqrt_fixed_q9_23_scalar},
+#ifdef SQRT_HAVE_X86
+    {"sse2", sqrt_fixed_q9_23_sse2},
+    {"avx2", sqrt_fixed_q9_23_avx2},
+#endif
+};
+
+#define SQRT_NUM_BATCH_IMPLS (sizeof(sqrt_batch_impls) / sizeof(sqrt_batch_impls[0]))
+
+static int sqrt_batch_available(const sqrt_batch_impl_t *impl) {
+#ifdef SQRT_HAVE_X86
+    if (impl->fn == sqrt_fixed_q9_23_avx2) {
+        return __builtin_cpu_supports("avx2");
+    }
+#endif
+    (void) impl;
+    return 1;
+}
+
+/*
+ * 檢查每個 SIMD 版本在整個有效輸入範圍 [0, 4.0)（x < 2^25）都與純量版相同，
+ * 再量測每個 cycle 能處理幾個值。
+ */
+static int sqrt_batch_main(void) {
+    enum { CHUNK = 4096, BENCH_REPS = 2000 };
+    static uint32_t in[CHUNK], expect[CHUNK], got[CHUNK];
+
+    for (uint32_t base = 0; base < (1u << 25); base += CHUNK) {
+        for (uint32_t j = 0; j < CHUNK; j++) {
+            in[j] = base + j;
+        }
+        sqrt_fixed_q9_23_scalar(in, expect, CHUNK);
+        for (size_t k = 1; k < SQRT_NUM_BATCH_IMPLS; k++) {
+            if (!sqrt_batch_available(&sqrt_batch_impls[k])) {
+                continue;
+            }
+            // 長度輪流減去 0..7，也涵蓋尾端的純量處理
+            size_t len = CHUNK - ((base / CHUNK) & 7);
+            sqrt_batch_impls[k].fn(in, got, len);
+            if (memcmp(expect, got, len * sizeof(uint32_t)) != 0) {
+                fprintf(stderr, "%s differs from scalar near %u\n",
+                        sqrt_batch_impls[k].name, base);
+                return 1;
+            }
+        }
+    }
+    printf("batch kernels bit-identical to scalar for all x < 2^25\n");
+
+    // 量測用的輸入取 [1.0, 4.0) 之間的隨機值
+    uint32_t seed = 2463534242u;
+    for (int j = 0; j < CHUNK; j++) {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        in[j] = (1u << 23) + seed % (3u << 23);
+    }
+    printf("%-8s %14s %14s\n", "kernel", "cycles/value", "values/cycle");
+    for (size_t k = 0; k < SQRT_NUM_BATCH_IMPLS; k++) {
+        if (!sqrt_batch_available(&sqrt_batch_impls[k])) {
+            printf("%-8s %14s %14s\n", sqrt_batch_impls[k].name, "unsupported", "-");
+            continue;
+        }
+        sqrt_batch_impls[k].fn(in, got, CHUNK);  // 暖機
+        uint64_t cycles = measure_cycles_begin();
+        for (int r = 0; r < BENCH_REPS; r++) {
+            sqrt_batch_impls[k].fn(in, got, CHUNK);
+            __asm__ volatile("" ::"r"(got) : "memory");
+        }
+        cycles = measure_cycles_end() - cycles;
+        double values = (double) CHUNK * BENCH_REPS;
+        printf("%-8s %14.2f %14.3f\n", sqrt_batch_impls[k].name, cycles / values,
+               values / cycles);
+    }
+    return 0;
+}
+
+/*---------------------- 軟體 sqrtf ----------------------*/
+
+/**
+ * sqrt_q9_23_rounded - 求 sqrt(m)，並四捨五入到最近的 Q9.23
+ * @m: Q9.23 的 [1.0, 4.0)，即 [1 << 23, 4 << 23)
+ *
+ * 使用 sqrt_q9_23 所選的核心。shift-add 核心的結果與 floor(sqrt(m << 23))
+ * 最多差 1，先以餘數
+ * residual = (m << 23) - r^2 校正成 floor，再沿用 main 的判斷：
+ * residual > r 代表真值超過 r + 0.5，進位。平方根不會剛好落在兩個
+ * 可表示值的正中間，因此不需要處理平手。
+ */
+static inline uint32_t sqrt_q9_23_rounded(uint32_t m) {
+    uint32_t r = sqrt_q9_23(m);
+    int64_t residual = ((int64_t) m << 23) - (int64_t) r * r;
+
+    if (residual < 0) {
+        r--;
+        residual += 2 * (int64_t) r + 1;
+    } else if (residual > 2 * (int64_t) r) {
+        residual -= 2 * (int64_t) r + 1;
+        r++;
+    }
+    if (residual > r) {
+        r++;
+    }
+    return r;
+}
+
+/**
+ * sqrtf_soft_bits - 只用整數運算的 IEEE 754 單精度平方根
+ * @bits: 輸入的位元表示
+ *
+ * 說明：
+ * - NaN 轉為 quiet NaN 傳回；+-0 與 +inf 原樣傳回；其他負數傳回預設 NaN。
+ * - 次正規數先左移到最高位元為 1，並調整指數。
+ * - 指數為奇數時尾數乘 2，讓尾數落在 [1, 4)、指數為偶數，
+ *   結果的指數即為一半，尾數交給 sqrt_q9_23_rounded。
+ * - 結果以最近值捨入（round to nearest），與硬體 sqrtss 相同。
+ */
+uint32_t sqrtf_soft_bits(uint32_t bits) {
+    uint32_t sign = bits >> 31;
+    int32_t exp = (bits >> 23) & 0xFF;
+    uint32_t frac = bits & 0x7FFFFF;
+
+    if (exp == 0xFF) {
+        if (frac) {
+            return bits | 0x400000;  // NaN：保留 payload，設為 quiet
+        }
+        return sign ? 0x7FC00000 : bits;  // -inf 為無效運算，+inf 原樣傳回
+    }
+    if (exp == 0 && frac == 0) {
+        return bits;  // +0 與 -0
+    }
+    if (sign) {
+        return 0x7FC00000;
+    }
+
+    if (exp == 0) {
+        // 次正規數：正規化到隱含位元的位置
+        int shift = __builtin_clz(frac) - 8;
+        frac <<= shift;
+        exp = 1 - shift;
+    }
+    int32_t e = exp - 127;
+    uint32_t m = (frac & 0x7FFFFF) | 0x800000;  // Q9.23 的 [1, 2)
+    if (e & 1) {
+        m <<= 1;  // [2, 4)
+        e -= 1;
+    }
+
+    uint32_t r = sqrt_q9_23_rounded(m);  // [1, 2)
+    if (r == 1u << 24) {
+        r >>= 1;  // 捨入進位到 2.0
+        e += 2;
+    }
+    return ((uint32_t) (e / 2 + 127) << 23) | (r & 0x7FFFFF);
+}
+
+float sqrtf_soft(float x) {
+    uint32_t bits;
+    memcpy(&bits, &x, sizeof(bits));
+    bits = sqrtf_soft_bits(bits);
+    memcpy(&x, &bits, sizeof(bits));
+    return x;
+}
+
+static inline uint32_t float_bits(float f) {
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+    return bits;
+}
+
+static inline float bits_float(uint32_t bits) {
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+// 以 libm 的結果比對；NaN 只要求兩邊都是 NaN
+static int sqrtf_soft_matches(uint32_t bits) {
+    uint32_t got = sqrtf_soft_bits(bits);
+    float ref = sqrtf(bits_float(bits));
+    if (isnan(ref)) {
+        return isnan(bits_float(got));
+    }
+    return got == float_bits(ref);
+}
+
+/*
+ * 正確性：結果只由尾數與指數奇偶決定，所以檢查兩種奇偶的所有尾數、
+ * 所有正的次正規數、特殊值，以及各種指數的隨機值。接著與 libm 比較速度。
+ */
+static int sqrtf_soft_main(void) {
+    for (uint32_t frac = 0; frac < (1u << 23); frac++) {
+        // 指數 127（偶）與 128（奇），以及次正規數
+        uint32_t inputs[] = {(127u << 23) | frac, (128u << 23) | frac, frac};
+        for (int k = 0; k < 3; k++) {
+            if (!sqrtf_soft_matches(inputs[k])) {
+                fprintf(stderr, "sqrtf_soft mismatch for 0x%08x\n", inputs[k]);
+                return 1;
+            }
+        }
+    }
+    const uint32_t specials[] = {
+        0x00000000, 0x80000000, 0x7F800000, 0xFF800000, 0x7FC00000, 0x7F800001,
+        0xFFC00000, 0xBF800000, 0x80000001, 0x00000001, 0x007FFFFF, 0x00800000,
+        0x7F7FFFFF, 0x3F800000,
+    };
+    for (size_t k = 0; k < sizeof(specials) / sizeof(specials[0]); k++) {
+        if (!sqrtf_soft_matches(specials[k])) {
+            fprintf(stderr, "sqrtf_soft mismatch for 0x%08x\n", specials[k]);
+            return 1;
+        }
+    }
+    uint32_t seed = 2463534242u;
+    for (int k = 0; k < (1 << 22); k++) {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        if (!sqrtf_soft_matches(seed)) {
+            fprintf(stderr, "sqrtf_soft mismatch for 0x%08x\n", seed);
+            return 1;
+        }
+    }
+    printf("sqrtf_soft matches libm sqrtf\n");
+
+    enum { N = 4096, REPS = 500 };
+    static float in[N], out[N];
+    for (int j = 0; j < N; j++) {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        in[j] = bits_float(seed & 0x7F7FFFFF);  // 正的有限值
+    }
+    // 經過函式指標呼叫，避免編譯器把 libm sqrtf 內嵌成 sqrtss 後向量化
+    float (*volatile fns[2])(float) = {sqrtf_soft, sqrtf};
+    const char *names[2] = {"sqrtf_soft", "libm sqrtf"};
+    printf("%-12s %14s\n", "function", "cycles/value");
+    for (int f = 0; f < 2; f++) {
+        float (*fn)(float) = fns[f];
+        uint64_t cycles = measure_cycles_begin();
+        for (int r = 0; r < REPS; r++) {
+            for (int j = 0; j < N; j++) {
+                out[j] = fn(in[j]);
+            }
+            __asm__ volatile("" ::"r"(out) : "memory");
+        }
+        cycles = measure_cycles_end() - cycles;
+        printf("%-12s %14.2f\n", names[f], (double) cycles / ((double) N * REPS));
+    }
+    return 0;
+}
+
+/*---------------------- 核心比較 ----------------------*/
+
+typedef struct {
+    const char *name;
+    uint32_t (*fn)(uint32_t x);
+} sqrt_kernel_t;
+
+static const sqrt_kernel_t sqrt_kernels[] = {
+    {"shift_add", sqrt_fixed_q9_23},
+    {"newton", sqrt_newton_q9_23},
+    {"digit", sqrt_digit_q9_23},
+};
+
+#define SQRT_NUM_KERNELS (sizeof(sqrt_kernels) / sizeof(sqrt_kernels[0]))
+
+/*
+ * 對每個核心：
+ * - 在 [1.0, 4.0) 的每個輸入與精確的 floor（逐位元版本）比較，列出最大誤差。
+ * - 延遲：下一個輸入取決於上一個結果，量測一連串相依呼叫。
+ * - 吞吐量：彼此獨立的輸入陣列。
+ */
+static int sqrt_kernels_main(void) {
+    enum { N = 4096, REPS = 500, CHAIN = 1 << 20 };
+    static uint32_t in[N], out[N];
+    const char *selected = sqrt_kernels[SQRT_KERNEL].name;
+
+    printf("sqrt_q9_23 uses %s (SQRT_KERNEL=%d), newton steps %d\n", selected,
+           SQRT_KERNEL, SQRT_NEWTON_STEPS);
+    uint32_t seed = 2463534242u;
+    for (int j = 0; j < N; j++) {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        in[j] = (1u << 23) + seed % (3u << 23);
+    }
+
+    printf("%-10s %10s %10s %16s %16s\n", "kernel", "max_below", "max_above",
+           "latency(cyc)", "cycles/value");
+    for (size_t k = 0; k < SQRT_NUM_KERNELS; k++) {
+        uint32_t (*fn)(uint32_t) = sqrt_kernels[k].fn;
+        int64_t below = 0, above = 0;
+        for (uint32_t x = 1u << 23; x < (4u << 23); x++) {
+            int64_t d = (int64_t) fn(x) - sqrt_digit_q9_23(x);
+            if (d < below) {
+                below = d;
+            }
+            if (d > above) {
+                above = d;
+            }
+        }
+
+        // 結果在 [1, 2)，加上 1.0 後仍在 [1, 4) 內
+        uint32_t x = 3u << 22;
+        uint64_t cycles = measure_cycles_begin();
+        for (int j = 0; j < CHAIN; j++) {
+            x = fn(x) + (1u << 23);
+        }
+        cycles = measure_cycles_end() - cycles;
+        double latency = (double) cycles / CHAIN;
+        __asm__ volatile("" ::"r"(x));
+
+        cycles = measure_cycles_begin();
+        for (int r = 0; r < REPS; r++) {
+            for (int j = 0; j < N; j++) {
+                out[j] = fn(in[j]);
+            }
+            __asm__ volatile("" ::"r"(out) : "memory");
+        }
+        cycles = measure_cycles_end() - cycles;
+        printf("%-10s %10lld %10lld %16.2f %16.2f\n", sqrt_kernels[k].name,
+               (long long) below, (long long) above, latency,
+               (double) cycles / ((double) N * REPS));
+    }
+    return 0;
+}
+
+/*---------------------- 全面驗證 ----------------------*/
+
+/*
+ * 對每個核心掃過整個定義域，與正確捨入的參考值
+ * round(sqrt(x << 23)) 比較，以 Q9.23 的最小單位（ULP）計算誤差。
+ * - 參考值以 double 的 sqrt 估計，再用整數餘數校正成 floor 並捨入，
+ *   不受 double 只有 53 位元影響。
+ * - rounded 的版本把核心結果以相同的餘數方式修正並捨入，誤差必須為 0；
+ *   其他版本直接回傳 floor 附近的值，容許 1 ULP。
+ * - 輸入切成固定大小的區塊，由所有 CPU 核心以原子計數器輪流領取。
+ */
+
+typedef struct {
+    const char *name;
+    uint32_t (*fn)(uint32_t x);
+    int rounded;
+    uint64_t lo, hi;       // 預設掃描範圍 [lo, hi)：[1.0, 4.0)
+    uint64_t full_hi;      // --full 時掃描 [0, full_hi)
+} sqrt_verify_target_t;
+
+static const sqrt_verify_target_t sqrt_verify_targets[] = {
+    // shift-add 在約 0.71 以下或 x << 7 溢位時沒有意義，只驗證 [1.0, 4.0)
+    {"shift_add", sqrt_fixed_q9_23, 0, 1u << 23, 4u << 23, 4u << 23},
+    {"shift_add+round", sqrt_fixed_q9_23, 1, 1u << 23, 4u << 23, 4u << 23},
+    {"newton", sqrt_newton_q9_23, 0, 1u << 23, 4u << 23, 1ull << 32},
+    {"newton+round", sqrt_newton_q9_23, 1, 1u << 23, 4u << 23, 1ull << 32},
+    {"digit", sqrt_digit_q9_23, 0, 1u << 23, 4u << 23, 1ull << 32},
+    {"digit+round", sqrt_digit_q9_23, 1, 1u << 23, 4u << 23, 1ull << 32},
+};
+
+#define SQRT_VERIFY_CHUNK (1u << 16)
+#define SQRT_VERIFY_MAX_THREADS 256
+#define SQRT_VERIFY_MAX_FAILURES 8
+// 誤差直方圖：-3 .. +3 ULP，兩端另計超出範圍的數量
+#define SQRT_VERIFY_HIST 7
+
+// 把 r 校正成 floor(sqrt(X))，回傳 X - r^2
+static inline uint64_t sqrt_floor_fix(uint64_t X, uint64_t *r) {
+    while (*r * *r > X) {
+        (*r)--;
+    }
+    while ((*r + 1) * (*r + 1) <= X) {
+        (*r)++;
+    }
+    return X - *r * *r;
+}
+
+// 正確捨入的參考值
+static inline uint64_t sqrt_reference_q9_23(uint32_t x) {
+    uint64_t X = (uint64_t) x << 23;
+    uint64_t r = (uint64_t) sqrt((double) X);
+    uint64_t residual = sqrt_floor_fix(X, &r);
+    return r + (residual > r);
+}
+
+typedef struct {
+    const sqrt_verify_target_t *target;
+    uint64_t lo, hi;
+    uint64_t next;  // 下一個尚未領取的區塊起點，以原子操作更新
+    pthread_mutex_t lock;
+    uint64_t hist[SQRT_VERIFY_HIST + 2];
+    int64_t max_ulp;
+    uint64_t failures;
+    uint32_t failing[SQRT_VERIFY_MAX_FAILURES];
+} sqrt_verify_job_t;
+
+static void *sqrt_verify_worker(void *arg) {
+    sqrt_verify_job_t *job = arg;
+    const sqrt_verify_target_t *t = job->target;
+    uint64_t hist[SQRT_VERIFY_HIST + 2] = {0};
+    int64_t max_ulp = 0;
+    uint64_t failures = 0;
+    uint32_t failing[SQRT_VERIFY_MAX_FAILURES];
+    int tolerance = t->rounded ? 0 : 1;
+
+    for (;;) {
+        uint64_t start = __atomic_fetch_add(&job->next, SQRT_VERIFY_CHUNK, __ATOMIC_RELAXED);
+        if (start >= job->hi) {
+            break;
+        }
+        uint64_t end = start + SQRT_VERIFY_CHUNK < job->hi ? start + SQRT_VERIFY_CHUNK : job->hi;
+        for (uint64_t i = start; i < end; i++) {
+            uint32_t x = (uint32_t) i;
+            uint64_t r = t->fn(x);
+            if (t->rounded) {
+                uint64_t residual = sqrt_floor_fix((uint64_t) x << 23, &r);
+                r += residual > r;
+            }
+            int64_t err = (int64_t) r - (int64_t) sqrt_reference_q9_23(x);
+            int64_t abs_err = err < 0 ? -err : err;
+            if (abs_err > max_ulp) {
+                max_ulp = abs_err;
+            }
+            if (err < -3) {
+                hist[0]++;
+            } else if (err > 3) {
+                hist[SQRT_VERIFY_HIST + 1]++;
+            } else {
+                hist[err + 4]++;
+            }
+            if (abs_err > tolerance) {
+                if (failures < SQRT_VERIFY_MAX_FAILURES) {
+                    failing[failures] = x;
+                }
+                failures++;
+            }
+        }
+    }
+
+    pthread_mutex_lock(&job->lock);
+    for (int b = 0; b < SQRT_VERIFY_HIST + 2; b++) {
+        job->hist[b] += hist[b];
+    }
+    if (max_ulp > job->max_ulp) {
+        job->max_ulp = max_ulp;
+    }
+    for (uint64_t f = 0; f < failures && f < SQRT_VERIFY_MAX_FAILURES; f++) {
+        if (job->failures + f < SQRT_VERIFY_MAX_FAILURES) {
+            job->failing[job->failures + f] = failing[f];
+        }
+    }
+    job->failures += failures;
+    pthread_mutex_unlock(&job->lock);
+    return NULL;
+}
+
+static double sqrt_wall_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * sqrt_verify_main - 驗證所有核心
+ * @full: 為 1 時掃描每個核心的完整定義域，否則只掃 [1.0, 4.0)
+ * @only: 不為 NULL 時只驗證名稱相同的核心
+ *
+ * 有任何超出容許誤差的輸入時回傳 1。
+ */
+static int sqrt_verify_main(int full, const char *only) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int num_threads = cpus < 1 ? 1 : cpus > SQRT_VERIFY_MAX_THREADS ? SQRT_VERIFY_MAX_THREADS
+                                                                    : (int) cpus;
+    pthread_t threads[SQRT_VERIFY_MAX_THREADS];
+    int status = 0;
+
+    printf("verifying with %d threads against round(sqrt(x << 23))\n", num_threads);
+    for (size_t k = 0; k < sizeof(sqrt_verify_targets) / sizeof(sqrt_verify_targets[0]); k++) {
+        const sqrt_verify_target_t *t = &sqrt_verify_targets[k];
+        if (only && strcmp(only, t->name) != 0) {
+            continue;
+        }
+        static sqrt_verify_job_t job;
+        memset(&job, 0, sizeof(job));
+        job.target = t;
+        job.lo = full ? 0 : t->lo;
+        job.hi = full ? t->full_hi : t->hi;
+        job.next = job.lo;
+        pthread_mutex_init(&job.lock, NULL);
+
+        double start = sqrt_wall_seconds();
+        int started = 0;
+        for (; started < num_threads; started++) {
+            if (pthread_create(&threads[started], NULL, sqrt_verify_worker, &job) != 0) {
+                break;
+            }
+        }
+        if (started == 0) {
+            sqrt_verify_worker(&job);
+        }
+        for (int i = 0; i < started; i++) {
+            pthread_join(threads[i], NULL);
+        }
+        double seconds = sqrt_wall_seconds() - start;
+        pthread_mutex_destroy(&job.lock);
+
+        uint64_t count = job.hi - job.lo;
+        printf("%-16s [0x%09llx, 0x%09llx) %.2fs, %.1f Minputs/s, max %lld ulp, "
+               "%llu failing\n",
+               t->name, (unsigned long long) job.lo, (unsigned long long) job.hi, seconds,
+               count / seconds / 1e6, (long long) job.max_ulp,
+               (unsigned long long) job.failures);
+        printf("  histogram:");
+        printf(" <-3:%llu", (unsigned long long) job.hist[0]);
+        for (int b = 1; b <= SQRT_VERIFY_HIST; b++) {
+            if (job.hist[b]) {
+                printf(" %+d:%llu", b - 4, (unsigned long long) job.hist[b]);
+            }
+        }
+        printf(" >3:%llu\n", (unsigned long long) job.hist[SQRT_VERIFY_HIST + 1]);
+        for (uint64_t f = 0; f < job.failures && f < SQRT_VERIFY_MAX_FAILURES; f++) {
+            uint32_t x = job.failing[f];
+            printf("  fail: x=0x%08x got %u expected %llu\n", x, t->fn(x),
+                   (unsigned long long) sqrt_reference_q9_23(x));
+        }
+        status |= job.failures != 0;
+    }
+    return status;
+}
+
+/*---------------------- shift-add 數學函式 ----------------------*/
+
+/*
+ * sqrt_fixed_q9_23 的 shift-add 手法（乘上 1 + 2^-k，以 carry 判斷是否超過上限）
+ * 可以推廣到其他函式。每個函式都分成三步：
+ * 1. 以 clz 把輸入正規化到 64 位元暫存器的最高位。
+ * 2. 逐一嘗試乘上 (1 + 2^-k)：若不會產生 carry 就接受，
+ *    同時在另一個暫存器累積乘積（或 log2(1 + 2^-k) 的總和）。
+ *    接受與否以遮罩選擇而不是分支，每一步的結果難以預測，分支會一直預測失誤。
+ * 3. 剩下的差距 ε 小於 2^-SHIFT_ADD_STEPS，用一次乘法做一階修正，
+ *    誤差降到約 ε^2，與 sqrt_fixed_q9_23 最後的 umull 相同。
+ *
+ * 輸出可能用到全部 32 位元（例如 Q9.23 的 exp2(8.9)），所以中間值放在 64 位元，
+ * 修正用的乘法只取兩邊的高位，仍是 32x32→64。
+ * 所有函式只用整數運算，最後的縮放四捨五入到最接近的值，超出範圍時飽和。
+ * 下面以小數位元數 frac 寫成通用版本，Q9.23 與 Q16.16 各有一組公開的函式：
+ * - recip：1/x，x = 0 或結果超出範圍時回傳 UINT32_MAX。
+ * - rsqrt：1/sqrt(x)，同上。
+ * - log2：輸入無號，輸出有號（Q8.23 或 Q15.16），x = 0 時回傳 INT32_MIN。
+ * - exp2：輸入有號，輸出無號；結果超出範圍時回傳 UINT32_MAX。
+ */
+
+#define SHIFT_ADD_STEPS 20
+
+// round(2^62 * log2(1 + 2^-k))，k = 1 .. SHIFT_ADD_STEPS
+static const uint64_t shift_add_log2_table[SHIFT_ADD_STEPS] = {
+    0x2570068e7ef5a1e8ull, 0x149a784bcd1b8afeull, 0x0ae00d1cfdeb43d0ull,
+    0x0598fdbeb244c59full, 0x02d75a6eb1dfb0e6ull, 0x016e79685c2d2299ull,
+    0x00b7f285b778428cull, 0x005c2711b5eab1ddull, 0x002e1f07fe14eacaull,
+    0x001712653743f454ull, 0x000b89eb17bcabe2ull, 0x0005c523b0a86ff2ull,
+    0x0002e29d623f4a6cull, 0x0001715193b17d36ull, 0x0000b8a982801725ull,
+    0x00005c54ef6a3e09ull, 0x00002e2a833fb72cull, 0x0000171544828311ull,
+    0x00000b8aa2f9eb96ull, 0x000005c551ab2054ull,
+};
+
+#define SHIFT_ADD_INV_4LN2 1549082005u            // 2^32 / (4 ln 2)
+#define SHIFT_ADD_LN2 2977044472u                 // 2^32 * ln 2
+#define SHIFT_ADD_SQRT2 6521908912666391106ull    // 2^62 * sqrt(2)
+
+// v * 2^shift 四捨五入，超過 32 位元時飽和
+static inline uint32_t shift_add_scale(uint64_t v, int shift) {
+    if (shift >= 0) {
+        if (shift >= 32 || v > (UINT32_MAX >> shift)) {
+            return UINT32_MAX;
+        }
+        return (uint32_t) (v << shift);
+    }
+    if (shift < -63) {
+        return 0;
+    }
+    v = (v >> -shift) + ((v >> (-shift - 1)) & 1);
+    return v > UINT32_MAX ? UINT32_MAX : (uint32_t) v;
+}
+
+// y * neg / 2^64，neg < 2^48（ε < 2^-16）
+static inline uint64_t shift_add_mulhi(uint64_t y, uint64_t neg) {
+    return ((y >> 32) * (neg >> 16)) >> 16;
+}
+
+// 2^(2 frac) / x
+static inline uint32_t shift_add_recip(uint32_t x, int frac) {
+    if (!x) {
+        return UINT32_MAX;
+    }
+    int lz = __builtin_clz(x);
+    uint64_t r0 = (uint64_t) x << (32 + lz);  // m ∈ [1, 2)，Q1.63
+    uint64_t y = 1ull << 62;                  // 乘積 P，Q2.62
+
+    for (int shift = 1; shift <= SHIFT_ADD_STEPS; ++shift) {
+        uint64_t temp = r0 + (r0 >> shift);
+        uint64_t keep = -(uint64_t) (temp >= r0);  // 沒有 carry 時全為 1
+        r0 = temp < r0 ? r0 : temp;
+        y += (y >> shift) & keep;
+    }
+    // m * P = 2 (1 - ε)，1/m ≈ P (1 + ε) / 2
+    y += shift_add_mulhi(y, -r0);
+    // y ≈ 2^94 / (x << lz)
+    return shift_add_scale(y, 2 * frac + lz - 94);
+}
+
+// 2^(1.5 frac) / sqrt(x)
+static inline uint32_t shift_add_rsqrt(uint32_t x, int frac) {
+    if (!x) {
+        return UINT32_MAX;
+    }
+    int s = __builtin_clz(x) & ~1;
+    uint64_t r0 = (uint64_t) x << (32 + s);  // m ∈ [2^62, 2^64)
+    // 3 frac 為奇數時多出的 sqrt(2) 放在初值
+    uint64_t y = (3 * frac) & 1 ? SHIFT_ADD_SQRT2 : 1ull << 62;
+
+    for (int shift = 1; shift <= SHIFT_ADD_STEPS; ++shift) {
+        uint64_t temp = r0 + (r0 >> shift);
+        uint64_t temp2 = temp + (temp >> shift);
+        uint64_t keep = -(uint64_t) ((temp >= r0) & (temp2 >= temp));
+        r0 = (temp2 & keep) | (r0 & ~keep);
+        y += (y >> shift) & keep;
+    }
+    // m * P^2 = 2^64 (1 - ε)，1/sqrt(m) ≈ P (1 + ε/2) / 2^32
+    y += shift_add_mulhi(y, -r0) >> 1;
+    // y ≈ c * 2^(78 - s/2) / sqrt(x)
+    return shift_add_scale(y, (3 * frac - ((3 * frac) & 1) + s) / 2 - 78);
+}
+
+// log2(x) 以有號 frac 位小數表示
+static inline int32_t shift_add_log2(uint32_t x, int frac) {
+    if (!x) {
+        return INT32_MIN;
+    }
+    int lz = __builtin_clz(x);
+    uint64_t r0 = (uint64_t) x << (32 + lz);  // m ∈ [1, 2)，Q1.63
+    int64_t frac_part = 1ll << 62;            // log2(m) = 1 - Σ log2(1 + 2^-k) - ...，Q2.62
+
+    for (int shift = 1; shift <= SHIFT_ADD_STEPS; ++shift) {
+        uint64_t temp = r0 + (r0 >> shift);
+        uint64_t keep = -(uint64_t) (temp >= r0);
+        r0 = temp < r0 ? r0 : temp;
+        frac_part -= shift_add_log2_table[shift - 1] & keep;
+    }
+    // m * P = 2 (1 - ε)，log2(1 - ε) ≈ -ε / ln 2
+    uint64_t neg = -r0;
+    frac_part -= ((neg >> 16) * SHIFT_ADD_INV_4LN2) >> 16;
+
+    // 整數部分在 x < 1.0 時為負，以乘法代替左移，避免負數左移的未定義行為
+    int64_t result = (int64_t) (31 - lz - frac) * ((int64_t) 1 << frac) +
+                     ((frac_part + (1ll << (61 - frac))) >> (62 - frac));
+    return (int32_t) result;
+}
+
+// 2^x，x 為有號 frac 位小數
+static inline uint32_t shift_add_exp2(int32_t x, int frac) {
+    int32_t ipart = x >> frac;  // 算術右移，取 floor
+    uint64_t f = (uint64_t) ((uint32_t) x & ((1u << frac) - 1)) << (62 - frac);  // Q2.62
+    uint64_t y = 1ull << 62;                                                     // Q2.62
+
+    if (ipart + frac >= 32) {
+        return UINT32_MAX;
+    }
+    for (int shift = 1; shift <= SHIFT_ADD_STEPS; ++shift) {
+        uint64_t keep = -(uint64_t) (f >= shift_add_log2_table[shift - 1]);
+        f -= shift_add_log2_table[shift - 1] & keep;
+        y += (y >> shift) & keep;
+    }
+    // 剩下的 f < 2^-19，2^f ≈ 1 + f ln 2
+    uint64_t f_ln2 = ((f >> 13) * SHIFT_ADD_LN2) >> 32;  // f ln 2 / 2^13
+    y += ((y >> 32) * f_ln2) >> 17;
+    return shift_add_scale(y, ipart + frac - 62);
+}
+
+uint32_t recip_q9_23(uint32_t x) { return shift_add_recip(x, 23); }
+uint32_t rsqrt_q9_23(uint32_t x) { return shift_add_rsqrt(x, 23); }
+int32_t log2_q9_23(uint32_t x) { return shift_add_log2(x, 23); }
+uint32_t exp2_q9_23(int32_t x) { return shift_add_exp2(x, 23); }
+
+uint32_t recip_q16_16(uint32_t x) { return shift_add_recip(x, 16); }
+uint32_t rsqrt_q16_16(uint32_t x) { return shift_add_rsqrt(x, 16); }
+int32_t log2_q16_16(uint32_t x) { return shift_add_log2(x, 16); }
+uint32_t exp2_q16_16(int32_t x) { return shift_add_exp2(x, 16); }
+
+// 批次版本：frac 是常數，展開後與單一呼叫相同
+#define SHIFT_ADD_DEFINE_BATCH(name, in_t, out_t, fn, frac)              \
+    void name##_batch(const in_t *in, out_t *out, size_t n) {           \
+        for (size_t i = 0; i < n; i++) {                                \
+            out[i] = fn(in[i], frac);                                   \
+        }                                                               \
+    }
+
+SHIFT_ADD_DEFINE_BATCH(recip_q9_23, uint32_t, uint32_t, shift_add_recip, 23)
+SHIFT_ADD_DEFINE_BATCH(rsqrt_q9_23, uint32_t, uint32_t, shift_add_rsqrt, 23)
+SHIFT_ADD_DEFINE_BATCH(log2_q9_23, uint32_t, int32_t, shift_add_log2, 23)
+SHIFT_ADD_DEFINE_BATCH(exp2_q9_23, int32_t, uint32_t, shift_add_exp2, 23)
+SHIFT_ADD_DEFINE_BATCH(recip_q16_16, uint32_t, uint32_t, shift_add_recip, 16)
+SHIFT_ADD_DEFINE_BATCH(rsqrt_q16_16, uint32_t, uint32_t, shift_add_rsqrt, 16)
+SHIFT_ADD_DEFINE_BATCH(log2_q16_16, uint32_t, int32_t, shift_add_log2, 16)
+SHIFT_ADD_DEFINE_BATCH(exp2_q16_16, int32_t, uint32_t, shift_add_exp2, 16)
+
+/*---------------------- shift-add 數學函式測試 ----------------------*/
+
+/*
+ * 與 libm（long double）算出並四捨五入的參考值比較，以輸出的最小單位計算誤差。
+ * 輸入包含 [0.5, 4.0) 的每一個值、整個 32 位元範圍的等距取樣與隨機值；
+ * 參考值超出 32 位元範圍的輸入只檢查是否飽和。
+ * 批次版本以 batch 入口量測，逐一確認與純量版本相同。
+ *
+ * 定點運算容易寫出負數左移或溢位，修改後以 UBSan 跑一次：
+ *   gcc -O2 -fsanitize=undefined -fno-sanitize-recover=all -pthread sqrt_asm.c -lm
+ *   ./a.out --mathlib
+ */
+
+typedef struct {
+    const char *name;
+    int frac;
+    int is_signed_input;  // exp2 的輸入為有號
+    uint32_t max_ulp;     // 容許的最大誤差
+    uint32_t (*scalar)(uint32_t x);
+    void (*batch)(const uint32_t *in, uint32_t *out, size_t n);
+    long double (*ref)(long double v);
+} shift_add_func_t;
+
+static long double shift_add_ref_recip(long double v) { return 1.0L / v; }
+static long double shift_add_ref_rsqrt(long double v) { return 1.0L / sqrtl(v); }
+static long double shift_add_ref_log2(long double v) { return log2l(v); }
+static long double shift_add_ref_exp2(long double v) { return exp2l(v); }
+
+// 介面統一成 uint32_t，方便放進同一張表
+static uint32_t log2_q9_23_u(uint32_t x) { return (uint32_t) log2_q9_23(x); }
+static uint32_t exp2_q9_23_u(uint32_t x) { return exp2_q9_23((int32_t) x); }
+static uint32_t log2_q16_16_u(uint32_t x) { return (uint32_t) log2_q16_16(x); }
+static uint32_t exp2_q16_16_u(uint32_t x) { return exp2_q16_16((int32_t) x); }
+static void log2_q9_23_batch_u(const uint32_t *in, uint32_t *out, size_t n) {
+    log2_q9_23_batch(in, (int32_t *) out, n);
+}
+static void exp2_q9_23_batch_u(const uint32_t *in, uint32_t *out, size_t n) {
+    exp2_q9_23_batch((const int32_t *) in, out, n);
+}
+static void log2_q16_16_batch_u(const uint32_t *in, uint32_t *out, size_t n) {
+    log2_q16_16_batch(in, (int32_t *) out, n);
+}
+static void exp2_q16_16_batch_u(const uint32_t *in, uint32_t *out, size_t n) {
+    exp2_q16_16_batch((const int32_t *) in, out, n);
+}
+
+static const shift_add_func_t shift_add_funcs[] = {
+    {"recip_q9_23", 23, 0, 1, recip_q9_23, recip_q9_23_batch, shift_add_ref_recip},
+    {"rsqrt_q9_23", 23, 0, 1, rsqrt_q9_23, rsqrt_q9_23_batch, shift_add_ref_rsqrt},
+    {"log2_q9_23", 23, 0, 1, log2_q9_23_u, log2_q9_23_batch_u, shift_add_ref_log2},
+    {"exp2_q9_23", 23, 1, 1, exp2_q9_23_u, exp2_q9_23_batch_u, shift_add_ref_exp2},
+    {"recip_q16_16", 16, 0, 1, recip_q16_16, recip_q16_16_batch, shift_add_ref_recip},
+    {"rsqrt_q16_16", 16, 0, 1, rsqrt_q16_16, rsqrt_q16_16_batch, shift_add_ref_rsqrt},
+    {"log2_q16_16", 16, 0, 1, log2_q16_16_u, log2_q16_16_batch_u, shift_add_ref_log2},
+    {"exp2_q16_16", 16, 1, 1, exp2_q16_16_u, exp2_q16_16_batch_u, shift_add_ref_exp2},
+};
+
+#define SHIFT_ADD_NUM_FUNCS (sizeof(shift_add_funcs) / sizeof(shift_add_funcs[0]))
+
+typedef struct {
+    uint64_t checked, saturated;
+    uint32_t max_ulp;
+    uint32_t worst_input;
+    int64_t worst_got, worst_expected;
+} shift_add_stats_t;
+
+static void shift_add_check(const shift_add_func_t *f, uint32_t x, shift_add_stats_t *st) {
+    long double scale = ldexpl(1.0L, f->frac);
+    long double v = f->is_signed_input ? (int32_t) x / scale : x / scale;
+    uint32_t got = f->scalar(x);
+    int64_t got_value, expected;
+
+    if (!f->is_signed_input && x == 0) {
+        // 1/0 與 log2(0)：分別飽和為 UINT32_MAX 與 INT32_MIN
+        expected = f->ref == shift_add_ref_log2 ? (uint32_t) INT32_MIN : UINT32_MAX;
+        got_value = got;
+        st->saturated++;
+    } else if (f->ref == shift_add_ref_log2) {
+        expected = llroundl(f->ref(v) * scale);
+        got_value = (int32_t) got;
+    } else {
+        long double r = roundl(f->ref(v) * scale);
+        expected = r > UINT32_MAX ? UINT32_MAX : (int64_t) r;
+        st->saturated += r > UINT32_MAX;
+        got_value = got;
+    }
+    uint64_t err = got_value > expected ? got_value - expected : expected - got_value;
+    st->checked++;
+    if (err > st->max_ulp) {
+        st->max_ulp = err > UINT32_MAX ? UINT32_MAX : (uint32_t) err;
+        st->worst_input = x;
+        st->worst_got = got_value;
+        st->worst_expected = expected;
+    }
+}
+
+static int shift_add_main(void) {
+    enum { N = 4096, REPS = 200, RANDOM = 1 << 20 };
+    static uint32_t in[N], out[N];
+    int status = 0;
+
+    printf("%-14s %10s %10s %8s %12s  %s\n", "function", "checked", "saturated", "max_ulp",
+           "cycles/value", "worst case");
+    for (size_t k = 0; k < SHIFT_ADD_NUM_FUNCS; k++) {
+        const shift_add_func_t *f = &shift_add_funcs[k];
+        shift_add_stats_t st = {0};
+        // [0.5, 4.0) 的每一個值；exp2 另外加上負數的對應區間
+        for (uint32_t x = 1u << (f->frac - 1); x < (4u << f->frac); x++) {
+            shift_add_check(f, x, &st);
+            if (f->is_signed_input) {
+                shift_add_check(f, -x, &st);
+            }
+        }
+        for (uint64_t x = 0; x <= UINT32_MAX; x += 4099) {
+            shift_add_check(f, (uint32_t) x, &st);
+        }
+        uint32_t seed = 2463534242u;
+        for (int j = 0; j < RANDOM; j++) {
+            seed ^= seed << 13;
+            seed ^= seed >> 17;
+            seed ^= seed << 5;
+            shift_add_check(f, seed, &st);
+        }
+
+        // 批次版本必須與純量版本逐一相同；輸入取常用範圍附近
+        for (int j = 0; j < N; j++) {
+            seed ^= seed << 13;
+            seed ^= seed >> 17;
+            seed ^= seed << 5;
+            in[j] = f->is_signed_input ? (uint32_t) ((int32_t) (seed % (16u << f->frac)) -
+                                                     (int32_t) (8u << f->frac))
+                                       : seed % (16u << f->frac) + 1;
+        }
+        f->batch(in, out, N);
+        for (int j = 0; j < N; j++) {
+            if (out[j] != f->scalar(in[j])) {
+                printf("%s: batch mismatch at x=0x%08x\n", f->name, in[j]);
+                status = 1;
+                break;
+            }
+        }
+        uint64_t cycles = measure_cycles_begin();
+        for (int r = 0; r < REPS; r++) {
+            f->batch(in, out, N);
+            __asm__ volatile("" ::"r"(out) : "memory");
+        }
+        cycles = measure_cycles_end() - cycles;
+
+        printf("%-14s %10llu %10llu %8u %12.2f", f->name, (unsigned long long) st.checked,
+               (unsigned long long) st.saturated, st.max_ulp,
+               (double) cycles / ((double) N * REPS));
+        if (st.max_ulp) {
+            printf("  x=0x%08x got %lld expected %lld", st.worst_input,
+                   (long long) st.worst_got, (long long) st.worst_expected);
+        }
+        printf("\n");
+        if (st.max_ulp > f->max_ulp) {
+            printf("%s: error exceeds %u ulp\n", f->name, f->max_ulp);
+            status = 1;
+        }
+    }
+    return status;
+}
+
+/*---------------------- 通用產生器測試 ----------------------*/
+
+/*
+ * 對每個產生的版本，與精確的 floor(sqrt(x << frac)) 比較：
+ * - 固定前移的版本掃 [1.0, 4.0)，32 位元的版本逐一檢查，64 位元的隨機取樣。
+ * - 任意輸入的版本在整個範圍隨機取樣，格式放得下時另外加上 [1.0, 4.0) 的隨機值。
+ * 回報最大誤差、相對誤差換算的精度位元與吞吐量；
+ * 並確認 Q9.23 13 輪的產生結果與 sqrt_fixed_q9_23 逐位元相同、成本相同。
+ */
+
+// 包成相同的介面，量測時每個版本都多一層相同的間接呼叫
+#define SQRT_GEN_WRAP(fn, uint_t) \
+    static uint64_t fn##_u64(uint64_t x) { return fn((uint_t) x); }
+SQRT_GEN_WRAP(sqrt_fixed_q9_23, uint32_t)
+SQRT_GEN_WRAP(sqrt_q9_23_s13, uint32_t)
+SQRT_GEN_WRAP(sqrt_q9_23_s7, uint32_t)
+SQRT_GEN_WRAP(sqrt_q16_16_s13, uint32_t)
+SQRT_GEN_WRAP(sqrt_q16_16_any, uint32_t)
+SQRT_GEN_WRAP(sqrt_q16_16_any_s7, uint32_t)
+SQRT_GEN_WRAP(sqrt_q1_31_any, uint32_t)
+SQRT_GEN_WRAP(sqrt_q32_32_s26, uint64_t)
+SQRT_GEN_WRAP(sqrt_q32_32_any, uint64_t)
+SQRT_GEN_WRAP(sqrt_q1_63_any, uint64_t)
+
+typedef struct {
+    const char *name;
+    uint64_t (*fn)(uint64_t x);
+    int bits, frac, steps;
+    int any;  // 任何輸入都有效
+} sqrt_gen_case_t;
+
+static const sqrt_gen_case_t sqrt_gen_cases[] = {
+    {"sqrt_fixed_q9_23", sqrt_fixed_q9_23_u64, 32, 23, 13, 0},
+    {"sqrt_q9_23_s13", sqrt_q9_23_s13_u64, 32, 23, 13, 0},
+    {"sqrt_q9_23_s7", sqrt_q9_23_s7_u64, 32, 23, 7, 0},
+    {"sqrt_q16_16_s13", sqrt_q16_16_s13_u64, 32, 16, 13, 0},
+    {"sqrt_q16_16_any", sqrt_q16_16_any_u64, 32, 16, 16, 1},
+    {"sqrt_q16_16_any_s7", sqrt_q16_16_any_s7_u64, 32, 16, 7, 1},
+    {"sqrt_q1_31_any", sqrt_q1_31_any_u64, 32, 31, 16, 1},
+    {"sqrt_q32_32_s26", sqrt_q32_32_s26_u64, 64, 32, 26, 0},
+    {"sqrt_q32_32_any", sqrt_q32_32_any_u64, 64, 32, 26, 1},
+    {"sqrt_q1_63_any", sqrt_q1_63_any_u64, 64, 63, 32, 1},
+};
+
+#define SQRT_NUM_GEN_CASES (sizeof(sqrt_gen_cases) / sizeof(sqrt_gen_cases[0]))
+
+// floor(sqrt(X))，X < 2^127
+static uint64_t sqrt_ref_u128(unsigned __int128 X) {
+    unsigned __int128 r = (uint64_t) sqrtl((long double) X);
+    while (r * r > X) {
+        r--;
+    }
+    while ((r + 1) * (r + 1) <= X) {
+        r++;
+    }
+    return (uint64_t) r;
+}
+
+static inline uint64_t sqrt_gen_rand(uint64_t *state) {
+    uint64_t x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+static int sqrt_gen_main(void) {
+    enum { N = 4096, REPS = 500, RANDOM = 1 << 22 };
+    static uint64_t in[N], out[N];
+    int status = 0;
+
+    // 產生的 Q9.23 13 輪版本與手寫版本在 x < 2^25 逐位元相同
+    for (uint32_t x = 0; x < (1u << 25); x++) {
+        if (sqrt_q9_23_s13(x) != sqrt_fixed_q9_23(x)) {
+            printf("sqrt_q9_23_s13 differs from sqrt_fixed_q9_23 at x=0x%08x\n", x);
+            status = 1;
+            break;
+        }
+    }
+
+    printf("%-20s %6s %6s %10s %10s %6s %14s\n", "kernel", "format", "steps", "max_below",
+           "max_above", "bits", "cycles/value");
+    for (size_t k = 0; k < SQRT_NUM_GEN_CASES; k++) {
+        const sqrt_gen_case_t *c = &sqrt_gen_cases[k];
+        uint64_t one = 1ull << c->frac;
+        uint64_t mask = c->bits == 64 ? UINT64_MAX : (1ull << c->bits) - 1;
+        int64_t below = 0, above = 0;
+        double worst_rel = 0;
+        uint64_t state = 88172645463325252ull;
+        uint64_t count = c->bits == 32 && !c->any ? 3 * one : RANDOM;
+        int fits = c->frac <= c->bits - 2;  // Q1.31、Q1.63 放不下 [1.0, 4.0)
+
+        for (uint64_t j = 0; j < count; j++) {
+            uint64_t x;
+            if (c->bits == 32 && !c->any) {
+                x = one + j;  // [1.0, 4.0) 逐一檢查
+            } else if (fits && (!c->any || (j & 1))) {
+                x = one + sqrt_gen_rand(&state) % (3 * one);
+            } else {
+                x = sqrt_gen_rand(&state) & mask;
+            }
+            uint64_t ref = sqrt_ref_u128((unsigned __int128) x << c->frac);
+            int64_t d = (int64_t) (c->fn(x) - ref);
+            below = d < below ? d : below;
+            above = d > above ? d : above;
+            if (d && ref) {
+                double rel = (d < 0 ? -d : d) / (double) ref;
+                worst_rel = rel > worst_rel ? rel : worst_rel;
+            }
+        }
+
+        for (int j = 0; j < N; j++) {
+            in[j] = fits ? one + sqrt_gen_rand(&state) % (3 * one) : sqrt_gen_rand(&state) & mask;
+        }
+        uint64_t (*fn)(uint64_t) = c->fn;
+        uint64_t cycles = measure_cycles_begin();
+        for (int r = 0; r < REPS; r++) {
+            for (int j = 0; j < N; j++) {
+                out[j] = fn(in[j]);
+            }
+            __asm__ volatile("" ::"r"(out) : "memory");
+        }
+        cycles = measure_cycles_end() - cycles;
+
+        char format[16];
+        snprintf(format, sizeof(format), "Q%d.%d", c->bits - c->frac, c->frac);
+        printf("%-20s %6s %6d %10lld %10lld %6.1f %14.2f\n", c->name, format, c->steps,
+               (long long) below, (long long) above,
+               worst_rel > 0 ? -log2(worst_rel) : 64.0, (double) cycles / ((double) N * REPS));
+    }
+    return status;
+}
+
+int main(int argc, char *argv[]) {
+
+    // --batch：檢查並量測批次版本
+    if (argc > 1 && strcmp(argv[1], "--batch") == 0) {
+        return sqrt_batch_main();
+    }
+    // --kernels：比較各個核心的誤差、延遲與吞吐量
+    if (argc > 1 && strcmp(argv[1], "--kernels") == 0) {
+        return sqrt_kernels_main();
+    }
+    // --verify [--full] [kernel]：以所有核心全面驗證
+    if (argc > 1 && strcmp(argv[1], "--verify") == 0) {
+        int full = argc > 2 && strcmp(argv[2], "--full") == 0;
+        return sqrt_verify_main(full, argc > 2 + full ? argv[2 + full] : NULL);
+    }
+    // --qformats：檢查並量測各個格式與輪數的 shift-add 平方根
+    if (argc > 1 && strcmp(argv[1], "--qformats") == 0) {
+        return sqrt_gen_main();
+    }
+    // --mathlib：檢查並量測 shift-add 的 recip、rsqrt、log2、exp2
+    if (argc > 1 && strcmp(argv[1], "--mathlib") == 0) {
+        return shift_add_main();
+    }
+    // --sqrtf：檢查並量測軟體 sqrtf
+    if (argc > 1 && strcmp(argv[1], "--sqrtf") == 0) {
+        return sqrtf_soft_main();
+    }
 
     uint32_t mantissa32 = 2 << 23;
     uint32_t new_mantissa = sqrt_fixed_q9_23(mantissa32);
@@ -0,0 +1,358 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <stdint.h>
+
+#include "intrusive.h"
+#include "measure.h"
+
+// 鏈表元素結構：包含一個字串與鏈表節點
+typedef struct {
+    char *value;
+    struct list_head list;
+} element_t;
+
+#include "list_sort.h"
+
+/*---------------------- Top-k ----------------------*/
+
+/*
+ * 以大小為 k 的最大堆積保留目前看過的最小 k 個元素，堆頂是其中最大的。
+ * 每個新元素只需與堆頂比較一次，比堆頂小才替換並往下調整，
+ * 因此整體為 O(n log k)。seq 記錄加入順序，鍵值相同時先加入者較小，
+ * 讓結果是穩定的。
+ *
+ * 堆積只存放元素指標，不會改動隊列；元素被刪除或釋放後，
+ * 必須重新建立 topk_t。
+ */
+typedef struct {
+    element_t *elem;
+    size_t seq;
+} topk_entry_t;
+
+typedef struct {
+    topk_entry_t *heap;     // heap[0 .. size) 為最大堆積
+    topk_entry_t *scratch;  // 輸出排序結果時使用，不破壞 heap
+    size_t size;
+    size_t k;
+    size_t seq;
+} topk_t;
+
+bool topk_init(topk_t *tk, size_t k)
+{
+    tk->heap = malloc(2 * (k ? k : 1) * sizeof(topk_entry_t));
+    if (!tk->heap) {
+        return false;
+    }
+    tk->scratch = tk->heap + k;
+    tk->size = 0;
+    tk->k = k;
+    tk->seq = 0;
+    return true;
+}
+
+void topk_free(topk_t *tk)
+{
+    free(tk->heap);
+    tk->heap = tk->scratch = NULL;
+}
+
+/**
+ * DEFINE_TOPK - 產生以 cmp 比較的 top-k 函式
+ * @name: 函式名稱前綴
+ * @cmp:  比較函式，回傳值與 strcmp 相同
+ *
+ * 產生：
+ * - name_push(tk, elem)：把一個元素加入追蹤
+ * - name_scan(tk, head)：依隊列順序加入整個隊列
+ * - name_insert_head(head, tk, s)：q_insert_head 後立即加入追蹤
+ * - name_result(tk, out)：把最小的 k 個元素由小到大寫入 out，回傳個數
+ * - name_partial_sort(head, k)：把最小的 k 個節點依序移到隊列最前面，
+ *   其餘節點保持原本的相對順序
+ */
+#define DEFINE_TOPK(name, cmp)                                                 \
+    static inline bool name##_before(const topk_entry_t *a,                    \
+                                     const topk_entry_t *b)                    \
+    {                                                                          \
+        int diff = cmp(a->elem->value, b->elem->value);                        \
+        return diff < 0 || (diff == 0 && a->seq < b->seq);                     \
+    }                                                                          \
+                                                                               \
+    static void name##_sift_down(topk_entry_t *heap, size_t size, size_t i)    \
+    {                                                                          \
+        topk_entry_t tmp = heap[i];                                            \
+        for (size_t child; (child = 2 * i + 1) < size; i = child) {            \
+            if (child + 1 < size && name##_before(&heap[child], &heap[child + 1])) \
+                child++;                                                       \
+            if (!name##_before(&tmp, &heap[child]))                            \
+                break;                                                         \
+            heap[i] = heap[child];                                             \
+        }                                                                      \
+        heap[i] = tmp;                                                         \
+    }                                                                          \
+                                                                               \
+    void name##_push(topk_t *tk, element_t *elem)                              \
+    {                                                                          \
+        topk_entry_t entry = {elem, tk->seq++};                                \
+        if (tk->size < tk->k) {                                                \
+            size_t i = tk->size++;                                             \
+            while (i > 0 && name##_before(&tk->heap[(i - 1) / 2], &entry)) {   \
+                tk->heap[i] = tk->heap[(i - 1) / 2];                           \
+                i = (i - 1) / 2;                                               \
+            }                                                                  \
+            tk->heap[i] = entry;                                               \
+        } else if (tk->k > 0 && name##_before(&entry, &tk->heap[0])) {         \
+            tk->heap[0] = entry;                                               \
+            name##_sift_down(tk->heap, tk->size, 0);                           \
+        }                                                                      \
+    }                                                                          \
+                                                                               \
+    void name##_scan(topk_t *tk, struct list_head *head)                       \
+    {                                                                          \
+        struct list_head *pos;                                                 \
+        for (pos = head->next; pos != head; pos = pos->next)                   \
+            name##_push(tk, list_entry(pos, element_t, list));                 \
+    }                                                                          \
+                                                                               \
+    bool name##_insert_head(struct list_head *head, topk_t *tk, char *s)       \
+    {                                                                          \
+        if (!q_insert_head(head, s))                                           \
+            return false;                                                      \
+        name##_push(tk, list_entry(head->next, element_t, list));              \
+        return true;                                                           \
+    }                                                                          \
+                                                                               \
+    size_t name##_result(const topk_t *tk, element_t **out)                    \
+    {                                                                          \
+        size_t n = tk->size;                                                   \
+        memcpy(tk->scratch, tk->heap, n * sizeof(topk_entry_t));               \
+        for (size_t end = n; end > 1; end--) {                                 \
+            topk_entry_t max = tk->scratch[0];                                 \
+            tk->scratch[0] = tk->scratch[end - 1];                             \
+            tk->scratch[end - 1] = max;                                        \
+            name##_sift_down(tk->scratch, end - 1, 0);                         \
+        }                                                                      \
+        for (size_t i = 0; i < n; i++)                                         \
+            out[i] = tk->scratch[i].elem;                                      \
+        return n;                                                              \
+    }                                                                          \
+                                                                               \
+    bool name##_partial_sort(struct list_head *head, size_t k)                 \
+    {                                                                          \
+        topk_t tk;                                                             \
+        element_t **sorted = malloc((k ? k : 1) * sizeof(element_t *));        \
+        if (!sorted || !topk_init(&tk, k)) {                                   \
+            free(sorted);                                                      \
+            return false;                                                      \
+        }                                                                      \
+        name##_scan(&tk, head);                                                \
+        size_t n = name##_result(&tk, sorted);                                 \
+        for (size_t i = n; i-- > 0;)                                           \
+            list_move(&sorted[i]->list, head);                                 \
+        topk_free(&tk);                                                        \
+        free(sorted);                                                          \
+        return true;                                                           \
+    }
+
+DEFINE_TOPK(topk_numeric, cmp_numeric)
+DEFINE_TOPK(topk_string, cmp_string)
+
+/*---------------------- 完整排序（對照組） ----------------------*/
+
+DEFINE_LIST_MERGE_SORT(list_merge_sort, cmp_numeric)
+
+/*---------------------- Main 測試 ----------------------*/
+
+typedef struct {
+    element_t *elem;
+    size_t seq;
+} ref_entry_t;
+
+static int ref_cmp_numeric(const void *a, const void *b)
+{
+    const ref_entry_t *x = a, *y = b;
+    int diff = cmp_numeric(x->elem->value, y->elem->value);
+    return diff ? diff : (x->seq > y->seq) - (x->seq < y->seq);
+}
+
+static int ref_cmp_string(const void *a, const void *b)
+{
+    const ref_entry_t *x = a, *y = b;
+    int diff = cmp_string(x->elem->value, y->elem->value);
+    return diff ? diff : (x->seq > y->seq) - (x->seq < y->seq);
+}
+
+static struct list_head *build_queue(int n, int modulo)
+{
+    struct list_head *queue = q_new();
+    if (!queue) {
+        return NULL;
+    }
+    for (int i = 0; i < n; i++) {
+        char random_str[16];
+        sprintf(random_str, "%d", rand() % modulo);
+        if (!q_insert_head(queue, random_str)) {
+            q_free(queue);
+            return NULL;
+        }
+    }
+    return queue;
+}
+
+/**
+ * check_partial_sort - 以 qsort 的穩定結果驗證 partial_sort
+ *
+ * 前 min(k, n) 個節點必須等於穩定排序後的前段，
+ * 其餘節點必須維持原本的相對順序。
+ */
+static bool check_partial_sort(bool (*partial_sort)(struct list_head *, size_t),
+                               int (*ref_cmp)(const void *, const void *), int n,
+                               size_t k)
+{
+    struct list_head *queue = build_queue(n, 100);
+    ref_entry_t *ref = malloc((n + 1) * sizeof(ref_entry_t));
+    element_t **before = malloc((n + 1) * sizeof(element_t *));
+    bool *taken = calloc(n + 1, sizeof(bool));
+    bool ok = queue && ref && before && taken;
+    struct list_head *pos;
+    size_t i = 0;
+
+    if (ok) {
+        for (pos = queue->next; pos != queue; pos = pos->next, i++) {
+            ref[i].elem = before[i] = list_entry(pos, element_t, list);
+            ref[i].seq = i;
+        }
+        qsort(ref, n, sizeof(ref_entry_t), ref_cmp);
+        ok = partial_sort(queue, k);
+    }
+
+    size_t m = k < (size_t) n ? k : (size_t) n;
+    i = 0;
+    for (pos = queue ? queue->next : NULL; ok && i < m; pos = pos->next, i++) {
+        ok = list_entry(pos, element_t, list) == ref[i].elem;
+        taken[ref[i].seq] = true;
+    }
+    // 剩下的節點依原本順序出現
+    for (size_t j = 0; ok && j < (size_t) n; j++) {
+        if (taken[j]) {
+            continue;
+        }
+        ok = pos != queue && list_entry(pos, element_t, list) == before[j];
+        pos = pos->next;
+    }
+    ok = ok && pos == queue;
+
+    free(ref);
+    free(before);
+    free(taken);
+    if (queue) {
+        q_free(queue);
+    }
+    return ok;
+}
+
+// 逐一以 insert_head 加入元素，最後的 top-k 必須等於依加入順序穩定排序的前 k 個
+static bool check_incremental(int n, size_t k)
+{
+    struct list_head *queue = q_new();
+    ref_entry_t *ref = malloc((n + 1) * sizeof(ref_entry_t));
+    element_t **out = malloc((k + 1) * sizeof(element_t *));
+    topk_t tk;
+    bool ok = queue && ref && out && topk_init(&tk, k);
+
+    for (int i = 0; ok && i < n; i++) {
+        char random_str[16];
+        sprintf(random_str, "%d", rand() % 100);
+        ok = topk_numeric_insert_head(queue, &tk, random_str);
+        if (ok) {
+            ref[i].elem = list_entry(queue->next, element_t, list);
+            ref[i].seq = i;
+        }
+    }
+    if (ok) {
+        qsort(ref, n, sizeof(ref_entry_t), ref_cmp_numeric);
+        size_t m = topk_numeric_result(&tk, out);
+        ok = m == (k < (size_t) n ? k : (size_t) n);
+        for (size_t i = 0; ok && i < m; i++) {
+            ok = out[i] == ref[i].elem;
+        }
+        topk_free(&tk);
+    }
+    free(ref);
+    free(out);
+    if (queue) {
+        q_free(queue);
+    }
+    return ok;
+}
+
+int main(void)
+{
+    srand((unsigned) time(NULL));
+
+    // 正確性檢查
+    const int sizes[] = {0, 1, 2, 7, 100, 1000, 5000};
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        int n = sizes[s];
+        const size_t ks[] = {0, 1, 5, (size_t) n / 2, (size_t) n, (size_t) n + 3};
+        for (size_t j = 0; j < sizeof(ks) / sizeof(ks[0]); j++) {
+            if (!check_partial_sort(topk_numeric_partial_sort, ref_cmp_numeric, n, ks[j]) ||
+                !check_partial_sort(topk_string_partial_sort, ref_cmp_string, n, ks[j]) ||
+                !check_incremental(n, ks[j])) {
+                fprintf(stderr, "top-k check failed: n=%d k=%zu\n", n, ks[j]);
+                return 1;
+            }
+        }
+    }
+    printf("top-k checks passed\n");
+
+    // 效能比較：partial sort 為 O(n log k)，完整排序為 O(n log n)
+    printf("%-22s %10s %6s %16s %12s\n", "sort", "elements", "k", "cycles", "cycles/elem");
+    for (int n = 10000; n <= 1000000; n *= 10) {
+        const size_t ks[] = {10, 100, 1000};
+        for (size_t j = 0; j < sizeof(ks) / sizeof(ks[0]); j++) {
+            struct list_head *queue = build_queue(n, 1000000);
+            if (!queue) {
+                fprintf(stderr, "Failed to create list.\n");
+                return 1;
+            }
+            int64_t cycles = measure_cycles_begin();
+            topk_numeric_partial_sort(queue, ks[j]);
+            cycles = measure_cycles_end() - cycles;
+            printf("%-22s %10d %6zu %16ld %12.1f\n", "topk_partial_sort", n, ks[j],
+                   (long) cycles, (double) cycles / n);
+            q_free(queue);
+        }
+
+        struct list_head *queue = build_queue(n, 1000000);
+        if (!queue) {
+            fprintf(stderr, "Failed to create list.\n");
+            return 1;
+        }
+        int64_t cycles = measure_cycles_begin();
+        list_merge_sort(queue);
+        cycles = measure_cycles_end() - cycles;
+        printf("%-22s %10d %6s %16ld %12.1f\n", "list_merge_sort", n, "all", (long) cycles,
+               (double) cycles / n);
+        q_free(queue);
+
+        // 沉積排序為 O(n^2)，只跑最小的大小
+        if (n == 10000) {
+            queue = build_queue(n, 1000000);
+            if (!queue) {
+                fprintf(stderr, "Failed to create list.\n");
+                return 1;
+            }
+            cycles = measure_cycles_begin();
+            sediment_sort(queue);
+            cycles = measure_cycles_end() - cycles;
+            printf("%-22s %10d %6s %16ld %12.1f\n", "sediment_sort", n, "all",
+                   (long) cycles, (double) cycles / n);
+            q_free(queue);
+        }
+    }
+    return 0;
+}
@@ -6,116 +6,346 @@
 #include <time.h>
 #include <stdint.h>
 
+#include "intrusive.h"
+#include "measure.h"
 
-#define container_of(ptr, type, member) \
-    ((type *)((char *)(ptr) - offsetof(type, member)))
 /*---------------------- 模擬原先的結構定義 ----------------------*/
 
-// 雙向鏈表結構
-struct list_head {
-    struct list_head *prev;
-    struct list_head *next;
-};
-
 // 雙向鏈表中的元素結構
 typedef struct {
     char *value;
     struct list_head list;  // 用來串接鏈表或做二元樹指標
 } element_t;
 
-// 初始化鏈表頭
-static inline void INIT_LIST_HEAD(struct list_head *head)
+#include "list_sort.h"
+
+/*---------------------- 紅黑樹（重用 list_head 指標） ----------------------*/
+
+/*
+ * 樹節點直接使用 element_t 本身：
+ * - list.prev 當作左子樹指標，最低兩個位元存放標記：
+ *   RB_RED 為顏色（1 為紅、0 為黑），RB_DUPS 表示此節點帶有重複鍵值串列。
+ *   element_t 由 malloc 配置，至少 8 位元組對齊，最低兩個位元必為 0。
+ * - list.next 當作右子樹指標。
+ * 節點沒有父指標，插入時以 path[] 記錄由根往下的路徑。
+ *
+ * 鍵值相同的節點不進入樹中，而是以 list 串成 D1 <-> ... <-> Dk 的雙向串列，
+ * 樹的大小只與相異鍵值數量有關。串列兩端空出的指標用來存放子樹：
+ * - D1.list.prev 為左子樹，Dk.list.next 為右子樹。
+ * - 樹節點本身的 list.prev 改指向 &D1->list（保留標記位元），
+ *   list.next 改指向 &Dk->list。
+ * 所有存取都經過 rb_left/rb_right，平衡程式碼不需要知道重複串列的存在。
+ */
+#define RB_RED 1UL
+#define RB_DUPS 2UL
+#define RB_TAG_MASK (RB_RED | RB_DUPS)
+
+// 紅黑樹高度不超過 2 * log2(n + 1)，128 層足以容納任何可定址的節點數
+#define RB_MAX_DEPTH 128
+
+_Static_assert(_Alignof(element_t) >= 4, "tag bits need aligned element_t");
+
+static inline bool rb_has_dups(const element_t *node)
+{
+    return (uintptr_t) node->list.prev & RB_DUPS;
+}
+
+// 重複鍵值串列的第一個與最後一個節點，僅在 rb_has_dups() 成立時有效
+static inline struct list_head *rb_dups_first(const element_t *node)
+{
+    return (struct list_head *) ((uintptr_t) node->list.prev & ~RB_TAG_MASK);
+}
+
+static inline struct list_head *rb_dups_last(const element_t *node)
+{
+    return node->list.next;
+}
+
+static inline element_t *rb_left(const element_t *node)
+{
+    if (rb_has_dups(node)) {
+        return (element_t *) rb_dups_first(node)->prev;
+    }
+    return (element_t *) ((uintptr_t) node->list.prev & ~RB_TAG_MASK);
+}
+
+static inline element_t *rb_right(const element_t *node)
+{
+    if (rb_has_dups(node)) {
+        return (element_t *) rb_dups_last(node)->next;
+    }
+    return (element_t *) node->list.next;
+}
+
+static inline bool rb_is_red(const element_t *node)
+{
+    return node && ((uintptr_t) node->list.prev & RB_RED);
+}
+
+// 設定左子樹並保留原本的標記位元
+static inline void rb_set_left(element_t *node, element_t *left)
+{
+    if (rb_has_dups(node)) {
+        rb_dups_first(node)->prev = (struct list_head *) left;
+        return;
+    }
+    node->list.prev = (struct list_head *) ((uintptr_t) left |
+                                            ((uintptr_t) node->list.prev & RB_TAG_MASK));
+}
+
+static inline void rb_set_right(element_t *node, element_t *right)
+{
+    if (rb_has_dups(node)) {
+        rb_dups_last(node)->next = (struct list_head *) right;
+        return;
+    }
+    node->list.next = (struct list_head *) right;
+}
+
+/**
+ * rb_add_dup - 把鍵值與 node 相同的 dup 接到 node 的重複串列尾端
+ *
+ * 第一個重複節點會接手 node 的左右子樹指標，之後每次只需把右子樹
+ * 指標從舊的串列尾搬到新的串列尾，皆為 O(1)，且保持插入順序。
+ */
+static inline void rb_add_dup(element_t *node, element_t *dup)
+{
+    if (!rb_has_dups(node)) {
+        dup->list.prev = (struct list_head *) rb_left(node);
+        dup->list.next = (struct list_head *) rb_right(node);
+        node->list.prev = (struct list_head *) ((uintptr_t) &dup->list | RB_DUPS |
+                                                ((uintptr_t) node->list.prev & RB_RED));
+        node->list.next = &dup->list;
+        return;
+    }
+    struct list_head *last = rb_dups_last(node);
+    dup->list.prev = last;
+    dup->list.next = last->next;  // 右子樹
+    last->next = &dup->list;
+    node->list.next = &dup->list;
+}
+
+static inline void rb_set_red(element_t *node)
+{
+    node->list.prev = (struct list_head *) ((uintptr_t) node->list.prev | RB_RED);
+}
+
+static inline void rb_set_black(element_t *node)
 {
-    head->next = head;
-    head->prev = head;
+    node->list.prev = (struct list_head *) ((uintptr_t) node->list.prev & ~RB_RED);
 }
 
-// 在鏈表尾插入
-static inline void list_add_tail(struct list_head *node, struct list_head *head)
+// 把 parent 底下的 old 子樹換成 new；parent 為 NULL 表示 old 是根
+static inline void rb_replace_child(element_t **root, element_t *parent,
+                                    element_t *old, element_t *new)
 {
-    struct list_head *prev = head->prev;
-    prev->next = node;
-    node->next = head;
-    node->prev = prev;
-    head->prev = node;
+    if (!parent) {
+        *root = new;
+    } else if (rb_left(parent) == old) {
+        rb_set_left(parent, new);
+    } else {
+        rb_set_right(parent, new);
+    }
 }
 
-/*---------------------- CPU cycles ----------------------*/
+// 以 node 為軸左旋，回傳新的子樹根（原本的右子樹）
+static inline element_t *rb_rotate_left(element_t *node)
+{
+    element_t *right = rb_right(node);
+    rb_set_right(node, rb_left(right));
+    rb_set_left(right, node);
+    return right;
+}
 
-static inline int64_t cpucycles(void)
+// 以 node 為軸右旋，回傳新的子樹根（原本的左子樹）
+static inline element_t *rb_rotate_right(element_t *node)
 {
-#if defined(__i386__) || defined(__x86_64__)
-    unsigned int hi, lo;
-    __asm__ volatile("rdtsc\n\t" : "=a"(lo), "=d"(hi));
-    return ((int64_t) lo) | (((int64_t) hi) << 32);
-#elif defined(__aarch64__)
-    uint64_t val;
-    asm volatile("mrs %0, cntvct_el0" : "=r"(val));
-    return val;
-#else
-#error Unsupported Architecture
-#endif
+    element_t *left = rb_left(node);
+    rb_set_left(node, rb_right(left));
+    rb_set_right(left, node);
+    return left;
+}
+
+/**
+ * rb_insert_fixup - 插入紅色節點後恢復紅黑樹性質
+ * @root:  指向樹根的指標
+ * @path:  由根到 node 父節點的路徑，path[depth - 1] 為 node 的父節點
+ * @depth: 路徑長度
+ * @node:  剛插入的節點
+ */
+static void rb_insert_fixup(element_t **root, element_t **path, int depth,
+                            element_t *node)
+{
+    while (depth > 0) {
+        element_t *parent = path[depth - 1];
+        if (!rb_is_red(parent)) {
+            break;
+        }
+        // 父節點為紅色代表它不是根，一定有祖父節點
+        element_t *gparent = path[depth - 2];
+        element_t *ggparent = depth > 2 ? path[depth - 3] : NULL;
+
+        if (parent == rb_left(gparent)) {
+            element_t *uncle = rb_right(gparent);
+            if (rb_is_red(uncle)) {
+                // Case 1：叔叔為紅色，重新著色後往上兩層繼續
+                rb_set_black(parent);
+                rb_set_black(uncle);
+                rb_set_red(gparent);
+                node = gparent;
+                depth -= 2;
+                continue;
+            }
+            if (node == rb_right(parent)) {
+                // Case 2：轉成 Case 3 的形狀
+                rb_set_left(gparent, rb_rotate_left(parent));
+                parent = node;
+            }
+            // Case 3：以祖父為軸右旋
+            rb_set_black(parent);
+            rb_set_red(gparent);
+            rb_replace_child(root, ggparent, gparent, rb_rotate_right(gparent));
+        } else {
+            element_t *uncle = rb_left(gparent);
+            if (rb_is_red(uncle)) {
+                rb_set_black(parent);
+                rb_set_black(uncle);
+                rb_set_red(gparent);
+                node = gparent;
+                depth -= 2;
+                continue;
+            }
+            if (node == rb_left(parent)) {
+                rb_set_right(gparent, rb_rotate_right(parent));
+                parent = node;
+            }
+            rb_set_black(parent);
+            rb_set_red(gparent);
+            rb_replace_child(root, ggparent, gparent, rb_rotate_left(gparent));
+        }
+        break;
+    }
+    rb_set_black(*root);
 }
 
 /*---------------------- Tree Sort 相關函式 ----------------------*/
 
 /**
- * tree_insert_node - 將節點插入二元搜尋樹
+ * tree_insert_node - 將節點插入紅黑樹
  * @node: 要插入的節點
  * @root: 指向樹根的指標 (的指標)
- * @s:    字串資料 (若你想在此函式中設定 node->value)
+ * @s:    字串資料，會設定為 node->value
  *
  * 說明：
- * - 利用 element_t->list.prev 當作左子樹指標，
- *   element_t->list.next 當作右子樹指標。
- * - 若 *root 為 NULL，表示這是空樹，將 node 設為根。
- * - 若不為 NULL，根據字串大小插入左或右子樹。
+ * - 以迴圈由根往下找插入位置，不使用遞迴。
+ * - 比較結果小於 0 往左，大於 0 往右。
+ * - 遇到相同鍵值時接到該節點的重複串列尾端，不增加樹的大小，
+ *   也保持插入順序。
+ * - 插入新鍵值後以 rb_insert_fixup 重新平衡，樹高維持 O(log n)。
+ * - DEFINE_TREE_INSERT(name, cmp) 以比較器 cmp 產生插入函式 name。
  */
-bool tree_insert_node(element_t *node, element_t **root, char *s)
-{
-    // 如果原本樹是空的，node 成為根節點
-    if (*root == NULL) {
-        node->list.prev = NULL;
-        node->list.next = NULL;
-        node->value = s;  // 或者你可以在外部先設定好 node->value
-        *root = node;
-        return true;
-    }
-    // 比較字串：若 node->value < (*root)->value 則插入左子樹，否則插右子樹
-    if (atoi(s) - atoi((*root)->value) < 0) {
-        return tree_insert_node(node, (element_t **) &((*root)->list.prev), s);
-    } else {
-        return tree_insert_node(node, (element_t **) &((*root)->list.next), s);
+#define DEFINE_TREE_INSERT(name, cmp)                                          \
+    bool name(element_t *node, element_t **root, char *s)                     \
+    {                                                                          \
+        element_t *path[RB_MAX_DEPTH];                                         \
+        int depth = 0;                                                         \
+        bool go_left = false;                                                  \
+                                                                               \
+        node->value = s;                                                       \
+        node->list.prev = (struct list_head *) RB_RED; /* 左子樹為空、紅色 */ \
+        node->list.next = NULL;                                                \
+                                                                               \
+        for (element_t *cur = *root; cur;) {                                   \
+            if (depth == RB_MAX_DEPTH) {                                       \
+                return false;                                                  \
+            }                                                                  \
+            int diff = cmp(s, cur->value);                                     \
+            if (diff == 0) {                                                   \
+                rb_add_dup(cur, node);                                         \
+                return true;                                                   \
+            }                                                                  \
+            path[depth++] = cur;                                               \
+            go_left = diff < 0;                                                \
+            cur = go_left ? rb_left(cur) : rb_right(cur);                      \
+        }                                                                      \
+                                                                               \
+        if (depth == 0) {                                                      \
+            *root = node;                                                      \
+        } else if (go_left) {                                                  \
+            rb_set_left(path[depth - 1], node);                                \
+        } else {                                                               \
+            rb_set_right(path[depth - 1], node);                               \
+        }                                                                      \
+        rb_insert_fixup(root, path, depth, node);                              \
+        return true;                                                           \
     }
-}
+
+DEFINE_TREE_INSERT(tree_insert_node, cmp_numeric)
+DEFINE_TREE_INSERT(tree_insert_node_string, cmp_string)
+DEFINE_TREE_INSERT(tree_insert_node_length_first, cmp_length_first)
 
 /**
- * tree_inorder_rebuild - 中序遍歷二元搜尋樹並重建排序後的鏈表
+ * tree_inorder_rebuild - 中序遍歷紅黑樹並重建排序後的鏈表
  * @root: 指向樹根的指標
  * @list: 要重建的鏈表頭
  *
  * 說明：
- * - 先遍歷左子樹，再將根節點加入鏈表尾部，最後遍歷右子樹。
+ * - 以固定大小的堆疊取代遞迴，堆疊深度不超過樹高。
+ * - 節點加入鏈表前先記下右子樹，因為 list_add_tail 會覆寫 list。
+ * - 重複鍵值串列本身已是雙向串列，整串一次接到鏈表尾端。
  */
 void Traverse(element_t *root, struct list_head *list)
 {
-    if (!root) {
-        return;
+    element_t *stack[RB_MAX_DEPTH];
+    int top = 0;
+    element_t *cur = root;
+
+    while (cur || top > 0) {
+        // 沿著左子樹一路壓入堆疊
+        while (cur) {
+            stack[top++] = cur;
+            cur = rb_left(cur);
+        }
+        cur = stack[--top];
+
+        element_t *right = rb_right(cur);
+        if (rb_has_dups(cur)) {
+            struct list_head *first = rb_dups_first(cur);
+            struct list_head *last = rb_dups_last(cur);
+            list_add_tail(&cur->list, list);
+            first->prev = list->prev;
+            list->prev->next = first;
+            last->next = list;
+            list->prev = last;
+        } else {
+            // 將節點插入到鏈表尾
+            list_add_tail(&cur->list, list);
+        }
+        cur = right;
+    }
+}
+
+/**
+ * tree_sort - 以紅黑樹排序整個鏈表（數值順序）
+ * @head: 隊列頭
+ *
+ * 把每個節點依序插入樹中，再以 Traverse 中序重建回 head，
+ * 不配置任何記憶體。插入只會在樹高超過 RB_MAX_DEPTH 時失敗，
+ * 紅黑樹的樹高不可能達到，因此不檢查回傳值。
+ */
+void tree_sort(struct list_head *head)
+{
+    element_t *root = NULL;
+    struct list_head *pos = head->next;
+
+    while (pos != head) {
+        struct list_head *next = pos->next;
+        element_t *node = container_of(pos, element_t, list);
+        tree_insert_node(node, &root, node->value);
+        pos = next;
     }
-    // 先記下左右子樹，因為稍後會改動 root->list
-    element_t *left = (element_t *) root->list.prev;
-    element_t *right = (element_t *) root->list.next;
-    
-    // 遞迴左子樹
-    Traverse(left, list);
-    
-    // 重新初始化該節點，避免與樹結構衝突
-    INIT_LIST_HEAD(&root->list);
-    // 將節點插入到鏈表尾
-    list_add_tail(&root->list, list);
-    
-    // 遞迴右子樹
-    Traverse(right, list);
+    INIT_LIST_HEAD(head);
+    Traverse(root, head);
 }
 // 遍歷鏈表並印出前 max_print 個元素的字串（用 container_of 取得 element_t 指標）
 void print_list(struct list_head *head, int max_print) {
@@ -127,12 +357,87 @@ void print_list(struct list_head *head, int max_print) {
         count++;
     }
 }
-/*---------------------- Main 測試 ----------------------*/
+/*---------------------- 與 qsort 對照 ----------------------*/
+
+#include "sort_check.h"
 
-int main(void)
+/**
+ * check_tree_against_qsort - 以同一組資料比對 tree sort 與 qsort 的結果
+ * @insert:    要檢查的插入函式
+ * @qsort_cmp: 對應比較器的 qsort 版本
+ * @cmp:       比較器本身（只用來判斷兩個值是否相等）
+ * @range:     輸入為 rand() % range，或 SORT_CHECK_ASCENDING
+ *
+ * 回傳 true 表示中序重建後每個位置的值都與 qsort 結果相等。
+ */
+static bool check_tree_against_qsort(bool (*insert)(element_t *, element_t **, char *),
+                                     int (*qsort_cmp)(const void *, const void *),
+                                     int (*cmp)(const char *, const char *),
+                                     int num_elements, int range)
 {
+    element_t *root = NULL;
+    element_t *nodes = malloc(num_elements * sizeof(element_t));
+    char **values = malloc(num_elements * sizeof(char *));
+    char **expected = malloc(num_elements * sizeof(char *));
+    int created = 0;
+    bool ok = nodes && values && expected;
+
+    for (; ok && created < num_elements; created++) {
+        values[created] = malloc(12);
+        if (!values[created]) {
+            ok = false;
+            break;
+        }
+        sort_check_value(values[created], created, range);
+        expected[created] = values[created];
+        ok = insert(&nodes[created], &root, values[created]);
+    }
+    if (ok) {
+        struct list_head sorted_list;
+        INIT_LIST_HEAD(&sorted_list);
+        Traverse(root, &sorted_list);
+        ok = sort_check_matches(&sorted_list, expected, num_elements, qsort_cmp, cmp);
+    }
+    for (int j = 0; values && j < created; j++) {
+        free(values[j]);
+    }
+    free(expected);
+    free(values);
+    free(nodes);
+    return ok;
+}
+
+/*---------------------- 效能測試 ----------------------*/
+
+#include "sort_bench.h"
+
+static const sort_bench_case_t bench_cases[] = {
+    {"tree_sort", tree_sort, SORT_BENCH_NO_LIMIT},
+};
+
+int main(int argc, char *argv[])
+{
+    // --bench：以固定種子跑完整的效能測試並輸出 CSV
+    if (argc > 1 && strcmp(argv[1], "--bench") == 0) {
+        return sort_bench_main(argc, argv, bench_cases,
+                               sizeof(bench_cases) / sizeof(bench_cases[0]));
+    }
     srand((unsigned)time(NULL));
 
+    // 檢查每個比較器版本都與 qsort 結果一致
+    // 遞增輸入在未平衡的二元搜尋樹會退化成鏈，用來確認樹高有被控制
+    if (!check_tree_against_qsort(tree_insert_node, qsort_cmp_numeric, cmp_numeric, 1000,
+                                  1000) ||
+        !check_tree_against_qsort(tree_insert_node_string, qsort_cmp_string, cmp_string, 1000,
+                                  1000) ||
+        !check_tree_against_qsort(tree_insert_node_length_first, qsort_cmp_length_first,
+                                  cmp_length_first, 1000, 1000) ||
+        !check_tree_against_qsort(tree_insert_node, qsort_cmp_numeric, cmp_numeric, 1000000,
+                                  SORT_CHECK_ASCENDING)) {
+        fprintf(stderr, "tree sort disagrees with qsort.\n");
+        return 1;
+    }
+
     // 用來表示整棵二元搜尋樹的根節點指標
     element_t *root = NULL;
 
@@ -175,12 +480,12 @@ int main(void)
     INIT_LIST_HEAD(&sorted_list);
 
     // 以 CPU cycles 計時
-    int64_t start = cpucycles();
+    int64_t start = measure_cycles_begin();
     // 將整棵樹中序遍歷，重建到 sorted_list
     Traverse(root, &sorted_list);
-    int64_t end = cpucycles();
+    int64_t end = measure_cycles_end();
 
-    //printf("Tree sort CPU cycles: %ld\n", end - start);
+    printf("Tree sort CPU cycles: %ld\n", (long) (end - start));
 
     // 如果想查看排序後結果，可自行印出部分資料
     // 例如：